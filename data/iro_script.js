@@ -90,14 +90,19 @@ document.addEventListener('DOMContentLoaded', function () {
     };
   }
 
+  // Each color update asks the device to fade over FADE_MS so bursts look smooth
+  const FADE_MS = 60;
+
   // Debounced update function
+  // "r,g,b,t" as text/plain: the device parses the raw body in its body
+  // callback rather than through the server's form decoding
   const updateColor = debounce(function (color) {
     fetch("/postRGB", {
       method: "POST",
       headers: {
-        'Content-Type': 'application/x-www-form-urlencoded',
+        'Content-Type': 'text/plain',
       },
-      body: "r=" + color.rgb.r + "&g=" + color.rgb.g + "&b=" + color.rgb.b
+      body: color.rgb.r + "," + color.rgb.g + "," + color.rgb.b + "," + FADE_MS
     })
       .then(response => {
         if (!response.ok) {
@@ -108,9 +113,55 @@ document.addEventListener('DOMContentLoaded', function () {
       .catch(error => console.error('Error updating color:', error));
   }, 100); // 100ms debounce time
 
+  // The kelvin slider goes through the device's color engine, which places it
+  // on the real Planckian locus for this lamp's LEDs instead of iro's RGB guess
+  const updateTemperature = debounce(function (color) {
+    const level = Math.round(color.value * 2047 / 100);
+    fetch("/postCCT", {
+      method: "POST",
+      headers: {
+        'Content-Type': 'application/x-www-form-urlencoded',
+      },
+      body: "k=" + Math.round(color.kelvin) + "&l=" + level
+    })
+      .catch(error => console.error('Error updating temperature:', error));
+  }, 100);
+
+  // Sliders are red, green, blue, value, kelvin in layout order
+  let kelvinActive = false;
+  document.getElementById('color-picker').addEventListener('pointerdown', function (event) {
+    const kelvinSlider = document.querySelectorAll('#color-picker .IroSlider')[4];
+    kelvinActive = kelvinSlider !== undefined && kelvinSlider.contains(event.target);
+  }, true);
+  colorPicker.on('input:end', function () {
+    kelvinActive = false;
+  });
+
+  // Persistent WebSocket for color frames. The device keeps only the newest
+  // frame and applies it once per control tick, so no client-side throttling
+  // is needed. Falls back to the debounced POST while the socket is down.
+  let socket = null;
+
+  function connectSocket() {
+    socket = new WebSocket('ws://' + location.host + '/ws');
+    socket.binaryType = 'arraybuffer';
+    socket.onclose = function () {
+      socket = null;
+      setTimeout(connectSocket, 1000);
+    };
+  }
+
+  connectSocket();
+
   // Color change handler
   colorPicker.on('color:change', function (color) {
-    updateColor(color);
+    if (kelvinActive) {
+      updateTemperature(color);
+    } else if (socket && socket.readyState === WebSocket.OPEN) {
+      socket.send(new Uint8Array([color.rgb.r, color.rgb.g, color.rgb.b, 0, FADE_MS & 0xFF, FADE_MS >> 8]));
+    } else {
+      updateColor(color);
+    }
   });
 
   function updateLockStatus() {
@@ -0,0 +1,32 @@
+#include "ButtonInput.h"
+
+void ButtonInput::begin() {
+    Hal::attachEdgeInterrupt(pin, &ButtonInput::onEdge, this);
+}
+
+// Runs from IRAM: Hal inlines the register read and the clock here, and
+// otherwise only atomics are touched, which is safe while flash is busy
+void IRAM_ATTR ButtonInput::onEdge(void* arg) {
+    ButtonInput* self = static_cast<ButtonInput*>(arg);
+    bool pressed = Hal::pinLevel(self->pin) == 0;
+    uint32_t now = Hal::nowMicros();
+    uint32_t h = self->head.load(std::memory_order_relaxed);
+    if (h - self->tail.load(std::memory_order_acquire) >= RING_SIZE) {
+        // A bouncing contact can outrun the reader; the debouncer only needs
+        // the final level, which the next edge or poll will still deliver
+        self->overflows.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    self->ring[h & (RING_SIZE - 1)] = {now, pressed};
+    self->head.store(h + 1, std::memory_order_release);
+}
+
+bool ButtonInput::pop(Edge& edge) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) {
+        return false;
+    }
+    edge = ring[t & (RING_SIZE - 1)];
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+}
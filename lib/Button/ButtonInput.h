@@ -0,0 +1,37 @@
+#ifndef BUTTON_INPUT_H
+#define BUTTON_INPUT_H
+
+#include "Platform.h"
+#include "Hal.h"
+#include <atomic>
+
+// Active-low button on a GPIO edge interrupt. The ISR timestamps every edge
+// and pushes it into a small SPSC ring (ISR writes, control loop reads), so
+// presses shorter than a control tick are still seen, with their real time.
+class ButtonInput {
+public:
+    struct Edge {
+        uint32_t timeMicros;
+        bool pressed;
+    };
+
+    static constexpr uint32_t RING_SIZE = 32; // Must be a power of two
+
+    explicit ButtonInput(int buttonPin) : pin(buttonPin) {}
+
+    void begin();
+    bool pop(Edge& edge);
+    bool isPressed() const { return Hal::pinLevel(pin) == 0; }
+    uint32_t getOverflowCount() const { return overflows.load(std::memory_order_relaxed); }
+
+private:
+    const int pin;
+    Edge ring[RING_SIZE];
+    std::atomic<uint32_t> head{0};
+    std::atomic<uint32_t> tail{0};
+    std::atomic<uint32_t> overflows{0};
+
+    static void IRAM_ATTR onEdge(void* arg);
+};
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef GESTURE_DECODER_H
+#define GESTURE_DECODER_H
+
+#include "Platform.h"
+
+enum class Gesture : uint8_t {
+    None,
+    Click,        // One short press; reported once the double-click window closes,
+                  // or at the release while double-click is off
+    DoubleClick,  // Two short presses within DOUBLE_CLICK_US
+    LongPress,    // Held for LONG_PRESS_US; reported while still held
+    TurnStart,    // A pot moved while the button was held
+    TurnEnd,      // Button released after TurnStart
+};
+
+// Debounces timestamped button edges and turns them into gestures. Pure
+// logic on caller-supplied micros() times, so it runs the same on synthetic
+// edges; unsigned differences keep it correct across the 32-bit wrap.
+//
+// Debounce is a lockout: the first edge that changes the stable level is
+// taken at its own timestamp, and edges for DEBOUNCE_US after it are bounce.
+// If the raw level still differs when the lockout ends, that level is taken
+// then, so a bounce that ends on the other level is never lost.
+//
+// Gestures queue until polled, oldest first: a turn reported after one poll
+// and the release drained before the next give TurnStart, then TurnEnd.
+class GestureDecoder {
+public:
+    static constexpr uint32_t DEBOUNCE_US = 30000;
+    static constexpr uint32_t DOUBLE_CLICK_US = 250000;
+    static constexpr uint32_t LONG_PRESS_US = 700000;
+    static constexpr int QUEUE_SIZE = 4;
+
+    // Raw edge: pressed is the level read in the interrupt
+    void edge(bool pressed, uint32_t timeMicros) {
+        rawPressed = pressed;
+        if (pressed != stablePressed && timeMicros - lastAcceptMicros >= DEBOUNCE_US) {
+            accept(pressed, timeMicros);
+        }
+    }
+
+    // With double-click off a click is reported at its release instead of
+    // DOUBLE_CLICK_US later, and two quick presses are two clicks. For callers
+    // with nothing bound to a double-click, where the wait is pure latency
+    void setDoubleClickEnabled(bool enabled) { doubleClickEnabled = enabled; }
+
+    // Reports a pot movement; only meaningful while the button is held
+    void turn() {
+        if (state == State::Pressed || state == State::SecondPressed) {
+            state = State::Turning;
+            emit(Gesture::TurnStart);
+        }
+    }
+
+    // Advances timeouts and returns the oldest queued gesture, if any
+    Gesture poll(uint32_t nowMicros) {
+        if (rawPressed != stablePressed && nowMicros - lastAcceptMicros >= DEBOUNCE_US) {
+            accept(rawPressed, lastAcceptMicros + DEBOUNCE_US);
+        }
+        if ((state == State::Pressed || state == State::SecondPressed) && nowMicros - pressMicros >= LONG_PRESS_US) {
+            state = State::LongHeld;
+            emit(Gesture::LongPress);
+        } else if (state == State::WaitSecond && (!doubleClickEnabled || nowMicros - releaseMicros >= DOUBLE_CLICK_US)) {
+            state = State::Idle;
+            emit(Gesture::Click);
+        }
+        if (queued == 0) {
+            return Gesture::None;
+        }
+        Gesture next = queue[oldest];
+        oldest = (oldest + 1) % QUEUE_SIZE;
+        queued--;
+        return next;
+    }
+
+    bool isPressed() const { return stablePressed; }
+    bool isRawPressed() const { return rawPressed; }
+    bool isTurning() const { return state == State::Turning; }
+    // Released, settled and not waiting out a double-click window
+    bool isIdle() const { return state == State::Idle && !rawPressed && !stablePressed; }
+    uint32_t getDroppedCount() const { return dropped; }
+
+private:
+    enum class State : uint8_t { Idle, Pressed, WaitSecond, SecondPressed, LongHeld, Turning };
+
+    State state = State::Idle;
+    Gesture queue[QUEUE_SIZE] = {};
+    uint8_t oldest = 0;
+    uint8_t queued = 0;
+    uint32_t dropped = 0;
+    bool doubleClickEnabled = true;
+    bool rawPressed = false;
+    bool stablePressed = false;
+    uint32_t lastAcceptMicros = 0;
+    uint32_t pressMicros = 0;
+    uint32_t releaseMicros = 0;
+
+    // Debounce spaces gestures at least DEBOUNCE_US apart, so the queue only
+    // fills if nothing polls for a long batch of edges; the oldest goes then
+    void emit(Gesture gesture) {
+        if (queued == QUEUE_SIZE) {
+            oldest = (oldest + 1) % QUEUE_SIZE;
+            queued--;
+            dropped++;
+        }
+        queue[(oldest + queued) % QUEUE_SIZE] = gesture;
+        queued++;
+    }
+
+    void accept(bool pressed, uint32_t timeMicros) {
+        stablePressed = pressed;
+        lastAcceptMicros = timeMicros;
+        if (pressed) {
+            pressMicros = timeMicros;
+            state = state == State::WaitSecond ? State::SecondPressed : State::Pressed;
+            return;
+        }
+        switch (state) {
+        case State::Pressed:
+            if (!doubleClickEnabled) {
+                state = State::Idle;
+                emit(Gesture::Click);
+                break;
+            }
+            releaseMicros = timeMicros;
+            state = State::WaitSecond;
+            break;
+        case State::SecondPressed:
+            state = State::Idle;
+            emit(Gesture::DoubleClick);
+            break;
+        case State::Turning:
+            state = State::Idle;
+            emit(Gesture::TurnEnd);
+            break;
+        default:
+            state = State::Idle;
+            break;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef CLOCK_FILTER_H
+#define CLOCK_FILTER_H
+
+#include "Platform.h"
+
+// One NTP-style exchange, all in microseconds: t1 request sent (local),
+// t2 request received and t3 reply sent (reference), t4 reply received (local)
+struct ClockSample {
+    int64_t offset;    // Reference clock minus local clock
+    int64_t delay;     // Round trip minus the reference's turnaround
+};
+
+// The NTP clock filter: keeps the last SAMPLES exchanges and trusts the one
+// with the lowest round trip, which had the least room for asymmetric
+// queueing. A delayed packet can't pull the clock. Kept apart from CueSync's
+// sockets so the native build can run it against simulated networks.
+class ClockFilter {
+public:
+    static constexpr int SAMPLES = 8;
+
+    static ClockSample computeSample(int64_t t1, int64_t t2, int64_t t3, int64_t t4) {
+        return {((t2 - t1) + (t3 - t4)) / 2, (t4 - t1) - (t3 - t2)};
+    }
+
+    void reset() {
+        count = 0;
+        head = 0;
+    }
+
+    // Adds an exchange and returns the best one in the window
+    ClockSample add(const ClockSample& sample) {
+        samples[head] = sample;
+        head = (head + 1) % SAMPLES;
+        if (count < SAMPLES) {
+            count++;
+        }
+        const ClockSample* best = &samples[0];
+        for (int i = 1; i < count; i++) {
+            if (samples[i].delay < best->delay) {
+                best = &samples[i];
+            }
+        }
+        return *best;
+    }
+
+    int size() const { return count; }
+
+private:
+    ClockSample samples[SAMPLES];
+    int count = 0;
+    int head = 0;
+};
+
+#endif
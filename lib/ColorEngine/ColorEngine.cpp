@@ -0,0 +1,74 @@
+#include "ColorEngine.h"
+#include "PerceptualLut.h"
+
+constexpr ColorMatrix ColorEngine::DEFAULT_MATRIX;
+
+static constexpr PlanckianTable LOCUS = makePlanckianTable();
+static_assert(LOCUS.entries[0].x > 0 && LOCUS.entries[LOCUS_SIZE - 1].z > 0, "Locus table must be populated");
+
+// Relative luminance for each lightness level, same curve as the LED tables
+static constexpr ChannelLut LUMINANCE_LUT = makeChannelLut(1.0f, cieLightnessCurve);
+
+void ColorEngine::begin() {
+    const PersistedSettings& stored = settings.get();
+    if (stored.colorMatrixSet) {
+        memcpy(matrix.m, stored.colorMatrix, sizeof(matrix.m));
+    }
+}
+
+void ColorEngine::setMatrix(const ColorMatrix& newMatrix) {
+    matrix = newMatrix;
+    settings.setColorMatrix(matrix.m);
+}
+
+void ColorEngine::locusXyz(int kelvin, int duv, int32_t xyz[3]) {
+    kelvin = constrain(kelvin, MIN_KELVIN, MAX_KELVIN);
+    duv = constrain(duv, -MAX_DUV, MAX_DUV);
+
+    // Position in the table in 1/256 steps
+    int32_t mired256 = (1000000L * 256) / kelvin;
+    int32_t position = (mired256 - LOCUS_MIN_MIRED * 256) / LOCUS_STEP_MIRED;
+    int index = constrain(position >> 8, 0, LOCUS_SIZE - 2);
+    int32_t frac = constrain(position - (index << 8), 0, 256);
+
+    const LocusEntry& a = LOCUS.entries[index];
+    const LocusEntry& b = LOCUS.entries[index + 1];
+    int32_t x = a.x + (((b.x - a.x) * frac) >> 8);
+    int32_t z = a.z + (((b.z - a.z) * frac) >> 8);
+    int32_t dx = a.dxDuv + (((b.dxDuv - a.dxDuv) * frac) >> 8);
+    int32_t dz = a.dzDuv + (((b.dzDuv - a.dzDuv) * frac) >> 8);
+
+    xyz[0] = x + static_cast<int32_t>(static_cast<int64_t>(dx) * duv / DUV_SCALE);
+    xyz[1] = LOCUS_ONE;
+    xyz[2] = z + static_cast<int32_t>(static_cast<int64_t>(dz) * duv / DUV_SCALE);
+}
+
+void ColorEngine::cctToDuties(int level, int kelvin, int duv, uint32_t out[3]) const {
+    int32_t xyz[3];
+    locusXyz(kelvin, duv, xyz);
+    xyzToDuties(level, xyz, out);
+}
+
+void ColorEngine::xyzToDuties(int level, const int32_t xyz[3], uint32_t out[3]) const {
+    int32_t drive[3];
+    int32_t largest = 0;
+    for (int i = 0; i < 3; i++) {
+        const int32_t* row = &matrix.m[i * 3];
+        int64_t sum = static_cast<int64_t>(row[0]) * xyz[0] + static_cast<int64_t>(row[1]) * xyz[1] +
+                      static_cast<int64_t>(row[2]) * xyz[2];
+        // Negative drive means the target is outside the LED gamut; clip it
+        drive[i] = sum > 0 ? static_cast<int32_t>(sum >> 16) : 0;
+        if (drive[i] > largest) {
+            largest = drive[i];
+        }
+    }
+
+    uint32_t luminance = LUMINANCE_LUT.values[constrain(level, 0, LUT_SIZE - 1)];
+    for (int i = 0; i < 3; i++) {
+        // Out of range at Y = 1: keep the ratios and scale to the brightest that fits
+        uint32_t fraction = largest > LOCUS_ONE
+                                ? static_cast<uint32_t>((static_cast<int64_t>(drive[i]) << 16) / largest)
+                                : static_cast<uint32_t>(drive[i]);
+        out[i] = (static_cast<uint64_t>(fraction) * luminance) >> 16;
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef COLOR_ENGINE_H
+#define COLOR_ENGINE_H
+
+#include "Platform.h"
+#include "PlanckianLocus.h"
+#include "PerceptualLut.h"
+#include "Settings.h"
+
+// Row-major Q16 matrix from CIE XYZ to linear channel drive (red, green,
+// blue), where 1.0 is a channel at full duty
+struct ColorMatrix {
+    int32_t m[9];
+};
+
+namespace color_detail {
+
+struct Primary {
+    double x, y;       // Chromaticity
+    double luminance;  // Y at full duty, relative to all channels at full
+};
+
+constexpr ColorMatrix invertPrimaries(Primary r, Primary g, Primary b) {
+    // Columns are each channel's XYZ at full duty
+    double p[9] = {
+        r.luminance * r.x / r.y, g.luminance * g.x / g.y, b.luminance * b.x / b.y,
+        r.luminance, g.luminance, b.luminance,
+        r.luminance * (1 - r.x - r.y) / r.y, g.luminance * (1 - g.x - g.y) / g.y, b.luminance * (1 - b.x - b.y) / b.y,
+    };
+    double c[9] = {
+        p[4] * p[8] - p[5] * p[7], p[2] * p[7] - p[1] * p[8], p[1] * p[5] - p[2] * p[4],
+        p[5] * p[6] - p[3] * p[8], p[0] * p[8] - p[2] * p[6], p[2] * p[3] - p[0] * p[5],
+        p[3] * p[7] - p[4] * p[6], p[1] * p[6] - p[0] * p[7], p[0] * p[4] - p[1] * p[3],
+    };
+    double det = p[0] * c[0] + p[1] * c[3] + p[2] * c[6];
+    ColorMatrix result{};
+    for (int i = 0; i < 9; i++) {
+        result.m[i] = locus_detail::toQ16(c[i] / det);
+    }
+    return result;
+}
+
+// Scales each channel's row, i.e. its drive for any target
+constexpr ColorMatrix trimRows(ColorMatrix matrix, double red, double green, double blue) {
+    const double trims[3] = {red, green, blue};
+    for (int i = 0; i < 9; i++) {
+        double value = matrix.m[i] * trims[i / 3];
+        matrix.m[i] = static_cast<int32_t>(value < 0 ? value - 0.5 : value + 0.5);
+    }
+    return matrix;
+}
+
+}
+
+// Turns colorimetric targets (CCT and Duv, or CIE xy) plus a lightness level
+// into linear channel duties through a per-lamp calibration matrix.
+//
+// The Planckian locus is a compile-time table, so a request costs one table
+// interpolation and a Q16 3x3 multiply; there is no floating point at runtime.
+// Levels use the same 0-2047 lightness scale as the pots, and level 2047 is
+// Y = 1, the luminance of every channel at full. Colors the LEDs can't reach
+// at that brightness are scaled down until the largest channel fits.
+class ColorEngine {
+public:
+    static constexpr int MIN_KELVIN = 1000000 / LOCUS_MAX_MIRED;
+    static constexpr int MAX_KELVIN = 1000000 / LOCUS_MIN_MIRED;
+    static constexpr int DUV_SCALE = 10000; // Duv arguments are Duv * 10^4
+    static constexpr int MAX_DUV = 200;     // +-0.02, where the linearised table holds
+
+    // Nominal datasheet primaries with the channel trims applied, matching the
+    // pot path. A matrix set through /calibration replaces it whole, trims included
+    static constexpr ColorMatrix DEFAULT_MATRIX = color_detail::trimRows(
+        color_detail::invertPrimaries({0.690, 0.309, 0.30}, {0.170, 0.700, 0.60}, {0.136, 0.048, 0.10}),
+        RED_TRIM, GREEN_TRIM, BLUE_TRIM);
+
+    explicit ColorEngine(SettingsStore& settingsStore) : settings(settingsStore) {}
+
+    // Loads the calibration from settings, falling back to DEFAULT_MATRIX
+    void begin();
+    void setMatrix(const ColorMatrix& matrix);
+    const ColorMatrix& getMatrix() const { return matrix; }
+
+    // Outputs are duties with 5 bits of fraction (0 to LUT_FULL_SCALE), ready
+    // for LEDController::setLinearDuties
+    void cctToDuties(int level, int kelvin, int duv, uint32_t out[3]) const;
+
+    // Locus point at kelvin, offset by duv, as Q16 XYZ with Y = 1
+    static void locusXyz(int kelvin, int duv, int32_t xyz[3]);
+
+private:
+    SettingsStore& settings;
+    ColorMatrix matrix = DEFAULT_MATRIX;
+
+    void xyzToDuties(int level, const int32_t xyz[3], uint32_t out[3]) const;
+};
+
+#endif
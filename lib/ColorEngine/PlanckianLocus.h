@@ -0,0 +1,100 @@
+#ifndef PLANCKIAN_LOCUS_H
+#define PLANCKIAN_LOCUS_H
+
+#include "Platform.h"
+
+// Planckian locus sampled every LOCUS_STEP_MIRED from LOCUS_MIN_MIRED
+// (20000 K) to LOCUS_MAX_MIRED (1667 K). Equal mired steps are roughly equal
+// perceived steps, so linear interpolation between entries is accurate.
+//
+// Each entry holds the locus point as XYZ normalised to Y = 1 and the change
+// in XYZ per unit Duv (offset perpendicular to the locus in CIE 1960 uv,
+// positive towards green). Everything is Q16 and generated at compile time;
+// the Duv term is linearised, which costs about 0.001 in uv at |Duv| = 0.02.
+static constexpr int LOCUS_MIN_MIRED = 50;
+static constexpr int LOCUS_MAX_MIRED = 600;
+static constexpr int LOCUS_STEP_MIRED = 5;
+static constexpr int LOCUS_SIZE = (LOCUS_MAX_MIRED - LOCUS_MIN_MIRED) / LOCUS_STEP_MIRED + 1;
+static constexpr int32_t LOCUS_ONE = 1L << 16;
+
+struct LocusEntry {
+    int32_t x, z;        // X and Z at Y = 1
+    int32_t dxDuv, dzDuv; // dX/dDuv and dZ/dDuv
+};
+
+struct PlanckianTable {
+    LocusEntry entries[LOCUS_SIZE];
+};
+
+namespace locus_detail {
+
+struct Uv {
+    double u, v;
+};
+
+// Kim et al. cubic spline fit of the Planckian locus, valid 1667-25000 K
+constexpr Uv planckUv(double kelvin) {
+    double t = 1.0 / kelvin;
+    double x = kelvin <= 4000.0
+                   ? -0.2661239e9 * t * t * t - 0.2343589e6 * t * t + 0.8776956e3 * t + 0.179910
+                   : -3.0258469e9 * t * t * t + 2.1070379e6 * t * t + 0.2226347e3 * t + 0.240390;
+    double y = kelvin <= 2222.0   ? -1.1063814 * x * x * x - 1.34811020 * x * x + 2.18555832 * x - 0.20219683
+               : kelvin <= 4000.0 ? -0.9549476 * x * x * x - 1.37418593 * x * x + 2.09137015 * x - 0.16748867
+                                  : 3.0817580 * x * x * x - 5.87338670 * x * x + 3.75112997 * x - 0.37001483;
+    double d = -2.0 * x + 12.0 * y + 3.0;
+    return {4.0 * x / d, 6.0 * y / d};
+}
+
+constexpr double squareRoot(double value) {
+    double guess = value > 1.0 ? value : 1.0;
+    for (int i = 0; i < 40; i++) {
+        guess = 0.5 * (guess + value / guess);
+    }
+    return guess;
+}
+
+// CIE 1960 uv to X and Z at Y = 1
+constexpr void uvToXz(double u, double v, double& x, double& z) {
+    double d = 2.0 * u - 8.0 * v + 4.0;
+    double cx = 3.0 * u / d;
+    double cy = 2.0 * v / d;
+    x = cx / cy;
+    z = (1.0 - cx - cy) / cy;
+}
+
+constexpr int32_t toQ16(double value) {
+    return static_cast<int32_t>(value * LOCUS_ONE + (value < 0 ? -0.5 : 0.5));
+}
+
+}
+
+constexpr PlanckianTable makePlanckianTable() {
+    using namespace locus_detail;
+    PlanckianTable table{};
+    const double step = 0.5; // mired, for the tangent
+    const double eps = 0.001; // Duv, for the derivative
+    for (int i = 0; i < LOCUS_SIZE; i++) {
+        double mired = LOCUS_MIN_MIRED + i * LOCUS_STEP_MIRED;
+        Uv point = planckUv(1e6 / mired);
+        Uv before = planckUv(1e6 / (mired - step));
+        Uv after = planckUv(1e6 / (mired + step));
+        double du = after.u - before.u;
+        double dv = after.v - before.v;
+        double length = squareRoot(du * du + dv * dv);
+        // Unit normal, oriented so positive Duv is above the locus
+        double nu = -dv / length;
+        double nv = du / length;
+        if (nv < 0) {
+            nu = -nu;
+            nv = -nv;
+        }
+        double x = 0, z = 0, xUp = 0, zUp = 0, xDown = 0, zDown = 0;
+        uvToXz(point.u, point.v, x, z);
+        uvToXz(point.u + nu * eps, point.v + nv * eps, xUp, zUp);
+        uvToXz(point.u - nu * eps, point.v - nv * eps, xDown, zDown);
+        table.entries[i] = {toQ16(x), toQ16(z), toQ16((xUp - xDown) / (2 * eps)), toQ16((zUp - zDown) / (2 * eps))};
+    }
+    return table;
+}
+
+#endif
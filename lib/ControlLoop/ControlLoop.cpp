@@ -0,0 +1,89 @@
+#include "ControlLoop.h"
+
+void ControlLoop::sense(uint32_t nowMs) {
+    // Pots 0-2 are left (meant for red), middle (green) and right (blue)
+    for (int i = 0; i < PotSampler::NUM_POTS; i++) {
+        int pot = map(constrain(sampler.read(i), 5, 950), 5, 950, 0, 2047);
+        filteredPots[i] = potFilters[i].update(pot, nowMs);
+    }
+}
+
+Gesture ControlLoop::readInputs() {
+    Gesture gesture = state.update();
+    potsHeld = handlePressAndTurn(gesture);
+    settings.setLastMode(static_cast<uint8_t>(state.getCurrentMode()));
+    return gesture;
+}
+
+// Tracks the button against the pots; returns true while the pots belong to
+// the adjustment rather than the color
+bool ControlLoop::handlePressAndTurn(Gesture gesture) {
+    bool held = state.isButtonHeld();
+    if (held && !wasHeld) {
+        memcpy(potsAtPress, filteredPots, sizeof(potsAtPress));
+        memcpy(shownAtPress, shownPots, sizeof(shownAtPress));
+        masterAtPress = led.getMasterLevel();
+    }
+    wasHeld = held;
+
+    // The pot turned furthest since the press drives the adjustment
+    int delta = 0;
+    for (int i = 0; i < PotSampler::NUM_POTS; i++) {
+        int moved = filteredPots[i] - potsAtPress[i];
+        if (abs(moved) > abs(delta)) {
+            delta = moved;
+        }
+    }
+    if (held && !state.isAdjusting() && abs(delta) > TURN_THRESHOLD) {
+        state.reportTurn();
+    }
+    if (state.isAdjusting()) {
+        int32_t level = static_cast<int32_t>(masterAtPress) + delta * (65536 / 2047);
+        led.setMasterLevel(constrain(level, static_cast<int32_t>(MIN_MASTER_LEVEL), 65536));
+    }
+    if (gesture == Gesture::TurnEnd) {
+        for (int i = 0; i < PotSampler::NUM_POTS; i++) {
+            potTakeover[i].hold(shownAtPress[i], filteredPots[i]);
+        }
+    }
+    return held;
+}
+
+void ControlLoop::applyOutputs() {
+    // While the button is down the color holds at what it showed before the press
+    int pots[PotSampler::NUM_POTS];
+    for (int i = 0; i < PotSampler::NUM_POTS; i++) {
+        pots[i] = potsHeld ? shownAtPress[i] : potTakeover[i].update(filteredPots[i]);
+        shownPots[i] = pots[i];
+    }
+
+    switch (state.getCurrentMode()) {
+    case OperationMode::RGB:
+        // pots[0] is LEFT (physically red), pots[2] is RIGHT (physically blue).
+        // The pots run opposite to the logical channel order LampOutput maps to pins
+        led.setPWMDirectly(pots[2], pots[1], pots[0]);
+        break;
+    case OperationMode::LTT:
+        ltt.updateLTT(pots[0], pots[1], pots[2]);
+        break;
+    case OperationMode::OFF: {
+        // Any gesture can land here, not just the step from WIFI
+        static const uint32_t dark[3] = {0, 0, 0};
+        led.setLinearDuties(dark);
+        break;
+    }
+    case OperationMode::WIFI:
+        // LED control happens via WiFi in WIFI mode
+        break;
+    }
+
+    // Step any running fade at the control rate
+    led.update();
+}
+
+IdleInputs ControlLoop::idleInputs(bool serving) const {
+    return {state.getCurrentMode() == OperationMode::OFF,
+            serving,
+            state.isButtonIdle(),
+            {filteredPots[0], filteredPots[1], filteredPots[2]}};
+}
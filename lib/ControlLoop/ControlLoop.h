@@ -0,0 +1,71 @@
+#ifndef CONTROL_LOOP_H
+#define CONTROL_LOOP_H
+
+#include "Platform.h"
+#include "LEDController.h"
+#include "LTTController.h"
+#include "state.h"
+#include "PotSampler.h"
+#include "InputFilter.h"
+#include "Settings.h"
+#include "IdlePolicy.h"
+
+// The lamp's local control logic: pot sensing and filtering, the button and
+// press-and-turn dimming, and the per-mode output. main.cpp runs it from the
+// scheduler and wraps WiFi and power management around it; the native tests
+// run the same object against the fake Hal, so a replayed trace goes through
+// exactly the code the lamp runs.
+class ControlLoop {
+public:
+    // Press-and-turn: holding the button and turning any pot sets the master
+    // level instead of the color. Afterwards each pot keeps its pre-press
+    // value until it is turned back past it
+    static constexpr int TURN_THRESHOLD = 100;               // Pot travel (of 2047) that starts an adjustment
+    static constexpr uint32_t MIN_MASTER_LEVEL = 65536 / 20; // Never dim to black by accident
+
+    ControlLoop(LEDController& ledController, LTTController& lttController, StateHandler& stateHandler,
+                PotSampler& potSampler, SettingsStore& settingsStore)
+        : led(ledController), ltt(lttController), state(stateHandler), sampler(potSampler), settings(settingsStore) {}
+
+    // Sense stage: latest pot samples mapped to 0-2047 and filtered
+    void sense(uint32_t nowMs);
+
+    // First half of a control tick: button gestures, press-and-turn and the
+    // persisted mode. Returns the gesture taken this tick
+    Gesture readInputs();
+
+    // Second half: outputs for the current mode, then fades and the thermal
+    // model. Network commands for WIFI mode are applied between the halves
+    void applyOutputs();
+
+    OperationMode getMode() const { return state.getCurrentMode(); }
+    int getPot(int pot) const { return filteredPots[pot]; }
+    IdleInputs idleInputs(bool serving) const;
+
+private:
+    static constexpr int MOVING_AVERAGE_SIZE = 8;
+
+    LEDController& led;
+    LTTController& ltt;
+    StateHandler& state;
+    PotSampler& sampler;
+    SettingsStore& settings;
+
+    // Swap in IirFilter<N> or OneEuroFilter to trade latency against noise
+    MovingAverageFilter<MOVING_AVERAGE_SIZE> potFilters[PotSampler::NUM_POTS];
+    int filteredPots[PotSampler::NUM_POTS] = {0};
+
+    int potsAtPress[PotSampler::NUM_POTS] = {0};
+    // Pot values the output was using, which differ from the pots while a
+    // takeover is still holding; the color stays on these while the button is down
+    int shownPots[PotSampler::NUM_POTS] = {0};
+    int shownAtPress[PotSampler::NUM_POTS] = {0};
+    uint32_t masterAtPress = 0;
+    SoftTakeover potTakeover[PotSampler::NUM_POTS];
+    bool wasHeld = false;
+    bool potsHeld = false;
+
+    bool handlePressAndTurn(Gesture gesture);
+};
+
+#endif
@@ -0,0 +1,317 @@
+#ifndef TRACE_REPLAY_H
+#define TRACE_REPLAY_H
+
+#include "ControlLoop.h"
+#include "ColorEngine.h"
+#include "Trace.h"
+#include "HalFake.h"
+
+#ifndef ARDUINO
+
+#include <algorithm>
+#include <vector>
+
+// Native-build replay of a Trace dump through the lamp's own control code.
+// Records are fed in at their timestamps against the fake Hal: ADC sweeps go
+// into the PotSampler, button records drive the button pin, and network
+// records are applied to the LEDController the way WiFiManager applies them.
+// Sense and control ticks run on main.cpp's schedule and the dither timer
+// runs as the clock moves, so the PWM latches are the ones the lamp would
+// have made. Mode records are not fed in; they are what the replay's own
+// mode changes are checked against.
+//
+// A capture from GET /trace replays as is; a Serial 'd' dump is the same
+// bytes as hex between the TRACE BEGIN / TRACE END lines.
+class TraceReplay {
+public:
+    static constexpr uint32_t SENSE_INTERVAL_US = 20000;   // As main.cpp
+    static constexpr uint32_t CONTROL_INTERVAL_US = 5000;
+    static constexpr uint32_t TAIL_US = 1000000;           // Run on after the last record
+    static constexpr uint32_t CHANGE_CODES = 2;            // Smaller duty moves are the dither
+    static constexpr uint16_t ADC_INPUT_MV = 10;           // Smaller pot moves are noise
+    static constexpr uint32_t RESPONSE_TIMEOUT_US = 1000000;
+    static constexpr uint32_t SETTLE_US = 200000;          // Quiet time before a move counts as flicker
+
+    struct Stats {
+        uint32_t records = 0;
+        uint32_t inputs = 0;          // Button edges, pot moves and network commands
+        uint32_t latches = 0;
+        uint32_t outputChanges = 0;   // Latches that moved a channel CHANGE_CODES or more
+        uint32_t maxStepCodes = 0;    // Largest such move in one latch
+        // Input to first output change, from the first input not yet answered
+        uint32_t responses = 0;
+        uint32_t latencyP50Us = 0;
+        uint32_t latencyP99Us = 0;
+        uint32_t latencyMaxUs = 0;
+        uint32_t unanswered = 0;      // Inputs with no output change within RESPONSE_TIMEOUT_US
+        // Output changes with no input for SETTLE_US and no fade running,
+        // split by whether the power governor was derating at the time
+        uint32_t flickerSteps = 0;
+        uint32_t flickerMaxCodes = 0;
+        uint32_t governorSteps = 0;
+        uint32_t modeChanges = 0;
+        uint32_t modeMismatches = 0;  // Against the trace's Mode records, position by position
+        uint32_t finalDuty[LampOutput::CHANNELS] = {0};
+    };
+
+    TraceReplay(ControlLoop& controlLoop, LEDController& ledController, ColorEngine& colorEngine,
+                PotSampler& potSampler, SettingsStore& settingsStore)
+        : loop(controlLoop), led(ledController), engine(colorEngine), sampler(potSampler), settings(settingsStore) {}
+
+    // Checks the header and appends the records; false if the bytes are not a
+    // complete version-1 dump
+    static bool parse(const uint8_t* data, size_t size, std::vector<Trace::Record>& out) {
+        if (size < 16 || memcmp(data, "CSTR", 4) != 0 || data[4] != Trace::VERSION ||
+            data[5] != sizeof(Trace::Record)) {
+            return false;
+        }
+        uint32_t count;
+        memcpy(&count, &data[8], 4);
+        if ((size - 16) / sizeof(Trace::Record) < count) {
+            return false;
+        }
+        size_t first = out.size();
+        out.resize(first + count);
+        memcpy(&out[first], &data[16], count * sizeof(Trace::Record));
+        return true;
+    }
+
+    // The pipeline must have been begun on a freshly reset fake Hal
+    Stats run(const std::vector<Trace::Record>& trace) {
+        stats = Stats();
+        latencies.clear();
+        if (trace.empty()) {
+            return stats;
+        }
+
+        // Button records are written when the control tick drains the edge
+        // ring, stamped with the edge's own time, so they can be out of order
+        std::vector<Trace::Record> records(trace);
+        uint32_t start = records[0].timeMicros;
+        for (const Trace::Record& record : records) {
+            if (static_cast<int32_t>(record.timeMicros - start) < 0) {
+                start = record.timeMicros;
+            }
+        }
+        std::stable_sort(records.begin(), records.end(), [start](const Trace::Record& a, const Trace::Record& b) {
+            return a.timeMicros - start < b.timeMicros - start;
+        });
+        stats.records = records.size();
+
+        std::vector<uint8_t> expectedModes;
+        for (const Trace::Record& record : records) {
+            if (record.type == static_cast<uint8_t>(Trace::Type::Mode)) {
+                expectedModes.push_back(record.arg);
+            }
+        }
+
+        Hal::Fake::setLatchObserver(&TraceReplay::onLatch, this);
+        origin = Hal::nowMicros64();
+        for (int ch = 0; ch < LampOutput::CHANNELS; ch++) {
+            shownDuty[ch] = Hal::Fake::latchedDuty(ch);
+        }
+        lastInputUs = 0;
+        pendingSinceUs = -1;
+        uint64_t end = (records.back().timeMicros - start) + static_cast<uint64_t>(TAIL_US);
+        uint64_t nextControl = 0;
+        uint64_t nextSense = 0;
+        size_t next = 0;
+        OperationMode mode = loop.getMode();
+
+        for (;;) {
+            uint64_t recordDue = next < records.size() ? records[next].timeMicros - start : end;
+            uint64_t due = std::min(recordDue, std::min(nextControl, nextSense));
+            if (due >= end && next == records.size()) {
+                break;
+            }
+            advanceTo(due);
+            while (next < records.size() && records[next].timeMicros - start <= due) {
+                apply(records, next);
+            }
+            // Registration order in main.cpp: control before sense
+            if (nextControl == due) {
+                loop.readInputs();
+                if (loop.getMode() != mode) {
+                    noteModeChange(mode, loop.getMode(), expectedModes);
+                    mode = loop.getMode();
+                }
+                loop.applyOutputs();
+                nextControl += CONTROL_INTERVAL_US;
+            }
+            if (nextSense == due) {
+                loop.sense(Hal::nowMillis());
+                nextSense += SENSE_INTERVAL_US;
+            }
+            expirePending();
+        }
+        Hal::Fake::setLatchObserver(nullptr, nullptr);
+
+        if (stats.modeChanges < expectedModes.size()) {
+            stats.modeMismatches += expectedModes.size() - stats.modeChanges;
+        }
+        for (int ch = 0; ch < LampOutput::CHANNELS; ch++) {
+            stats.finalDuty[ch] = Hal::Fake::latchedDuty(ch);
+        }
+        std::sort(latencies.begin(), latencies.end());
+        stats.responses = latencies.size();
+        if (!latencies.empty()) {
+            stats.latencyP50Us = latencies[latencies.size() / 2];
+            stats.latencyP99Us = latencies[latencies.size() * 99 / 100];
+            stats.latencyMaxUs = latencies.back();
+        }
+        return stats;
+    }
+
+private:
+    ControlLoop& loop;
+    LEDController& led;
+    ColorEngine& engine;
+    PotSampler& sampler;
+    SettingsStore& settings;
+
+    Stats stats;
+    std::vector<uint32_t> latencies;
+    int64_t origin = 0;
+    uint32_t shownDuty[LampOutput::CHANNELS] = {0};  // As of the last output change
+    uint16_t lastSweep[PotSampler::NUM_POTS] = {0};
+    bool haveSweep = false;
+    int64_t lastInputUs = 0;
+    int64_t pendingSinceUs = -1;   // First input not yet answered by an output change
+
+    int64_t elapsed() const { return Hal::nowMicros64() - origin; }
+
+    void advanceTo(uint64_t offsetMicros) {
+        int64_t step = static_cast<int64_t>(offsetMicros) - elapsed();
+        if (step > 0) {
+            Hal::Fake::advanceMicros(static_cast<uint32_t>(step));
+        }
+    }
+
+    void noteInput() {
+        stats.inputs++;
+        lastInputUs = elapsed();
+        if (pendingSinceUs < 0) {
+            pendingSinceUs = lastInputUs;
+        }
+    }
+
+    void expirePending() {
+        if (pendingSinceUs >= 0 && elapsed() - pendingSinceUs > RESPONSE_TIMEOUT_US) {
+            stats.unanswered++;
+            pendingSinceUs = -1;
+        }
+    }
+
+    void noteModeChange(OperationMode from, OperationMode to, const std::vector<uint8_t>& expected) {
+        // A trace without Mode records has nothing to check against
+        if (!expected.empty() &&
+            (stats.modeChanges >= expected.size() || expected[stats.modeChanges] != static_cast<uint8_t>(to))) {
+            stats.modeMismatches++;
+        }
+        stats.modeChanges++;
+        // A gesture decoded from earlier edges (a click once its window
+        // closes, a long press while held) is the cause of what follows
+        lastInputUs = elapsed();
+        // What main.cpp's control task does around WIFI mode. The lamp shows
+        // the WiFi color once the access point is up; the replay shows it at once
+        if (to == OperationMode::WIFI) {
+            led.setLevels(settings.get().wifiRed, settings.get().wifiGreen, settings.get().wifiBlue);
+        } else if (from == OperationMode::WIFI) {
+            led.setLevels(0, 0, 0);
+        }
+    }
+
+    void apply(const std::vector<Trace::Record>& records, size_t& next) {
+        const Trace::Record& record = records[next++];
+        switch (static_cast<Trace::Type>(record.type)) {
+        case Trace::Type::AdcSweep: {
+            bool moved = !haveSweep;
+            for (int pot = 0; pot < PotSampler::NUM_POTS; pot++) {
+                sampler.pushSample(pot, record.values[pot]);
+                int delta = static_cast<int>(record.values[pot]) - lastSweep[pot];
+                moved = moved || abs(delta) > ADC_INPUT_MV;
+            }
+            // Compared with the last sweep that counted, so a slow turn still registers
+            if (moved) {
+                memcpy(lastSweep, record.values, sizeof(lastSweep));
+                haveSweep = true;
+                noteInput();
+            }
+            break;
+        }
+        case Trace::Type::Button:
+            Hal::Fake::setPinLevel(StateHandler::BUTTON_PIN, record.arg ? 0 : 1);
+            noteInput();
+            break;
+        case Trace::Type::NetColor: {
+            // A fade is recorded as its own record straight after the color
+            bool fade = next < records.size() && records[next].type == static_cast<uint8_t>(Trace::Type::NetFade);
+            if (fade) {
+                led.fadeTo(record.values[0], record.values[1], record.values[2], records[next++].values[0]);
+            } else {
+                led.setLevels(record.values[0], record.values[1], record.values[2]);
+            }
+            settings.setWifiColor(record.values[0], record.values[1], record.values[2]);
+            noteInput();
+            break;
+        }
+        case Trace::Type::NetPower:
+            if (record.arg) {
+                led.unlock();
+            } else {
+                led.resetToSafeMode();
+            }
+            noteInput();
+            break;
+        case Trace::Type::NetCct: {
+            uint32_t duties[3];
+            engine.cctToDuties(record.values[0], record.values[1], static_cast<int16_t>(record.values[2]), duties);
+            led.setLinearDuties(duties);
+            noteInput();
+            break;
+        }
+        case Trace::Type::Mode:
+        case Trace::Type::NetFade:   // Without its color; nothing to apply
+        default:
+            break;
+        }
+    }
+
+    static void onLatch(uint32_t /*timeMicros*/, uint32_t /*channelMask*/, void* arg) {
+        static_cast<TraceReplay*>(arg)->latched();
+    }
+
+    void latched() {
+        stats.latches++;
+        uint32_t step = 0;
+        for (int ch = 0; ch < LampOutput::CHANNELS; ch++) {
+            uint32_t duty = Hal::Fake::latchedDuty(ch);
+            uint32_t moved = duty > shownDuty[ch] ? duty - shownDuty[ch] : shownDuty[ch] - duty;
+            step = moved > step ? moved : step;
+        }
+        if (step < CHANGE_CODES) {
+            return;
+        }
+        for (int ch = 0; ch < LampOutput::CHANNELS; ch++) {
+            shownDuty[ch] = Hal::Fake::latchedDuty(ch);
+        }
+        stats.outputChanges++;
+        stats.maxStepCodes = step > stats.maxStepCodes ? step : stats.maxStepCodes;
+        int64_t now = elapsed();
+        if (pendingSinceUs >= 0) {
+            latencies.push_back(static_cast<uint32_t>(now - pendingSinceUs));
+            pendingSinceUs = -1;
+        } else if (now - lastInputUs > SETTLE_US && !led.isFading()) {
+            if (led.getGovernor().isDerating()) {
+                stats.governorSteps++;
+            } else {
+                stats.flickerSteps++;
+                stats.flickerMaxCodes = step > stats.flickerMaxCodes ? step : stats.flickerMaxCodes;
+            }
+        }
+    }
+};
+
+#endif
+
+#endif
@@ -0,0 +1,258 @@
+#ifndef CONTROL_MAILBOX_H
+#define CONTROL_MAILBOX_H
+
+#include "Platform.h"
+#include "ControlRequest.h"
+#include "InputFilter.h"
+#include <atomic>
+#include <type_traits>
+
+// Seqlock holding one trivially copyable value. One writer, one reader; the
+// reader never blocks the writer and retries if it raced a store. The payload
+// is kept in relaxed atomic words so a torn read is detected rather than UB.
+//
+// The writer (AsyncTCP task) runs at a higher priority than the reader (loop
+// task), so on the single-core C3 a reader can never spin on a half-finished store.
+template <typename T>
+class SeqLock {
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock payload must be trivially copyable");
+    static constexpr size_t WORDS = (sizeof(T) + 3) / 4;
+
+    std::atomic<uint32_t> sequence{0};
+    std::atomic<uint32_t> words[WORDS] = {};
+
+public:
+    void store(const T& value) {
+        uint32_t buffer[WORDS] = {0};
+        memcpy(buffer, &value, sizeof(T));
+        uint32_t seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < WORDS; i++) {
+            words[i].store(buffer[i], std::memory_order_relaxed);
+        }
+        sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    T load() const {
+        uint32_t buffer[WORDS];
+        uint32_t before, after;
+        do {
+            before = sequence.load(std::memory_order_acquire);
+            for (size_t i = 0; i < WORDS; i++) {
+                buffer[i] = words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = sequence.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+        T value;
+        memcpy(&value, buffer, sizeof(T));
+        return value;
+    }
+};
+
+// Latest requested state from the network handlers. Each field group carries
+// the sequence number of its last publish, taken from one counter across all
+// groups, so the reader can tell which parts changed since the last drain and
+// in what order they arrived. A newer color never hides an earlier power
+// change, and of a color and a preset recall the later one wins.
+struct ControlState {
+    uint32_t sequence = 0;  // Newest publish in any group
+    uint32_t powerSeq = 0;
+    bool unlocked = false;
+    uint32_t colorSeq = 0;
+    uint16_t red = 0;   // 11-bit PWM scale
+    uint16_t green = 0;
+    uint16_t blue = 0;
+    uint16_t fadeMs = 0;  // 0 applies the color immediately
+    uint32_t dmxSeq = 0;
+    uint16_t dmxUniverse = 1;
+    uint16_t dmxStartAddress = 1;
+    uint32_t cctSeq = 0;
+    uint16_t cctLevel = 0;  // 0-2047 lightness
+    uint16_t cctKelvin = 0;
+    int16_t cctDuv = 0;     // Duv * 10^4
+    uint32_t calibrationSeq = 0;  // Data in ControlPayload
+    uint32_t recallSeq = 0;
+    uint8_t recallIndex = 0;      // PresetBank slot
+    uint32_t keyframesSeq = 0;    // Data in ControlPayload
+    uint32_t hysteresisSeq = 0;   // Data in ControlPayload
+    uint32_t roleSeq = 0;
+    uint8_t networkRole = 0;      // NetworkRole from Settings.h
+};
+
+// The bulky, rarely sent groups. They live in a slot of their own so the
+// drain on every control tick copies only ControlState; the payload slot is
+// read only when one of these groups has changed
+struct ControlPayload {
+    uint32_t calibrationSeq = 0;
+    int32_t calibration[9] = {0}; // Q16 XYZ to channel drive
+    uint32_t keyframesSeq = 0;
+    SequenceRequest keyframes;
+    uint32_t hysteresisSeq = 0;
+    HysteresisConfig hysteresis[3];  // Pot dead-band per channel
+};
+
+enum class ControlGroup : uint8_t { Power, Color, Dmx, Cct, Calibration, Recall, Sequence, Hysteresis, Role };
+
+// Field groups that changed since the previous drain, oldest request first
+struct ControlChanges {
+    static constexpr int GROUPS = 9;
+    ControlGroup order[GROUPS];
+    int count = 0;
+};
+
+class ControlMailbox {
+private:
+    SeqLock<ControlState> slot;
+    SeqLock<ControlPayload> payloadSlot;
+    ControlState published;           // Writer side only
+    ControlPayload publishedPayload;  // Writer side only
+    ControlState drained;             // Reader side only
+    ControlPayload drainedPayload;    // Reader side only
+    std::atomic<uint32_t> appliedSequence{0};
+
+    static void noteChange(ControlChanges& changed, ControlGroup group, uint32_t seq, uint32_t drainedSeq,
+                           uint32_t (&seqs)[ControlChanges::GROUPS]) {
+        if (seq == drainedSeq) {
+            return;
+        }
+        // Insertion sort by arrival; at most one entry per group
+        int i = changed.count++;
+        while (i > 0 && static_cast<int32_t>(seqs[i - 1] - seq) > 0) {
+            changed.order[i] = changed.order[i - 1];
+            seqs[i] = seqs[i - 1];
+            i--;
+        }
+        changed.order[i] = group;
+        seqs[i] = seq;
+    }
+
+    // The payload goes out before the state that announces it, so a reader
+    // that sees the new sequence number finds the data already there
+    template <typename Update>
+    void publishPayload(uint32_t ControlPayload::*payloadSeq, uint32_t ControlState::*groupSeq, Update update) {
+        update(publishedPayload);
+        uint32_t seq = ++published.sequence;
+        publishedPayload.*payloadSeq = seq;
+        payloadSlot.store(publishedPayload);
+        published.*groupSeq = seq;
+        slot.store(published);
+    }
+
+public:
+    // Writer side: the AsyncTCP task only. Every publisher is an HTTP or
+    // WebSocket handler, and AsyncTCP runs those one at a time, so publishes
+    // never overlap and take no lock. Anything on another task (the DMX and
+    // cue sockets run on async_udp) hands its data over through a SeqLock of
+    // its own instead
+    void publishColor(int red, int green, int blue, uint16_t fadeMs = 0) {
+        published.red = red;
+        published.green = green;
+        published.blue = blue;
+        published.fadeMs = fadeMs;
+        published.colorSeq = ++published.sequence;
+        slot.store(published);
+    }
+
+    void publishPowerProfile(bool unlocked) {
+        published.unlocked = unlocked;
+        published.powerSeq = ++published.sequence;
+        slot.store(published);
+    }
+
+    void publishDmxPatch(uint16_t universe, uint16_t startAddress) {
+        published.dmxUniverse = universe;
+        published.dmxStartAddress = startAddress;
+        published.dmxSeq = ++published.sequence;
+        slot.store(published);
+    }
+
+    void publishCct(uint16_t level, uint16_t kelvin, int16_t duv) {
+        published.cctLevel = level;
+        published.cctKelvin = kelvin;
+        published.cctDuv = duv;
+        published.cctSeq = ++published.sequence;
+        slot.store(published);
+    }
+
+    void publishCalibration(const int32_t matrix[9]) {
+        publishPayload(&ControlPayload::calibrationSeq, &ControlState::calibrationSeq,
+                       [&](ControlPayload& payload) { memcpy(payload.calibration, matrix, sizeof(payload.calibration)); });
+    }
+
+    void publishRecall(uint8_t index) {
+        published.recallIndex = index;
+        published.recallSeq = ++published.sequence;
+        slot.store(published);
+    }
+
+    void publishSequence(const SequenceRequest& sequence) {
+        publishPayload(&ControlPayload::keyframesSeq, &ControlState::keyframesSeq,
+                       [&](ControlPayload& payload) { payload.keyframes = sequence; });
+    }
+
+    void publishHysteresis(const HysteresisConfig configs[3]) {
+        publishPayload(&ControlPayload::hysteresisSeq, &ControlState::hysteresisSeq, [&](ControlPayload& payload) {
+            for (int i = 0; i < 3; i++) {
+                payload.hysteresis[i] = configs[i];
+            }
+        });
+    }
+
+    void publishNetworkRole(uint8_t role) {
+        published.networkRole = role;
+        published.roleSeq = ++published.sequence;
+        slot.store(published);
+    }
+
+    // Last state this writer published; only valid on the writer side
+    const ControlState& lastPublished() const { return published; }
+    const ControlPayload& lastPublishedPayload() const { return publishedPayload; }
+
+    // Writer side: true once the reader has applied the publish with this
+    // sequence number, or a later one
+    bool isApplied(uint32_t seq) const {
+        return static_cast<int32_t>(appliedSequence.load(std::memory_order_acquire) - seq) >= 0;
+    }
+
+    // Reader side (control loop). Returns the newest state and lists which
+    // field groups changed since the previous drain, in the order they were
+    // published. The caller applies them, reading the bulky groups from
+    // payload(), and then calls acknowledge()
+    const ControlState& drain(ControlChanges& changed) {
+        ControlState state = slot.load();
+        if (state.calibrationSeq != drained.calibrationSeq || state.keyframesSeq != drained.keyframesSeq ||
+            state.hysteresisSeq != drained.hysteresisSeq) {
+            // The payload may already hold a publish the state doesn't announce
+            // yet. Take its sequence numbers, so that publish is applied now
+            // and not again on the next drain. state.sequence stays as loaded:
+            // publishes in between may not be in this state
+            drainedPayload = payloadSlot.load();
+            state.calibrationSeq = drainedPayload.calibrationSeq;
+            state.keyframesSeq = drainedPayload.keyframesSeq;
+            state.hysteresisSeq = drainedPayload.hysteresisSeq;
+        }
+        uint32_t seqs[ControlChanges::GROUPS];
+        changed.count = 0;
+        noteChange(changed, ControlGroup::Power, state.powerSeq, drained.powerSeq, seqs);
+        noteChange(changed, ControlGroup::Color, state.colorSeq, drained.colorSeq, seqs);
+        noteChange(changed, ControlGroup::Dmx, state.dmxSeq, drained.dmxSeq, seqs);
+        noteChange(changed, ControlGroup::Cct, state.cctSeq, drained.cctSeq, seqs);
+        noteChange(changed, ControlGroup::Calibration, state.calibrationSeq, drained.calibrationSeq, seqs);
+        noteChange(changed, ControlGroup::Recall, state.recallSeq, drained.recallSeq, seqs);
+        noteChange(changed, ControlGroup::Sequence, state.keyframesSeq, drained.keyframesSeq, seqs);
+        noteChange(changed, ControlGroup::Hysteresis, state.hysteresisSeq, drained.hysteresisSeq, seqs);
+        noteChange(changed, ControlGroup::Role, state.roleSeq, drained.roleSeq, seqs);
+        drained = state;
+        return drained;
+    }
+
+    // Reader side: the bulky groups as of the last drain()
+    const ControlPayload& payload() const { return drainedPayload; }
+
+    // Reader side: everything returned by the last drain() is now in effect
+    void acknowledge() { appliedSequence.store(drained.sequence, std::memory_order_release); }
+};
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef CONTROL_REQUEST_H
+#define CONTROL_REQUEST_H
+
+#include "Platform.h"
+#include "Transition.h"
+
+// A /postRGB body parsed in place: r, g, b (0-255) and optional t (fade ms)
+struct ColorRequest {
+    uint8_t red = 0;
+    uint8_t green = 0;
+    uint8_t blue = 0;
+    uint16_t fadeMs = 0;
+};
+
+// A /sequence body: keyframes on the 11-bit scale, ready for playSequence
+struct SequenceRequest {
+    Keyframe frames[TransitionEngine::MAX_KEYFRAMES] = {};
+    uint8_t count = 0;
+    bool loop = false;
+};
+
+// Splits body[begin, end) into comma-separated decimal fields, clamping each
+// at 100000. Returns the field count, or -1 if a field is empty, not decimal
+// or past maxFields
+inline int parseCsvFields(const uint8_t *body, size_t begin, size_t end, uint32_t *values, int maxFields) {
+    int fields = 0;
+    bool digits = false;
+    for (int i = 0; i < maxFields; i++) {
+        values[i] = 0;
+    }
+    for (size_t i = begin; i <= end; i++) {
+        if (i == end || body[i] == ',') {
+            if (!digits || fields == maxFields) {
+                return -1;
+            }
+            fields++;
+            digits = false;
+        } else if (body[i] >= '0' && body[i] <= '9') {
+            if (fields == maxFields) {
+                return -1;
+            }
+            uint32_t &value = values[fields];
+            value = value < 100000 ? value * 10 + (body[i] - '0') : value;
+            digits = true;
+        } else {
+            return -1;
+        }
+    }
+    return fields;
+}
+
+// Parses the CSV body "r,g,b[,t]" straight from the body bytes: no String,
+// no heap, one pass. The body is sent as text/plain so the server hands it
+// to the body callback as-is instead of decoding it into form params.
+// Values are clamped to their range; anything other than three or four
+// decimal fields is rejected
+inline bool parseColorRequest(const uint8_t *body, size_t length, ColorRequest &out) {
+    uint32_t values[4];
+    if (parseCsvFields(body, 0, length, values, 4) < 3) {
+        return false;
+    }
+    out.red = values[0] > 255 ? 255 : values[0];
+    out.green = values[1] > 255 ? 255 : values[1];
+    out.blue = values[2] > 255 ? 255 : values[2];
+    out.fadeMs = values[3] > 65535 ? 65535 : values[3];
+    return true;
+}
+
+// Parses a /recall body: the preset index as one decimal field, straight
+// from the body bytes like parseColorRequest. Range checks are the caller's
+inline bool parseRecallRequest(const uint8_t *body, size_t length, uint32_t &index) {
+    return parseCsvFields(body, 0, length, &index, 1) == 1;
+}
+
+// The older form-encoded /postRGB (r=..&g=..&b=..[&t=..]), from the values
+// the server has already decoded: the same clamping as the CSV path, with
+// toInt() rules for text, so "abc" reads as 0 as it always did. Null means
+// the parameter is absent; r, g and b are required
+inline bool parseColorForm(const char *red, const char *green, const char *blue, const char *fade,
+                           ColorRequest &out) {
+    if (red == nullptr || green == nullptr || blue == nullptr) {
+        return false;
+    }
+    auto clamp = [](const char *text, long high) {
+        long value = text != nullptr ? atol(text) : 0;
+        return value < 0 ? 0 : (value > high ? high : value);
+    };
+    out.red = clamp(red, 255);
+    out.green = clamp(green, 255);
+    out.blue = clamp(blue, 255);
+    out.fadeMs = clamp(fade, 65535);
+    return true;
+}
+
+// Parses "r,g,b,fade[,hold];r,g,b,fade[,hold];...[;loop]" the same way: one
+// keyframe per ';'-separated group, colors 0-255 and times in ms, with an
+// optional final "loop" to repeat. Keyframes ease in and out
+inline bool parseSequenceRequest(const uint8_t *body, size_t length, SequenceRequest &out) {
+    out.count = 0;
+    out.loop = false;
+    size_t begin = 0;
+    while (begin <= length) {
+        size_t end = begin;
+        while (end < length && body[end] != ';') {
+            end++;
+        }
+        if (end - begin == 4 && end == length && memcmp(body + begin, "loop", 4) == 0 && out.count > 0) {
+            out.loop = true;
+            break;
+        }
+        uint32_t values[5];
+        if (out.count == TransitionEngine::MAX_KEYFRAMES || parseCsvFields(body, begin, end, values, 5) < 4) {
+            return false;
+        }
+        Keyframe &frame = out.frames[out.count++];
+        frame.red = map(values[0] > 255 ? 255 : values[0], 0, 255, 0, 2047);
+        frame.green = map(values[1] > 255 ? 255 : values[1], 0, 255, 0, 2047);
+        frame.blue = map(values[2] > 255 ? 255 : values[2], 0, 255, 0, 2047);
+        frame.durationMs = values[3] > 65535 ? 65535 : values[3];
+        frame.holdMs = values[4] > 65535 ? 65535 : values[4];
+        frame.easing = Easing::EaseInOut;
+        begin = end + 1;
+    }
+    return out.count > 0;
+}
+
+#endif
@@ -0,0 +1,168 @@
+#include "CueSync.h"
+#include "Hal.h"
+#include "Log.h"
+
+// Datagrams start with "CSYN" and a type byte; fields are little-endian
+static const uint8_t MAGIC[4] = {'C', 'S', 'Y', 'N'};
+static const size_t HEADER_SIZE = 5;
+static const size_t SYNC_REQUEST_SIZE = HEADER_SIZE + 8;   // t1
+static const size_t SYNC_REPLY_SIZE = HEADER_SIZE + 24;    // t1, t2, t3
+static const size_t CUE_PACKET_SIZE = HEADER_SIZE + 9;     // at, r, g, b, fade (r/g/b 0-255)
+
+static void writeLe(uint8_t *out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out[i] = value >> (8 * i);
+    }
+}
+
+static uint64_t readLe(const uint8_t *in, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value |= static_cast<uint64_t>(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+void CueSync::begin() {
+    if (cueQueue == nullptr) {
+        cueQueue = xQueueCreate(MAX_PENDING_CUES, sizeof(Cue));
+    }
+    if (socket.listen(SYNC_PORT)) {
+        socket.onPacket([this](AsyncUDPPacket packet) { handlePacket(packet); });
+    }
+    running = true;
+}
+
+void CueSync::stop() {
+    socket.close();
+    running = false;
+    pendingCount = 0;
+}
+
+void CueSync::setReference(IPAddress address) {
+    referenceAddress.store(static_cast<uint32_t>(address), std::memory_order_relaxed);
+    // Samples against the old reference are meaningless now; the async_udp
+    // task restarts the filter on the next reply from the new one
+    referenceGeneration.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool CueSync::scheduleCue(const Cue &cue) {
+    return cueQueue != nullptr && xQueueSend(cueQueue, &cue, 0) == pdTRUE;
+}
+
+int64_t CueSync::getOffsetMicros() const {
+    // Without a reference this lamp is the reference
+    return referenceAddress.load(std::memory_order_relaxed) == 0 ? 0 : estimate.load().offset;
+}
+
+uint32_t CueSync::sharedMillis() const {
+    return static_cast<uint32_t>((Hal::nowMicros64() + getOffsetMicros()) / 1000);
+}
+
+void CueSync::update(uint32_t nowMs) {
+    if (!running) {
+        return;
+    }
+
+    // Move newly queued cues into the pending list, kept sorted by start time
+    Cue incoming;
+    while (cueQueue != nullptr && xQueueReceive(cueQueue, &incoming, 0) == pdTRUE) {
+        if (pendingCount == MAX_PENDING_CUES) {
+            LOG_WARN("Cue list full, dropping cue at %lu\n", incoming.atMs);
+            continue;
+        }
+        int i = pendingCount++;
+        while (i > 0 && static_cast<int32_t>(pending[i - 1].atMs - incoming.atMs) > 0) {
+            pending[i] = pending[i - 1];
+            i--;
+        }
+        pending[i] = incoming;
+    }
+
+    uint32_t generation = referenceGeneration.load(std::memory_order_relaxed);
+    if (generation != polledGeneration) {
+        polledGeneration = generation;
+        fastPollsLeft = FILTER_SAMPLES;
+    }
+    uint32_t reference = referenceAddress.load(std::memory_order_relaxed);
+    uint32_t interval = fastPollsLeft > 0 ? FAST_POLL_INTERVAL_MS : POLL_INTERVAL_MS;
+    if (reference != 0 && nowMs - lastPollMs >= interval) {
+        lastPollMs = nowMs;
+        if (fastPollsLeft > 0) {
+            fastPollsLeft--;
+        }
+        uint8_t request[SYNC_REQUEST_SIZE];
+        memcpy(request, MAGIC, sizeof(MAGIC));
+        request[4] = SyncRequest;
+        writeLe(&request[HEADER_SIZE], Hal::nowMicros64(), 8);
+        socket.writeTo(request, sizeof(request), IPAddress(reference), SYNC_PORT);
+    }
+}
+
+bool CueSync::takeDueCue(Cue &out) {
+    if (pendingCount == 0 || static_cast<int32_t>(sharedMillis() - pending[0].atMs) < 0) {
+        return false;
+    }
+    out = pending[0];
+    pendingCount--;
+    memmove(&pending[0], &pending[1], pendingCount * sizeof(Cue));
+    return true;
+}
+
+// Runs on the async_udp task
+void CueSync::handlePacket(AsyncUDPPacket &packet) {
+    int64_t received = Hal::nowMicros64();
+    const uint8_t *data = packet.data();
+    size_t length = packet.length();
+    if (length < HEADER_SIZE || memcmp(data, MAGIC, sizeof(MAGIC)) != 0) {
+        return;
+    }
+
+    switch (data[4]) {
+    case SyncRequest: {
+        if (length < SYNC_REQUEST_SIZE) {
+            return;
+        }
+        // Answer with our shared clock, so a chain of lamps follows one reference
+        int64_t offset = getOffsetMicros();
+        uint8_t reply[SYNC_REPLY_SIZE];
+        memcpy(reply, MAGIC, sizeof(MAGIC));
+        reply[4] = SyncReply;
+        memcpy(&reply[HEADER_SIZE], &data[HEADER_SIZE], 8);
+        writeLe(&reply[HEADER_SIZE + 8], received + offset, 8);
+        writeLe(&reply[HEADER_SIZE + 16], Hal::nowMicros64() + offset, 8);
+        packet.write(reply, sizeof(reply));
+        break;
+    }
+    case SyncReply: {
+        uint32_t reference = referenceAddress.load(std::memory_order_relaxed);
+        if (length < SYNC_REPLY_SIZE || static_cast<uint32_t>(packet.remoteIP()) != reference) {
+            return;
+        }
+        int64_t t1 = readLe(&data[HEADER_SIZE], 8);
+        int64_t t2 = readLe(&data[HEADER_SIZE + 8], 8);
+        int64_t t3 = readLe(&data[HEADER_SIZE + 16], 8);
+        uint32_t generation = referenceGeneration.load(std::memory_order_relaxed);
+        if (generation != sampledGeneration) {
+            sampledGeneration = generation;
+            filter.reset();
+        }
+        estimate.store(filter.add(ClockFilter::computeSample(t1, t2, t3, received)));
+        break;
+    }
+    case CuePacket: {
+        if (length < CUE_PACKET_SIZE) {
+            return;
+        }
+        const uint8_t *payload = &data[HEADER_SIZE];
+        Cue cue;
+        cue.atMs = readLe(payload, 4);
+        cue.red = map(payload[4], 0, 255, 0, 2047);
+        cue.green = map(payload[5], 0, 255, 0, 2047);
+        cue.blue = map(payload[6], 0, 255, 0, 2047);
+        cue.fadeMs = readLe(&payload[7], 2);
+        scheduleCue(cue);
+        break;
+    }
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef CUE_SYNC_H
+#define CUE_SYNC_H
+
+#include "Platform.h"
+#include <AsyncUDP.h>
+#include <atomic>
+#include "ControlMailbox.h"
+#include "ClockFilter.h"
+
+// A color or fade to start at an absolute shared time
+struct Cue {
+    uint32_t atMs = 0;     // Shared clock, see CueSync::sharedMillis()
+    uint16_t red = 0;      // 11-bit PWM scale
+    uint16_t green = 0;
+    uint16_t blue = 0;
+    uint16_t fadeMs = 0;
+};
+
+// Shared clock and cue playback for several lamps on one network.
+//
+// Every lamp answers sync requests on SYNC_PORT with its own clock. A lamp
+// given a reference address polls it and keeps the offset from the exchange
+// with the lowest round trip out of the last few (the NTP clock filter), so
+// a delayed packet can't pull the clock. Without a reference a lamp's shared
+// clock is its own, which makes it the reference for the others.
+//
+// Cues arrive over HTTP or as a UDP datagram (which a controller can send
+// to the broadcast address to reach every lamp at once) and are fired by the
+// control loop on the first tick at or after their shared time.
+class CueSync {
+public:
+    static constexpr uint16_t SYNC_PORT = 4210;
+    static constexpr int FILTER_SAMPLES = ClockFilter::SAMPLES;
+    static constexpr int MAX_PENDING_CUES = 8;
+    static constexpr uint32_t POLL_INTERVAL_MS = 1000;
+    static constexpr uint32_t FAST_POLL_INTERVAL_MS = 100; // Until the filter is full
+
+    void begin();
+    void stop();
+
+    // 0.0.0.0 makes this lamp its own reference. Safe from any task
+    void setReference(IPAddress address);
+    IPAddress getReference() const { return IPAddress(referenceAddress.load(std::memory_order_relaxed)); }
+
+    // Queues a cue from any task; false if the queue is full
+    bool scheduleCue(const Cue& cue);
+
+    // Control loop side: sends sync polls and returns the next cue that is due
+    void update(uint32_t nowMs);
+    bool takeDueCue(Cue& out);
+
+    uint32_t sharedMillis() const;
+    int64_t getOffsetMicros() const;
+    int64_t getDelayMicros() const { return estimate.load().delay; }
+
+private:
+    enum PacketType : uint8_t { SyncRequest = 1, SyncReply = 2, CuePacket = 3 };
+
+    AsyncUDP socket;
+    bool running = false;
+    std::atomic<uint32_t> referenceAddress{0};
+    std::atomic<uint32_t> referenceGeneration{0}; // Bumped by setReference
+    QueueHandle_t cueQueue = nullptr;
+
+    // Control loop only
+    Cue pending[MAX_PENDING_CUES];
+    int pendingCount = 0;
+    uint32_t lastPollMs = 0;
+    uint32_t polledGeneration = 0;
+    int fastPollsLeft = 0;
+
+    // async_udp task only
+    ClockFilter filter;
+    uint32_t sampledGeneration = 0;
+
+    // Written by the async_udp task, read everywhere else
+    SeqLock<ClockSample> estimate;
+
+    void handlePacket(AsyncUDPPacket& packet);
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef SIGMA_DELTA_DITHER_H
+#define SIGMA_DELTA_DITHER_H
+
+#include "Platform.h"
+#include <atomic>
+
+// First-order sigma-delta across PWM updates. Each channel takes a 16-bit
+// target whose low FRACTION_BITS sit below the hardware duty resolution; the
+// fractional part accumulates per update and carries one extra duty code
+// whenever it overflows, so the long-run average duty equals the target.
+//
+// setTargets() publishes every channel at once and may be called from any
+// one task. The dither timer callback calls latch() once per tick and then
+// next() per channel, so a tick always works from one complete set of
+// targets, never some channels from one color and some from the next.
+//
+// Targets are double-buffered behind a generation count that is odd while a
+// write is in progress: the writer fills the buffer the reader isn't using
+// and then publishes it. latch() never waits. The timer task outranks the
+// writer, so on the single-core C3 it can't observe a half-written buffer.
+// If it ever did (the writer coming round to the same buffer mid-copy on a
+// multi-core part), it keeps the previous snapshot for one more tick rather
+// than spin on a writer it may be preempting.
+template <int CHANNELS, int FRACTION_BITS>
+class SigmaDeltaDither {
+public:
+    static constexpr uint32_t FRACTION_ONE = 1UL << FRACTION_BITS;
+    static constexpr uint32_t FRACTION_MASK = FRACTION_ONE - 1;
+    static constexpr uint32_t MAX_DUTY = (1UL << (16 - FRACTION_BITS)) - 1;
+
+    void setTargets(const uint16_t targets[CHANNELS]) {
+        uint32_t published = generation.load(std::memory_order_relaxed);
+        generation.store(published + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        Buffer& buffer = buffers[((published >> 1) + 1) & 1];
+        for (int i = 0; i < CHANNELS; i++) {
+            buffer.targets[i].store(targets[i], std::memory_order_relaxed);
+        }
+        generation.store(published + 2, std::memory_order_release);
+    }
+
+    // Takes the newest complete set of targets for this tick
+    void latch() {
+        uint32_t published = generation.load(std::memory_order_acquire) & ~1UL;
+        const Buffer& buffer = buffers[(published >> 1) & 1];
+        uint16_t copy[CHANNELS];
+        for (int i = 0; i < CHANNELS; i++) {
+            copy[i] = buffer.targets[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // The writer only returns to this buffer two writes later
+        if (generation.load(std::memory_order_relaxed) - published >= 3) {
+            return;
+        }
+        for (int i = 0; i < CHANNELS; i++) {
+            latched[i] = copy[i];
+        }
+    }
+
+    // Target in use since the last latch(); timer callback only
+    uint16_t getLatched(int channel) const { return latched[channel]; }
+
+    uint32_t next(int channel) {
+        uint32_t target = latched[channel];
+        uint32_t duty = target >> FRACTION_BITS;
+        uint32_t accumulated = error[channel] + (target & FRACTION_MASK);
+        if (accumulated >= FRACTION_ONE) {
+            accumulated -= FRACTION_ONE;
+            duty++;
+        }
+        error[channel] = accumulated;
+        return duty > MAX_DUTY ? MAX_DUTY : duty;
+    }
+
+private:
+    struct Buffer {
+        std::atomic<uint16_t> targets[CHANNELS] = {};
+    };
+
+    Buffer buffers[2];
+    std::atomic<uint32_t> generation{0};
+    uint16_t latched[CHANNELS] = {0};   // Timer callback only
+    uint32_t error[CHANNELS] = {0};
+};
+
+#endif
@@ -0,0 +1,76 @@
+#include "DmxPacket.h"
+
+static const uint8_t ARTNET_ID[8] = {'A', 'r', 't', '-', 'N', 'e', 't', 0};
+static const uint16_t ARTNET_OP_DMX = 0x5000;
+static const size_t ARTNET_HEADER = 18;
+
+static const uint8_t E131_ACN_ID[12] = {'A', 'S', 'C', '-', 'E', '1', '.', '1', '7', 0, 0, 0};
+static const size_t E131_HEADER = 126;
+static const uint8_t E131_OPTION_TERMINATED = 0x40;
+static const uint8_t E131_OPTION_PREVIEW = 0x80;
+
+static uint16_t readBigEndian16(const uint8_t *p) {
+    return (p[0] << 8) | p[1];
+}
+
+static uint32_t readBigEndian32(const uint8_t *p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+}
+
+static bool copySlots(const uint8_t *slots, uint16_t slotCount, uint16_t startAddress, uint8_t out[DmxPacket::CHANNELS]) {
+    if (startAddress < 1 || startAddress + DmxPacket::CHANNELS - 1 > slotCount) {
+        return false;
+    }
+    for (int i = 0; i < DmxPacket::CHANNELS; i++) {
+        out[i] = slots[startAddress - 1 + i];
+    }
+    return true;
+}
+
+bool DmxPacket::parseArtNet(const uint8_t *data, size_t length, uint16_t universe, uint16_t startAddress,
+                              uint8_t &sequence, uint8_t out[CHANNELS]) {
+    if (length < ARTNET_HEADER || memcmp(data, ARTNET_ID, sizeof(ARTNET_ID)) != 0) {
+        return false;
+    }
+    uint16_t opcode = data[8] | (data[9] << 8);
+    if (opcode != ARTNET_OP_DMX) {
+        return false;
+    }
+    // 15-bit port address: Net (7 bits) then SubUni (8 bits)
+    uint16_t portAddress = ((data[15] & 0x7F) << 8) | data[14];
+    if (portAddress != universe) {
+        return false;
+    }
+    uint16_t slotCount = readBigEndian16(&data[16]);
+    if (slotCount > 512 || ARTNET_HEADER + slotCount > length) {
+        return false;
+    }
+    sequence = data[12];
+    return copySlots(&data[ARTNET_HEADER], slotCount, startAddress, out);
+}
+
+bool DmxPacket::parseE131(const uint8_t *data, size_t length, uint16_t universe, uint16_t startAddress,
+                            uint8_t &sequence, uint8_t out[CHANNELS]) {
+    if (length < E131_HEADER || readBigEndian16(&data[0]) != 0x0010 ||
+        memcmp(&data[4], E131_ACN_ID, sizeof(E131_ACN_ID)) != 0) {
+        return false;
+    }
+    // Root vector E1.31 data, framing vector data packet, DMP set property
+    if (readBigEndian32(&data[18]) != 0x00000004 || readBigEndian32(&data[40]) != 0x00000002 || data[117] != 0x02) {
+        return false;
+    }
+    uint8_t options = data[112];
+    if (options & (E131_OPTION_TERMINATED | E131_OPTION_PREVIEW)) {
+        return false;
+    }
+    if (readBigEndian16(&data[113]) != universe) {
+        return false;
+    }
+    // Property value count includes the start code, which must be 0 (dimmer data)
+    uint16_t valueCount = readBigEndian16(&data[123]);
+    if (valueCount < 1 || valueCount > 513 || E131_HEADER - 1 + valueCount > length || data[125] != 0) {
+        return false;
+    }
+    sequence = data[111];
+    return copySlots(&data[E131_HEADER], valueCount - 1, startAddress, out);
+}
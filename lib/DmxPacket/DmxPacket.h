@@ -0,0 +1,30 @@
+#ifndef DMX_PACKET_H
+#define DMX_PACKET_H
+
+#include "Platform.h"
+
+// Art-Net ArtDmx and E1.31 (sACN) packet parsing. Kept apart from
+// DmxReceiver's sockets so the native build can run it against generated
+// packets.
+class DmxPacket {
+public:
+    static constexpr uint16_t ARTNET_PORT = 6454;
+    static constexpr uint16_t E131_PORT = 5568;
+    static constexpr int CHANNELS = 3;
+
+    // Parsers work on the raw packet and copy out only the patched slots.
+    // sequence is set to the packet's sequence number (0 = not sequenced)
+    static bool parseArtNet(const uint8_t *data, size_t length, uint16_t universe, uint16_t startAddress,
+                            uint8_t &sequence, uint8_t out[CHANNELS]);
+    static bool parseE131(const uint8_t *data, size_t length, uint16_t universe, uint16_t startAddress,
+                          uint8_t &sequence, uint8_t out[CHANNELS]);
+
+    // Protocol rule (E1.31 6.7.2): a sequence number up to 20 behind the last one
+    // is a late, out-of-order packet and is discarded
+    static bool isStale(uint8_t last, uint8_t incoming) {
+        int8_t delta = static_cast<int8_t>(incoming - last);
+        return delta <= 0 && delta > -20;
+    }
+};
+
+#endif
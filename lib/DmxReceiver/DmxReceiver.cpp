@@ -0,0 +1,77 @@
+#include "DmxReceiver.h"
+#include "Log.h"
+#include "Metrics.h"
+
+void DmxReceiver::begin(uint16_t universe, uint16_t startAddress) {
+    patchedUniverse.store(universe, std::memory_order_relaxed);
+    patchedStart.store(startAddress, std::memory_order_relaxed);
+    listen();
+}
+
+void DmxReceiver::listen() {
+    if (artnetSocket.listen(ARTNET_PORT)) {
+        artnetSocket.onPacket([this](AsyncUDPPacket packet) { handlePacket(packet, Protocol::ArtNet); });
+    }
+    // sACN is multicast to 239.255.<universe hi>.<universe lo>; unicast also arrives on this port
+    uint16_t universe = patchedUniverse.load(std::memory_order_relaxed);
+    if (e131Socket.listenMulticast(IPAddress(239, 255, universe >> 8, universe & 0xFF), E131_PORT)) {
+        e131Socket.onPacket([this](AsyncUDPPacket packet) { handlePacket(packet, Protocol::E131); });
+    }
+    running = true;
+    LOG_INFO("DMX listening on universe %u, address %u\n", universe, patchedStart.load(std::memory_order_relaxed));
+}
+
+void DmxReceiver::stop() {
+    artnetSocket.close();
+    e131Socket.close();
+    running = false;
+}
+
+void DmxReceiver::configure(uint16_t universe, uint16_t startAddress) {
+    bool universeChanged = universe != patchedUniverse.load(std::memory_order_relaxed);
+    patchedUniverse.store(universe, std::memory_order_relaxed);
+    patchedStart.store(startAddress, std::memory_order_relaxed);
+    if (running && universeChanged) {
+        // Rejoin the multicast group for the new universe
+        stop();
+        listen();
+    }
+}
+
+void DmxReceiver::handlePacket(AsyncUDPPacket &packet, Protocol protocol) {
+    uint16_t universe = patchedUniverse.load(std::memory_order_relaxed);
+    uint16_t startAddress = patchedStart.load(std::memory_order_relaxed);
+    uint8_t sequence = 0;
+    uint8_t levels[CHANNELS];
+    bool parsed = protocol == Protocol::E131
+                      ? DmxPacket::parseE131(packet.data(), packet.length(), universe, startAddress, sequence, levels)
+                      : DmxPacket::parseArtNet(packet.data(), packet.length(), universe, startAddress, sequence, levels);
+    if (!parsed) {
+        return;
+    }
+
+    // Art-Net uses sequence 0 to mean "not sequenced"
+    int index = static_cast<int>(protocol);
+    bool sequenced = protocol == Protocol::E131 || sequence != 0;
+    if (sequenced && haveSequence[index] && DmxPacket::isStale(lastSequence[index], sequence)) {
+        Metrics::dmxStale.increment();
+        return;
+    }
+    lastSequence[index] = sequence;
+    haveSequence[index] = sequenced;
+
+    published.seq++;
+    memcpy(published.levels, levels, sizeof(levels));
+    latest.store(published);
+    Metrics::dmxFrames.increment();
+}
+
+bool DmxReceiver::poll(uint8_t levels[CHANNELS]) {
+    DmxFrame frame = latest.load();
+    if (frame.seq == polledSeq) {
+        return false;
+    }
+    polledSeq = frame.seq;
+    memcpy(levels, frame.levels, sizeof(frame.levels));
+    return true;
+}
@@ -0,0 +1,55 @@
+#ifndef DMX_RECEIVER_H
+#define DMX_RECEIVER_H
+
+#include "Platform.h"
+#include <AsyncUDP.h>
+#include <atomic>
+#include "DmxPacket.h"
+#include "ControlMailbox.h"
+
+// Latest three DMX slots for the patched start address
+struct DmxFrame {
+    uint32_t seq = 0;
+    uint8_t levels[3] = {0};
+};
+
+// Receives E1.31 (sACN) and Art-Net ArtDmx packets for one universe. Packets
+// are parsed in place by DmxPacket from the UDP receive buffer on the
+// async_udp task and the three patched slots are published through a
+// seqlock; the control loop picks up the newest frame with poll().
+class DmxReceiver {
+public:
+    static constexpr uint16_t ARTNET_PORT = DmxPacket::ARTNET_PORT;
+    static constexpr uint16_t E131_PORT = DmxPacket::E131_PORT;
+    static constexpr int CHANNELS = DmxPacket::CHANNELS;
+
+    enum class Protocol : uint8_t { ArtNet, E131 };
+
+    // Control loop side
+    void begin(uint16_t universe, uint16_t startAddress);
+    void stop();
+    void configure(uint16_t universe, uint16_t startAddress);
+    bool poll(uint8_t levels[CHANNELS]);
+    bool isRunning() const { return running; }
+
+private:
+    AsyncUDP artnetSocket;
+    AsyncUDP e131Socket;
+    bool running = false;
+
+    std::atomic<uint16_t> patchedUniverse{1};
+    std::atomic<uint16_t> patchedStart{1};
+
+    // async_udp task only
+    uint8_t lastSequence[2] = {0};
+    bool haveSequence[2] = {false};
+    DmxFrame published;
+
+    SeqLock<DmxFrame> latest;
+    uint32_t polledSeq = 0; // Control loop only
+
+    void handlePacket(AsyncUDPPacket &packet, Protocol protocol);
+    void listen();
+};
+
+#endif
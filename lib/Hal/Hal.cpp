@@ -0,0 +1,260 @@
+// Native-build Hal: the fake hardware behind HalFake.h. The device build
+// uses the inline definitions in Hal.h and compiles nothing from this file.
+#ifndef ARDUINO
+
+#include "HalFake.h"
+#include "HostPreferences.h"
+
+HostSerial Serial;
+
+namespace {
+
+constexpr int PIN_COUNT = 32;
+constexpr int MAX_TIMERS = 4;
+
+struct PeriodicTimer {
+    Hal::TimerCallback callback;
+    void* arg;
+    uint32_t periodMicros;
+    uint64_t nextDue;
+};
+
+struct FakeState {
+    uint64_t nowMicros = 0;
+    PeriodicTimer timers[MAX_TIMERS] = {};
+    int timerCount = 0;
+    int taskCount = 0;
+
+    int pinLevels[PIN_COUNT];
+    Hal::EdgeCallback edgeHandlers[PIN_COUNT] = {};
+    void* edgeArgs[PIN_COUNT] = {};
+    uint16_t adcMilliVolts[PIN_COUNT] = {};
+
+    uint32_t stagedDuty[Hal::PWM_MAX_CHANNELS] = {};
+    uint32_t latchedDuty[Hal::PWM_MAX_CHANNELS] = {};
+    uint32_t stages = 0;
+    uint32_t latches = 0;
+    uint32_t periodTicks = 1UL << 11;
+    uint32_t latchStartTick = 0;
+    uint32_t latchTicks = 0;
+    Hal::Fake::LatchObserver latchObserver = nullptr;
+    void* latchObserverArg = nullptr;
+
+    uint32_t cpuMhz = 160;
+    uint32_t sleepTimerMicros = 0;
+    uint32_t lightSleeps = 0;
+    int sleepPressPin = -1;         // Pressed sleepPressAfterMicros into the next light sleep
+    uint32_t sleepPressAfterMicros = 0;
+    uint32_t sleepExitMicros = 0;
+    uint32_t clockSwitchMicros = 0;
+    uint32_t restarts = 0;
+    uint32_t freeHeap = 200000;
+    uint32_t largestBlock = 110000;
+
+    FakeState() {
+        for (int& level : pinLevels) {
+            level = 1;
+        }
+    }
+};
+
+FakeState fake;
+
+bool validPin(int pin) {
+    return pin >= 0 && pin < PIN_COUNT;
+}
+
+}
+
+namespace Hal {
+
+uint32_t nowMillis() { return static_cast<uint32_t>(fake.nowMicros / 1000); }
+uint32_t nowMicros() { return static_cast<uint32_t>(fake.nowMicros); }
+int64_t nowMicros64() { return static_cast<int64_t>(fake.nowMicros); }
+
+bool pwmTimerSetup(uint32_t /*frequency*/, int resolutionBits) {
+    fake.periodTicks = 1UL << resolutionBits;
+    return true;
+}
+bool pwmChannelSetup(int /*pin*/, int channel) { return channel >= 0 && channel < PWM_MAX_CHANNELS; }
+
+void pwmStage(int channel, uint32_t duty) {
+    fake.stagedDuty[channel] = duty;
+    fake.stages++;
+}
+
+// Starts at the scripted counter value, or at latestTick - 1 if that is
+// later than the wait would allow, and takes the scripted number of ticks
+LatchTiming pwmLatch(uint32_t channelMask, uint32_t latestTick) {
+    uint32_t start = fake.latchStartTick < latestTick ? fake.latchStartTick : latestTick - 1;
+    for (int channel = 0; channel < PWM_MAX_CHANNELS; channel++) {
+        if (channelMask & (1UL << channel)) {
+            fake.latchedDuty[channel] = fake.stagedDuty[channel];
+        }
+    }
+    fake.latches++;
+    if (fake.latchObserver != nullptr) {
+        fake.latchObserver(nowMicros(), channelMask, fake.latchObserverArg);
+    }
+    return {start, (start + fake.latchTicks) % fake.periodTicks};
+}
+
+uint16_t adcMilliVolts(int pin) { return validPin(pin) ? fake.adcMilliVolts[pin] : 0; }
+
+bool startPeriodicTimer(TimerCallback callback, void* arg, uint32_t periodMicros, const char* /*name*/) {
+    if (fake.timerCount == MAX_TIMERS || periodMicros == 0) {
+        return false;
+    }
+    fake.timers[fake.timerCount++] = {callback, arg, periodMicros, fake.nowMicros + periodMicros};
+    return true;
+}
+
+void attachEdgeInterrupt(int pin, EdgeCallback handler, void* arg) {
+    if (validPin(pin)) {
+        fake.edgeHandlers[pin] = handler;
+        fake.edgeArgs[pin] = arg;
+    }
+}
+
+int pinLevel(int pin) { return validPin(pin) ? fake.pinLevels[pin] : 1; }
+
+bool setCpuMhz(uint32_t mhz) {
+    if (fake.cpuMhz != mhz) {
+        fake.nowMicros += fake.clockSwitchMicros;
+    }
+    fake.cpuMhz = mhz;
+    return true;
+}
+
+void configureSleepWakeups(uint32_t timerMicros) { fake.sleepTimerMicros = timerMicros; }
+
+// A held button wakes at once; a press scheduled with pressDuringSleep()
+// wakes at its time, pulling the pin low without an edge interrupt, as the
+// masked GPIO interrupt would miss it; otherwise the chip sleeps out the
+// timer. Either way the chip then takes the sleep exit time to resume.
+// Periodic timers are not run across the sleep, like the stalled esp_timer
+bool lightSleep(int wakePin, uint32_t& wakeMicros) {
+    fake.lightSleeps++;
+    wakeMicros = nowMicros();
+    if (pinLevel(wakePin) == 0) {
+        return true;
+    }
+    bool pressed = fake.sleepPressPin == wakePin && fake.sleepPressAfterMicros < fake.sleepTimerMicros;
+    fake.sleepPressPin = -1;
+    fake.nowMicros += pressed ? fake.sleepPressAfterMicros : fake.sleepTimerMicros;
+    wakeMicros = nowMicros();
+    fake.nowMicros += fake.sleepExitMicros;
+    if (pressed) {
+        fake.pinLevels[wakePin] = 0;
+    }
+    for (int i = 0; i < fake.timerCount; i++) {
+        PeriodicTimer& timer = fake.timers[i];
+        while (timer.nextDue <= fake.nowMicros) {
+            timer.nextDue += timer.periodMicros;
+        }
+    }
+    return pressed;
+}
+
+uint32_t freeHeap() { return fake.freeHeap; }
+uint32_t largestFreeBlock() { return fake.largestBlock; }
+void restart() { fake.restarts++; }
+
+// Tasks are never run; tests call the work a task would do directly
+bool startTask(TaskFunction /*function*/, const char* /*name*/, uint32_t /*stackBytes*/, void* /*arg*/, int /*priority*/) {
+    fake.taskCount++;
+    return true;
+}
+
+void sleepMillis(uint32_t ms) { Fake::advanceMicros((ms > 0 ? ms : 1) * 1000); }
+uint32_t taskTicks() { return nowMillis(); }
+
+void sleepUntil(uint32_t& lastWake, uint32_t periodMs) {
+    lastWake += periodMs > 0 ? periodMs : 1;
+    int32_t remaining = static_cast<int32_t>(lastWake - nowMillis());
+    if (remaining > 0) {
+        Fake::advanceMicros(remaining * 1000);
+    }
+}
+
+namespace Fake {
+
+void reset() {
+    fake = FakeState();
+    Preferences::eraseAll();
+}
+
+void advanceMicros(uint32_t micros) {
+    uint64_t target = fake.nowMicros + micros;
+    for (;;) {
+        PeriodicTimer* due = nullptr;
+        for (int i = 0; i < fake.timerCount; i++) {
+            if (fake.timers[i].nextDue <= target && (due == nullptr || fake.timers[i].nextDue < due->nextDue)) {
+                due = &fake.timers[i];
+            }
+        }
+        if (due == nullptr) {
+            break;
+        }
+        fake.nowMicros = due->nextDue;
+        due->nextDue += due->periodMicros;
+        due->callback(due->arg);
+    }
+    fake.nowMicros = target;
+}
+
+void pressDuringSleep(int pin, uint32_t afterMicros) {
+    fake.sleepPressPin = pin;
+    fake.sleepPressAfterMicros = afterMicros;
+}
+
+void setPowerTiming(uint32_t sleepExitMicros, uint32_t clockSwitchMicros) {
+    fake.sleepExitMicros = sleepExitMicros;
+    fake.clockSwitchMicros = clockSwitchMicros;
+}
+
+void setPinLevel(int pin, int level) {
+    if (!validPin(pin) || fake.pinLevels[pin] == level) {
+        return;
+    }
+    fake.pinLevels[pin] = level;
+    if (fake.edgeHandlers[pin] != nullptr) {
+        fake.edgeHandlers[pin](fake.edgeArgs[pin]);
+    }
+}
+
+void setAdcMilliVolts(int pin, uint16_t milliVolts) {
+    if (validPin(pin)) {
+        fake.adcMilliVolts[pin] = milliVolts;
+    }
+}
+
+void setHeap(uint32_t freeBytes, uint32_t largestBlock) {
+    fake.freeHeap = freeBytes;
+    fake.largestBlock = largestBlock;
+}
+
+void setLatchTiming(uint32_t startTick, uint32_t durationTicks) {
+    fake.latchStartTick = startTick;
+    fake.latchTicks = durationTicks;
+}
+
+uint32_t latchedDuty(int channel) { return fake.latchedDuty[channel]; }
+uint32_t stageCount() { return fake.stages; }
+uint32_t latchCount() { return fake.latches; }
+
+void setLatchObserver(LatchObserver observer, void* arg) {
+    fake.latchObserver = observer;
+    fake.latchObserverArg = arg;
+}
+
+uint32_t cpuMhz() { return fake.cpuMhz; }
+int timerCount() { return fake.timerCount; }
+int taskCount() { return fake.taskCount; }
+uint32_t lightSleepCount() { return fake.lightSleeps; }
+uint32_t restartCount() { return fake.restarts; }
+
+}
+}
+
+#endif
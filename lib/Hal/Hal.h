@@ -0,0 +1,217 @@
+#ifndef HAL_H
+#define HAL_H
+
+#include "Platform.h"
+#ifdef ARDUINO
+#include <esp_timer.h>
+#include <esp_sleep.h>
+#include <driver/gpio.h>
+#include <driver/ledc.h>
+#include <hal/gpio_ll.h>
+#include <hal/ledc_ll.h>
+#endif
+
+// The hardware and RTOS services the libraries touch: clocks, LEDC, the pot
+// ADC, the button pin, the dither timer, CPU clock and sleep, heap figures
+// and background tasks. Nothing outside Hal calls the core for these, so the
+// native build links Hal.cpp instead (fake clock, recorded duty writes,
+// scripted ADC and pin levels, see HalFake.h) without touching the callers.
+//
+// On the device everything is an inline forward to the Arduino core or
+// ESP-IDF, so the seam costs nothing. nowMicros() and pinLevel() are forced
+// inline because the button ISR uses them, and an out-of-line copy would
+// not be in IRAM.
+namespace Hal {
+
+typedef void (*TimerCallback)(void* arg);
+typedef void (*EdgeCallback)(void* arg);
+typedef void (*TaskFunction)(void* arg);
+
+constexpr int PWM_MAX_CHANNELS = 6; // LEDC channels on the C3
+
+// LEDC timer 0 counter when a latch began its writes and when it finished.
+// endTick below startTick means the period rolled over during the writes,
+// so the channels may have switched one period apart
+struct LatchTiming {
+    uint32_t startTick;
+    uint32_t endTick;
+};
+
+#ifdef ARDUINO
+
+inline uint32_t nowMillis() { return millis(); }
+__attribute__((always_inline)) inline uint32_t nowMicros() { return micros(); }
+// Never wraps; for clocks compared across devices
+inline int64_t nowMicros64() { return esp_timer_get_time(); }
+
+// Every PWM channel runs from LEDC timer 0, so all outputs share one period
+inline bool pwmTimerSetup(uint32_t frequency, int resolutionBits) {
+    ledc_timer_config_t timer = {};
+    timer.speed_mode = LEDC_LOW_SPEED_MODE;
+    timer.duty_resolution = static_cast<ledc_timer_bit_t>(resolutionBits);
+    timer.timer_num = LEDC_TIMER_0;
+    timer.freq_hz = frequency;
+    timer.clk_cfg = LEDC_AUTO_CLK;
+    return ledc_timer_config(&timer) == ESP_OK;
+}
+
+inline bool pwmChannelSetup(int pin, int channel) {
+    ledc_channel_config_t config = {};
+    config.gpio_num = pin;
+    config.speed_mode = LEDC_LOW_SPEED_MODE;
+    config.channel = static_cast<ledc_channel_t>(channel);
+    config.timer_sel = LEDC_TIMER_0;
+    config.duty = 0;
+    config.hpoint = 0;
+    return ledc_channel_config(&config) == ESP_OK;
+}
+
+// Writes a channel's next duty into LEDC without latching it; the pin keeps
+// its current duty until pwmLatch()
+inline void pwmStage(int channel, uint32_t duty) {
+    ledc_channel_t ch = static_cast<ledc_channel_t>(channel);
+    ledc_ll_set_duty_int_part(&LEDC, LEDC_LOW_SPEED_MODE, ch, duty);
+    ledc_ll_set_duty_direction(&LEDC, LEDC_LOW_SPEED_MODE, ch, LEDC_DUTY_DIR_INCREASE);
+    ledc_ll_set_duty_num(&LEDC, LEDC_LOW_SPEED_MODE, ch, 1);
+    ledc_ll_set_duty_cycle(&LEDC, LEDC_LOW_SPEED_MODE, ch, 1);
+    ledc_ll_set_duty_scale(&LEDC, LEDC_LOW_SPEED_MODE, ch, 0);
+}
+
+// Latches every channel in channelMask at the same timer overflow. The
+// per-channel update bits are separate registers, so the writes wait while
+// the timer 0 counter is at or past latestTick, where an overflow could land
+// between them. The counter is read again after the writes, so the caller
+// can check the guard against what the writes actually took
+inline LatchTiming pwmLatch(uint32_t channelMask, uint32_t latestTick) {
+    static portMUX_TYPE latchLock = portMUX_INITIALIZER_UNLOCKED;
+    volatile auto& counter = LEDC.timer_group[LEDC_LOW_SPEED_MODE].timer[LEDC_TIMER_0].value;
+    LatchTiming timing;
+    portENTER_CRITICAL(&latchLock);
+    do {
+        timing.startTick = counter.timer_cnt;
+    } while (timing.startTick >= latestTick);
+    for (int channel = 0; channel < PWM_MAX_CHANNELS; channel++) {
+        if (channelMask & (1UL << channel)) {
+            ledc_channel_t ch = static_cast<ledc_channel_t>(channel);
+            ledc_ll_set_sig_out_en(&LEDC, LEDC_LOW_SPEED_MODE, ch, true);
+            ledc_ll_set_duty_start(&LEDC, LEDC_LOW_SPEED_MODE, ch, true);
+            ledc_ll_ls_channel_update(&LEDC, LEDC_LOW_SPEED_MODE, ch);
+        }
+    }
+    timing.endTick = counter.timer_cnt;
+    portEXIT_CRITICAL(&latchLock);
+    return timing;
+}
+
+inline uint16_t adcMilliVolts(int pin) { return analogReadMilliVolts(pin); }
+
+// Runs callback on the esp_timer task every periodMicros; false if the timer
+// could not be created. Periods missed while the clock was stopped (light
+// sleep) are dropped, not replayed as a burst of back-to-back callbacks
+inline bool startPeriodicTimer(TimerCallback callback, void* arg, uint32_t periodMicros, const char* name) {
+    esp_timer_create_args_t timerArgs = {};
+    timerArgs.callback = callback;
+    timerArgs.arg = arg;
+    timerArgs.dispatch_method = ESP_TIMER_TASK;
+    timerArgs.name = name;
+    timerArgs.skip_unhandled_events = true;
+    esp_timer_handle_t timer;
+    if (esp_timer_create(&timerArgs, &timer) != ESP_OK) {
+        return false;
+    }
+    return esp_timer_start_periodic(timer, periodMicros) == ESP_OK;
+}
+
+// Input pin with handler called from an interrupt on both edges
+inline void attachEdgeInterrupt(int pin, EdgeCallback handler, void* arg) {
+    pinMode(pin, INPUT);
+    attachInterruptArg(pin, handler, arg, CHANGE);
+}
+
+// Straight from the GPIO register, so it is safe in an ISR while flash is busy
+__attribute__((always_inline)) inline int pinLevel(int pin) {
+    return gpio_ll_get_level(&GPIO, static_cast<gpio_num_t>(pin));
+}
+
+inline bool setCpuMhz(uint32_t mhz) { return setCpuFrequencyMhz(mhz); }
+
+// Wake sources for lightSleep(): the timer after timerMicros, and the pin
+// armed there
+inline void configureSleepWakeups(uint32_t timerMicros) {
+    esp_sleep_enable_timer_wakeup(timerMicros);
+    esp_sleep_enable_gpio_wakeup();
+}
+
+// Light-sleeps until wakePin is pulled low or the timer wake fires; true if
+// the pin woke the chip. The wake source shares the pin with an edge
+// interrupt, and arming it switches the pin to a level trigger, so the edge
+// interrupt is masked for the duration and restored afterwards.
+//
+// wakeMicros is the earliest time the wake can be placed at. The C3 doesn't
+// timestamp the GPIO wake, so here that is the first instruction after
+// esp_light_sleep_start(); the chip's own sleep exit before it is not counted
+inline bool lightSleep(int wakePin, uint32_t& wakeMicros) {
+    gpio_num_t pin = static_cast<gpio_num_t>(wakePin);
+    gpio_intr_disable(pin);
+    gpio_wakeup_enable(pin, GPIO_INTR_LOW_LEVEL);
+    esp_light_sleep_start();
+    wakeMicros = nowMicros();
+    gpio_wakeup_disable(pin);
+    gpio_set_intr_type(pin, GPIO_INTR_ANYEDGE);
+    gpio_intr_enable(pin);
+    return esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_GPIO;
+}
+
+inline uint32_t freeHeap() { return ESP.getFreeHeap(); }
+inline uint32_t largestFreeBlock() { return ESP.getMaxAllocHeap(); }
+inline void restart() { ESP.restart(); }
+
+inline bool startTask(TaskFunction function, const char* name, uint32_t stackBytes, void* arg, int priority) {
+    return xTaskCreate(function, name, stackBytes, arg, priority, nullptr) == pdPASS;
+}
+
+// Blocks the calling task for at least one tick
+inline void sleepMillis(uint32_t ms) {
+    TickType_t ticks = pdMS_TO_TICKS(ms);
+    vTaskDelay(ticks > 0 ? ticks : 1);
+}
+
+// Fixed-rate task loops: lastWake starts at taskTicks() and sleepUntil()
+// advances it by periodMs each call, so the period doesn't drift
+inline uint32_t taskTicks() { return xTaskGetTickCount(); }
+inline void sleepUntil(uint32_t& lastWake, uint32_t periodMs) {
+    TickType_t ticks = pdMS_TO_TICKS(periodMs);
+    TickType_t wake = lastWake;
+    vTaskDelayUntil(&wake, ticks > 0 ? ticks : 1);
+    lastWake = wake;
+}
+
+#else
+
+uint32_t nowMillis();
+uint32_t nowMicros();
+int64_t nowMicros64();
+bool pwmTimerSetup(uint32_t frequency, int resolutionBits);
+bool pwmChannelSetup(int pin, int channel);
+void pwmStage(int channel, uint32_t duty);
+LatchTiming pwmLatch(uint32_t channelMask, uint32_t latestTick);
+uint16_t adcMilliVolts(int pin);
+bool startPeriodicTimer(TimerCallback callback, void* arg, uint32_t periodMicros, const char* name);
+void attachEdgeInterrupt(int pin, EdgeCallback handler, void* arg);
+int pinLevel(int pin);
+bool setCpuMhz(uint32_t mhz);
+void configureSleepWakeups(uint32_t timerMicros);
+bool lightSleep(int wakePin, uint32_t& wakeMicros);
+uint32_t freeHeap();
+uint32_t largestFreeBlock();
+void restart();
+bool startTask(TaskFunction function, const char* name, uint32_t stackBytes, void* arg, int priority);
+void sleepMillis(uint32_t ms);
+uint32_t taskTicks();
+void sleepUntil(uint32_t& lastWake, uint32_t periodMs);
+
+#endif
+
+}
+
+#endif
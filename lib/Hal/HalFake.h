@@ -0,0 +1,54 @@
+#ifndef HAL_FAKE_H
+#define HAL_FAKE_H
+
+#include "Hal.h"
+
+#ifndef ARDUINO
+
+// Control side of the native Hal. Time only moves when a test moves it, and
+// periodic timers (the dither tick) fire from advanceMicros() at their exact
+// due times, so runs are deterministic. Pins idle high; setPinLevel() calls
+// the pin's edge handler the way the GPIO interrupt would.
+namespace Hal {
+namespace Fake {
+
+typedef void (*LatchObserver)(uint32_t timeMicros, uint32_t channelMask, void* arg);
+
+// Clock to zero, pins high, ADC at 0 mV, no timers or tasks, outputs dark,
+// full CPU clock and an empty Preferences store
+void reset();
+
+// Moves the clock forward, running every periodic timer that falls due on the way
+void advanceMicros(uint32_t micros);
+inline void advanceMillis(uint32_t millis) { advanceMicros(millis * 1000); }
+
+void setPinLevel(int pin, int level);
+// The next light sleep is ended by pin going low afterMicros into it
+void pressDuringSleep(int pin, uint32_t afterMicros);
+// Time a light sleep takes to resume, and a CPU clock change takes; 0 by default
+void setPowerTiming(uint32_t sleepExitMicros, uint32_t clockSwitchMicros);
+void setAdcMilliVolts(int pin, uint16_t milliVolts);
+void setHeap(uint32_t freeBytes, uint32_t largestBlock);
+
+// Duty on the pin, i.e. as of the channel's last latch
+uint32_t latchedDuty(int channel);
+uint32_t stageCount();
+uint32_t latchCount();
+// Counter value a latch starts at (if the guard allows) and how many ticks
+// its writes take; both 0 by default
+void setLatchTiming(uint32_t startTick, uint32_t durationTicks);
+// Called after every latch, with the fake time and the channels it moved
+void setLatchObserver(LatchObserver observer, void* arg);
+
+uint32_t cpuMhz();
+int timerCount();
+int taskCount();
+uint32_t lightSleepCount();
+uint32_t restartCount();
+
+}
+}
+
+#endif
+
+#endif
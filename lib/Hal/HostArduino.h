@@ -0,0 +1,69 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// Native-build stand-in for the parts of the Arduino core the libraries use
+// outside Hal: fixed-width types, constrain/map, Print and the Serial console.
+// Nothing here touches hardware; clocks, pins and timers live in Hal.
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using std::abs;
+
+#ifndef PI
+#define PI 3.1415926535897932384626433832795
+#endif
+
+#define IRAM_ATTR
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+inline long map(long x, long inMin, long inMax, long outMin, long outMax) {
+    return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t byte) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size) {
+        size_t written = 0;
+        while (size-- > 0) {
+            written += write(*buffer++);
+        }
+        return written;
+    }
+
+    size_t print(const char* text) { return write(reinterpret_cast<const uint8_t*>(text), strlen(text)); }
+    size_t println(const char* text) { return print(text) + print("\r\n"); }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+        char buffer[256];
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        if (length < 0) {
+            return 0;
+        }
+        return write(reinterpret_cast<const uint8_t*>(buffer),
+                     static_cast<size_t>(length) < sizeof(buffer) ? length : sizeof(buffer) - 1);
+    }
+};
+
+// Serial console on stdout. Nothing is ever received
+class HostSerial : public Print {
+public:
+    void begin(unsigned long /*baud*/) {}
+    int available() { return 0; }
+    int read() { return -1; }
+    size_t write(uint8_t byte) override { return fwrite(&byte, 1, 1, stdout); }
+    size_t write(const uint8_t* buffer, size_t size) override { return fwrite(buffer, 1, size, stdout); }
+};
+
+extern HostSerial Serial;
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef ARDUINO
+
+#include "HostPreferences.h"
+#include <map>
+#include <vector>
+
+static std::map<std::string, std::vector<uint8_t>>& store() {
+    static std::map<std::string, std::vector<uint8_t>> entries;
+    return entries;
+}
+
+static uint32_t writes = 0;
+
+bool Preferences::begin(const char* name, bool readOnlyMode) {
+    space = name;
+    readOnly = readOnlyMode;
+    open = true;
+    return true;
+}
+
+void Preferences::end() {
+    open = false;
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+    auto entry = store().find(path(key));
+    return open && entry != store().end() ? entry->second.size() : 0;
+}
+
+size_t Preferences::getBytes(const char* key, void* buffer, size_t maxLength) {
+    auto entry = store().find(path(key));
+    if (!open || entry == store().end() || entry->second.size() > maxLength) {
+        return 0;
+    }
+    memcpy(buffer, entry->second.data(), entry->second.size());
+    return entry->second.size();
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t length) {
+    if (!open || readOnly) {
+        return 0;
+    }
+    const uint8_t* bytes = static_cast<const uint8_t*>(value);
+    store()[path(key)].assign(bytes, bytes + length);
+    writes++;
+    return length;
+}
+
+bool Preferences::getBool(const char* key, bool defaultValue) {
+    uint8_t value = 0;
+    return getBytes(key, &value, 1) == 1 ? value != 0 : defaultValue;
+}
+
+size_t Preferences::putBool(const char* key, bool value) {
+    uint8_t byte = value ? 1 : 0;
+    return putBytes(key, &byte, 1);
+}
+
+void Preferences::eraseAll() {
+    store().clear();
+    writes = 0;
+}
+
+uint32_t Preferences::writeCount() {
+    return writes;
+}
+
+#endif
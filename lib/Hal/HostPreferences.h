@@ -0,0 +1,39 @@
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+#include "Platform.h"
+
+#ifndef ARDUINO
+
+#include <string>
+
+// Native-build stand-in for the ESP32 Preferences (NVS) class: the calls
+// SettingsStore and PresetBank use, backed by one in-memory store shared by
+// every instance, so a test can flush through one object and reload through
+// another. Hal::Fake::reset() empties it.
+class Preferences {
+public:
+    bool begin(const char* name, bool readOnly = false);
+    void end();
+
+    size_t getBytesLength(const char* key);
+    size_t getBytes(const char* key, void* buffer, size_t maxLength);
+    size_t putBytes(const char* key, const void* value, size_t length);
+    bool getBool(const char* key, bool defaultValue = false);
+    size_t putBool(const char* key, bool value);
+
+    static void eraseAll();
+    // Number of put calls since the last eraseAll(), i.e. simulated flash writes
+    static uint32_t writeCount();
+
+private:
+    std::string space;
+    bool open = false;
+    bool readOnly = true;
+
+    std::string path(const char* key) const { return space + "/" + key; }
+};
+
+#endif
+
+#endif
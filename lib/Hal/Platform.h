@@ -0,0 +1,13 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+// Core types and helpers every library relies on. The device build gets them
+// from the Arduino core; the native build (pio test -e native) gets the small
+// subset in HostArduino.h, with hardware access going through Hal
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include "HostArduino.h"
+#endif
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef INPUT_FILTER_H
+#define INPUT_FILTER_H
+
+#include "Platform.h"
+
+// Pot filters. Every filter has the same update(sample, nowMs) signature so the
+// filter used per channel can be swapped by changing one type, and each update
+// is O(1) regardless of window size.
+
+// Boxcar average over the last N samples, kept as a running sum
+template <int N>
+class MovingAverageFilter {
+private:
+    int values[N] = {0};
+    int32_t sum = 0;
+    int index = 0;
+
+public:
+    int update(int sample, unsigned long /*nowMs*/) {
+        sum += sample - values[index];
+        values[index] = sample;
+        index = (index + 1) % N;
+        return sum / N;
+    }
+};
+
+// Single-pole low-pass, y += (x - y) / 2^SHIFT. State is kept in Q8 so small
+// steps are not lost to truncation
+template <int SHIFT>
+class IirFilter {
+private:
+    int32_t state = 0;
+    bool primed = false;
+
+public:
+    int update(int sample, unsigned long /*nowMs*/) {
+        int32_t target = static_cast<int32_t>(sample) << 8;
+        if (!primed) {
+            state = target;
+            primed = true;
+        }
+        state += (target - state) >> SHIFT;
+        return state >> 8;
+    }
+};
+
+// One Euro filter (Casiez et al.): cutoff rises with speed, so the pot is
+// heavily smoothed at rest and nearly lag-free while being turned
+class OneEuroFilter {
+private:
+    float minCutoff;
+    float beta;
+    float derivativeCutoff;
+    float value = 0;
+    float derivative = 0;
+    unsigned long lastMs = 0;
+    bool primed = false;
+
+    static float alpha(float cutoffHz, float dtSeconds) {
+        float tau = 1.0f / (2.0f * PI * cutoffHz);
+        return 1.0f / (1.0f + tau / dtSeconds);
+    }
+
+public:
+    OneEuroFilter(float minCutoffHz = 1.0f, float speedCoefficient = 0.02f, float derivativeCutoffHz = 1.0f)
+        : minCutoff(minCutoffHz), beta(speedCoefficient), derivativeCutoff(derivativeCutoffHz) {}
+
+    int update(int sample, unsigned long nowMs) {
+        if (!primed || nowMs == lastMs) {
+            value = primed ? value : sample;
+            lastMs = nowMs;
+            primed = true;
+            return static_cast<int>(value);
+        }
+        float dt = (nowMs - lastMs) / 1000.0f;
+        lastMs = nowMs;
+
+        float rawDerivative = (sample - value) / dt;
+        derivative += alpha(derivativeCutoff, dt) * (rawDerivative - derivative);
+        float cutoff = minCutoff + beta * fabsf(derivative);
+        value += alpha(cutoff, dt) * (sample - value);
+        return static_cast<int>(value + 0.5f);
+    }
+};
+
+// Soft takeover: after a pot was used for something else, its output stays
+// at the held value until the knob is brought back across it, so the light
+// doesn't jump to wherever the knob was left
+class SoftTakeover {
+private:
+    static constexpr int CATCH_WINDOW = 20;
+    int heldValue = 0;
+    int lastPhysical = 0;
+    bool holding = false;
+
+public:
+    void hold(int value, int physical) {
+        heldValue = value;
+        lastPhysical = physical;
+        holding = true;
+    }
+
+    int update(int physical) {
+        if (holding) {
+            bool crossed = (physical - heldValue) * (lastPhysical - heldValue) <= 0 ||
+                           abs(physical - heldValue) <= CATCH_WINDOW;
+            lastPhysical = physical;
+            if (!crossed) {
+                return heldValue;
+            }
+            holding = false;
+        }
+        return physical;
+    }
+};
+
+struct HysteresisConfig {
+    int noiseThreshold = 20;              // Max pot noise level should be below this
+    int minThreshold = 5;                 // Minimum threshold for high precision
+    unsigned long idleTimeThreshold = 7000;
+};
+
+// Adaptive dead-band for one channel: after a large move the channel becomes
+// sensitive (minThreshold) until it has been idle for idleTimeThreshold, then
+// falls back to rejecting anything inside the noise band
+class ChannelHysteresis {
+private:
+    int updateThreshold = 5;
+    unsigned long lastChangeTime = 0;
+
+public:
+    bool shouldUpdate(int current, int newValue, unsigned long nowMs, const HysteresisConfig& config) {
+        int delta = abs(current - newValue);
+        if (delta > config.noiseThreshold) {
+            lastChangeTime = nowMs;
+            updateThreshold = config.minThreshold;
+        } else if (nowMs - lastChangeTime > config.idleTimeThreshold) {
+            updateThreshold = config.noiseThreshold;
+        }
+        return delta > updateThreshold;
+    }
+};
+
+#endif
@@ -1,129 +1,212 @@
 #include "LEDController.h"
-
-LEDController::LEDController(
-    int rPin, int gPin, int bPin,
-    int rChannel, int gChannel, int bChannel,
-    int freq, int res
-) : redPin(rPin), 
-    greenPin(gPin), 
-    bluePin(bPin),
-    redChannel(rChannel), 
-    greenChannel(gChannel), 
-    blueChannel(bChannel),
-    frequency(freq), 
-    resolution(res) 
+#include "Hal.h"
+#include "Log.h"
+#include "Metrics.h"
+
+LEDController::LEDController(SettingsStore& settingsStore, int freq, int res)
+    : frequency(freq),
+      resolution(res),
+      settings(settingsStore)
 {
 }
 
 void LEDController::begin() {
-    // Configure LED PWM channels
-    ledcSetup(redChannel, frequency, resolution);
-    ledcSetup(greenChannel, frequency, resolution);
-    ledcSetup(blueChannel, frequency, resolution);
-    
-    // Attach PWM channels to GPIO pins, but swap red and blue
-    ledcAttachPin(redPin, blueChannel);    // Red pin gets blue channel
-    ledcAttachPin(greenPin, greenChannel); // Green stays same
-    ledcAttachPin(bluePin, redChannel);    // Blue pin gets red channel
-    
-    // Initialize all LEDs to off
-    ledcWrite(redChannel, 0);
-    ledcWrite(greenChannel, 0);
-    ledcWrite(blueChannel, 0);
+    // Pins come from LampOutput; every channel starts dark
+    if (!output.begin(frequency, resolution)) {
+        LOG_ERROR("PWM setup failed\n");
+    }
+
+    if (!Hal::startPeriodicTimer(&LEDController::ditherTick, this, DITHER_PERIOD_US, "led_dither")) {
+        LOG_ERROR("Dither timer creation failed\n");
+    }
+
+    for (int i = 0; i < NUM_CHANNELS; i++) {
+        hysteresisConfig[i] = settings.get().hysteresis[i];
+    }
 
     loadPowerLimit();
+    lastGovernorMs = Hal::nowMillis();
 }
 
-void LEDController::updatePowerLimitFromPreferences() {
-    preferences.begin("led", false);
-    bool unlocked = preferences.getBool("unlocked", false);
-    currentPowerLimit = unlocked ? UNLOCKED_POWER_LIMIT : LOCKED_POWER_LIMIT;
-    preferences.end();
-    Serial.printf("Power limit updated to: %f\n", currentPowerLimit);
+// Reads the RAM copy; SettingsStore only touches flash at boot and on flush
+void LEDController::updatePowerLimitFromSettings() {
+    bool unlocked = settings.get().unlocked;
+    governor.setProfile(unlocked ? PowerGovernor::UNLOCKED : PowerGovernor::LOCKED);
+    commitOutputs();
 }
 
 void LEDController::loadPowerLimit() {
-    updatePowerLimitFromPreferences();
+    updatePowerLimitFromSettings();
+    LOG_INFO("Power limit updated to: %s\n", isUnlocked() ? "unlocked" : "locked");
 }
 
 void LEDController::checkAndUpdatePowerLimit() {
-    updatePowerLimitFromPreferences();
+    updatePowerLimitFromSettings();
 }
 
 void LEDController::unlock() {
-    preferences.begin("led", false);
-    preferences.putBool("unlocked", true);
-    preferences.end();
-    currentPowerLimit = UNLOCKED_POWER_LIMIT;
+    settings.setUnlocked(true);
+    governor.setProfile(PowerGovernor::UNLOCKED);
+    commitOutputs();
 }
 
 void LEDController::resetToSafeMode() {
-    preferences.begin("led", false);
-    preferences.putBool("unlocked", false);
-    preferences.end();
-    currentPowerLimit = LOCKED_POWER_LIMIT;
-}
-
-void LEDController::applyPowerLimit(int& red, int& green, int& blue) {
-    float totalPower = (red + green + blue) / (3.0f * 2047.0f);
-    if (totalPower > currentPowerLimit) {
-        float scale = currentPowerLimit / totalPower;
-        red = static_cast<int>(red * scale);
-        green = static_cast<int>(green * scale);
-        blue = static_cast<int>(blue * scale);
+    settings.setUnlocked(false);
+    governor.setProfile(PowerGovernor::LOCKED);
+    commitOutputs();
+}
+
+// Requested total after the master dimmer, as a Q16 fraction of every
+// channel at full duty
+uint32_t LEDController::requestedPower() const {
+    uint64_t total = static_cast<uint64_t>(requestedDuty[0]) + requestedDuty[1] + requestedDuty[2];
+    total = (total * masterLevel) >> PowerGovernor::FIXED_SHIFT;
+    return static_cast<uint32_t>((total << PowerGovernor::FIXED_SHIFT) / (NUM_CHANNELS * LUT_FULL_SCALE));
+}
+
+void LEDController::setMasterLevel(uint32_t level) {
+    level = level < PowerGovernor::FULL_POWER_Q16 ? level : PowerGovernor::FULL_POWER_Q16;
+    if (level != masterLevel) {
+        masterLevel = level;
+        commitOutputs();
     }
 }
 
-void LEDController::writePWM(int channel, int value) {
-    value = static_cast<int>(value * currentPowerLimit);
-    ledcWrite(channel, value);
+// Scales all channels by the governor's current allowance and hands the
+// result to the dither stage. Duties keep DITHER_BITS of fraction throughout
+void LEDController::commitOutputs() {
+    outputScale = governor.scaleFor(requestedPower());
+    uint64_t scale = (static_cast<uint64_t>(masterLevel) * outputScale) >> PowerGovernor::FIXED_SHIFT;
+    uint16_t targets[NUM_CHANNELS];
+    for (int i = 0; i < NUM_CHANNELS; i++) {
+        targets[i] = static_cast<uint16_t>((requestedDuty[i] * scale) >> PowerGovernor::FIXED_SHIFT);
+    }
+    dither.setTargets(targets);
+}
+
+// Runs on the esp_timer task. Only this callback writes LEDC duties once the
+// timer is running. Every channel works from one snapshot of the targets,
+// and channels whose duty changed are staged and then latched together, so
+// they switch in the same PWM period
+void LEDController::ditherTick(void* arg) {
+    LEDController* self = static_cast<LEDController*>(arg);
+    uint32_t start = Hal::nowMicros();
+    self->dither.latch();
+    for (int i = 0; i < NUM_CHANNELS; i++) {
+        uint32_t duty = self->dither.next(i);
+        if (duty != self->writtenDuty[i]) {
+            self->writtenDuty[i] = duty;
+            self->output.stage(i, duty);
+            Metrics::ledcWrites.increment();
+        }
+    }
+    if (self->output.commit()) {
+        Metrics::pwmLatches.increment();
+    }
+    Metrics::ditherTick.record(Hal::nowMicros() - start);
 }
 
 void LEDController::setPWMDirectly(int red, int green, int blue) {
+    Metrics::setPwmCalls.increment();
+    // A direct write always wins over a running fade
+    transition.cancel();
+    applyLevels(red, green, blue, true);
+}
+
+void LEDController::setLevels(int red, int green, int blue) {
+    transition.cancel();
+    applyLevels(red, green, blue, false);
+}
+
+void LEDController::setLinearDuties(const uint32_t duties[3]) {
+    transition.cancel();
+    for (int i = 0; i < NUM_CHANNELS; i++) {
+        requestedDuty[i] = duties[i] < LUT_FULL_SCALE ? duties[i] : LUT_FULL_SCALE;
+    }
+    currentRed = requestedDuty[0] >> DITHER_BITS;
+    currentGreen = requestedDuty[1] >> DITHER_BITS;
+    currentBlue = requestedDuty[2] >> DITHER_BITS;
+    // Fades and sequences start from lastInput, so it has to name these
+    // duties too or their first frame jumps back to the last pot or HTTP level
+    lastInput[0] = levelForDuty(RED_LUT, requestedDuty[0]);
+    lastInput[1] = levelForDuty(GREEN_LUT, requestedDuty[1]);
+    lastInput[2] = levelForDuty(BLUE_LUT, requestedDuty[2]);
+    commitOutputs();
+}
+
+void LEDController::fadeTo(int red, int green, int blue, uint32_t durationMs, Easing easing) {
+    const int to[NUM_CHANNELS] = {
+        constrain(red, 0, 2047), constrain(green, 0, 2047), constrain(blue, 0, 2047)
+    };
+    transition.fadeTo(lastInput, to, durationMs, easing, Hal::nowMillis());
+}
+
+bool LEDController::playSequence(const Keyframe* frames, int count, bool loop) {
+    return transition.playSequence(lastInput, frames, count, loop, Hal::nowMillis());
+}
+
+void LEDController::update() {
+    // Heat the model with what is actually being output, then re-apply the
+    // budget so derating follows the temperature even while levels are still
+    unsigned long now = Hal::nowMillis();
+    uint32_t outputPower = (static_cast<uint64_t>(requestedPower()) * outputScale) >> PowerGovernor::FIXED_SHIFT;
+    governor.integrate(outputPower, now - lastGovernorMs);
+    lastGovernorMs = now;
+    uint32_t scale = governor.scaleFor(requestedPower());
+    if (scale != outputScale) {
+        commitOutputs();
+    }
+    if (governor.isDerating()) {
+        Metrics::powerDerateTicks.increment();
+    }
+    Metrics::heatsinkMilliC.set(governor.temperatureMilliC());
+
+    int levels[NUM_CHANNELS];
+    if (transition.sample(Hal::nowMillis(), levels)) {
+        // Fade steps are deliberately small, so they bypass the dead-band
+        applyLevels(levels[0], levels[1], levels[2], false);
+    }
+}
+
+void LEDController::applyLevels(int red, int green, int blue, bool useDeadband) {
     // Constrain values first
     red = constrain(red, 0, 2047);
     green = constrain(green, 0, 2047);
     blue = constrain(blue, 0, 2047);
 
-    // Apply RGB trim values
-    red = static_cast<int>(red * RED_TRIM);
-    green = static_cast<int>(green * GREEN_TRIM);
-    blue = static_cast<int>(blue * BLUE_TRIM);
+    // The dead-band works on input levels, where pot noise has constant size
+    unsigned long now = Hal::nowMillis();
+    bool updateRed = !useDeadband || hysteresis[0].shouldUpdate(lastInput[0], red, now, hysteresisConfig[0]);
+    bool updateGreen = !useDeadband || hysteresis[1].shouldUpdate(lastInput[1], green, now, hysteresisConfig[1]);
+    bool updateBlue = !useDeadband || hysteresis[2].shouldUpdate(lastInput[2], blue, now, hysteresisConfig[2]);
 
-    bool updateRed = shouldUpdate(currentRed, red);
-    bool updateGreen = shouldUpdate(currentGreen, green);
-    bool updateBlue = shouldUpdate(currentBlue, blue);
+    // One table lookup applies brightness curve and trim, keeping DITHER_BITS
+    // of fraction for the output stage
+    uint32_t redFine = RED_LUT.values[red];
+    uint32_t greenFine = GREEN_LUT.values[green];
+    uint32_t blueFine = BLUE_LUT.values[blue];
 
-    #ifdef DEBUG_LED
-    if (Serial) {
-        Serial.printf("DEBUG: Writing to channels - Red(ch%d): %d, Green(ch%d): %d, Blue(ch%d): %d\n",
-        redChannel, red, greenChannel, green, blueChannel, blue);
-    }
-    #endif
+    LOG_DEBUG("Writing levels - Red: %d, Green: %d, Blue: %d\n", red, green, blue);
 
     if (updateRed || updateGreen || updateBlue) {
+        if (useDeadband) {
+            Metrics::deadbandPasses.increment();
+        }
         if (updateRed) {
-            currentRed = red;
-            writePWM(redChannel, red);
+            lastInput[0] = red;
+            currentRed = redFine >> DITHER_BITS;
+            requestedDuty[0] = redFine;
         }
         if (updateGreen) {
-            currentGreen = green;
-            writePWM(greenChannel, green);
+            lastInput[1] = green;
+            currentGreen = greenFine >> DITHER_BITS;
+            requestedDuty[1] = greenFine;
         }
         if (updateBlue) {
-            currentBlue = blue;
-            writePWM(blueChannel, blue);
+            lastInput[2] = blue;
+            currentBlue = blueFine >> DITHER_BITS;
+            requestedDuty[2] = blueFine;
         }
+        commitOutputs();
     }
 }
-
-bool LEDController::shouldUpdate(int current, int new_value) {
-    if(abs(current - new_value) > noiseThreshold){ //if the noise threshold is exceeded
-        lastChangeTime = millis(); //start a timer
-        updateThreshold = minThreshold; //make the pots sensative
-    } else if (millis() - lastChangeTime > idleTimeThreshold) { //if the timer is up
-            updateThreshold = noiseThreshold;
-        }
-    
-  return abs(current - new_value) > updateThreshold;
-}
\ No newline at end of file
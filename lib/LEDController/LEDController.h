@@ -1,67 +1,118 @@
 #ifndef LED_CONTROLLER_H
 #define LED_CONTROLLER_H
 
-#include <Arduino.h>
-#include <Preferences.h>
+#include "Platform.h"
+#include "InputFilter.h"
+#include "Settings.h"
+#include "SigmaDeltaDither.h"
+#include "PerceptualLut.h"
+#include "Transition.h"
+#include "PowerGovernor.h"
+#include "PwmOutput.h"
 
-static constexpr float RED_TRIM = 0.95f;   // Adjust these between 0.0-1.0
-static constexpr float GREEN_TRIM = 1.0f;  // to trim individual colors
-static constexpr float BLUE_TRIM = 0.40f; 
+// Brightness curve applied to every channel; use linearCurve for the raw mapping
+static constexpr float (*BRIGHTNESS_CURVE)(float) = cieLightnessCurve;
+
+// Per-channel tables with the curve and trim folded together, generated at
+// compile time and placed in flash. setPWMDirectly does one lookup per channel
+static constexpr ChannelLut RED_LUT = makeChannelLut(RED_TRIM, BRIGHTNESS_CURVE);
+static constexpr ChannelLut GREEN_LUT = makeChannelLut(GREEN_TRIM, BRIGHTNESS_CURVE);
+static constexpr ChannelLut BLUE_LUT = makeChannelLut(BLUE_TRIM, BRIGHTNESS_CURVE);
+static_assert(RED_LUT.values[0] == 0 && BLUE_LUT.values[0] == 0, "LUT must start dark");
+static_assert(GREEN_LUT.values[LUT_SIZE - 1] == LUT_FULL_SCALE, "Untrimmed LUT must reach full scale");
+
+// Output pins in logical order (red, green, blue): red drives GPIO7 and blue
+// GPIO5, the routing this lamp has always used
+using LampOutput = PwmOutput<7, 6, 5>;
 
 class LEDController {
 private:
-    const int redPin;
-    const int greenPin;
-    const int bluePin;
     const int frequency;
     const int resolution;
-    const int redChannel;
-    const int greenChannel;
-    const int blueChannel;
     int currentRed = 0;
     int currentGreen = 0;
     int currentBlue = 0;
     //int updateThreshold = 30;
     //bool shouldUpdate(int current, int new_value);
 
-    static constexpr float LOCKED_POWER_LIMIT = 0.3f;   // 30% power
-    static constexpr float UNLOCKED_POWER_LIMIT = 0.6f; // 60% power
-    float currentPowerLimit;
-    Preferences preferences;
+    SettingsStore& settings;
     
-    void applyPowerLimit(int& red, int& green, int& blue);
     void loadPowerLimit();
-    void writePWM(int channel, int value);
-    void updatePowerLimitFromPreferences();
+    void updatePowerLimitFromSettings();
+
+    // Per-channel dead-band so moving one pot doesn't change how sensitive the others are
+    static constexpr int NUM_CHANNELS = 3;
+    static_assert(LampOutput::CHANNELS == NUM_CHANNELS, "Every color channel needs an output pin");
+    HysteresisConfig hysteresisConfig[NUM_CHANNELS];
+    ChannelHysteresis hysteresis[NUM_CHANNELS];
+    int lastInput[NUM_CHANNELS] = {0}; // Dead-band runs on input levels, before the curve
 
+    // Total power and thermal budget. Channels are limited together, so a
+    // saturated single color isn't capped as hard as white
+    PowerGovernor governor;
+    uint32_t requestedDuty[NUM_CHANNELS] = {0}; // Before the governor, with DITHER_BITS of fraction
+    uint32_t outputScale = PowerGovernor::FULL_POWER_Q16;
+    uint32_t masterLevel = PowerGovernor::FULL_POWER_Q16; // Q16 dimmer over every source
+    unsigned long lastGovernorMs = 0;
+    uint32_t requestedPower() const;
+    void commitOutputs();
 
-    float updateThreshold = 5; // Initial threshold - no need to change this
-    float noiseThreshold = 20; // Max pot noise level should be below this
-    float minThreshold = 5;  // Minimum threshold for high precision
-    unsigned long lastChangeTime = 0;
-    const unsigned long idleTimeThreshold = 7000;
+    // Duties are carried with DITHER_BITS of fraction below the 11-bit LEDC
+    // resolution and dithered onto the hardware by a periodic timer
+    static constexpr int DITHER_BITS = 5;
+    static_assert(LUT_FULL_SCALE == (2047UL << DITHER_BITS), "LUT scale must match dither precision");
+    static constexpr uint32_t DITHER_PERIOD_US = 500; // 2 kHz, ~10 PWM periods per update
+    SigmaDeltaDither<NUM_CHANNELS, DITHER_BITS> dither;
+    uint32_t writtenDuty[NUM_CHANNELS] = {0};
+    LampOutput output;
+    static void ditherTick(void* arg);
 
+    // Software interpolator for timed fades and keyframe sequences. LEDC hardware
+    // fades are not used: the dither timer owns the duty registers and a hardware
+    // fade would fight it
+    TransitionEngine transition;
+    void applyLevels(int red, int green, int blue, bool useDeadband);
 
 public:
-    LEDController(
-        int redPin, int greenPin, int bluePin,
-        int redChannel = 0, int greenChannel = 1, int blueChannel = 2,
-        int frequency = 19000, int resolution = 11
-    );
+    LEDController(SettingsStore& settings, int frequency = 19000, int resolution = 11);
     void begin();
+    // Pot levels (0-2047): each channel only moves past its dead-band
     void setPWMDirectly(int red, int green, int blue);
+    // Exact levels from the network, same scale. There's no pot noise to
+    // reject, so the dead-band is skipped and every change lands
+    void setLevels(int red, int green, int blue);
+
+    // Duties straight from the color engine (5 bits of fraction, 0 to
+    // LUT_FULL_SCALE). They are already linear and calibrated, so the
+    // brightness curve, trims and dead-band are skipped
+    void setLinearDuties(const uint32_t duties[3]);
+
+    // Fades from the current levels; inputs use the same 0-2047 scale as setPWMDirectly
+    void fadeTo(int red, int green, int blue, uint32_t durationMs, Easing easing = Easing::EaseInOut);
+    bool playSequence(const Keyframe* frames, int count, bool loop);
+    bool isFading() const { return transition.isActive(); }
+    // Advances any running fade and the thermal model; call at the control rate
+    void update();
     void getPWMValues(int& red, int& green, int& blue) {
         red = currentRed;
         green = currentGreen;
         blue = currentBlue;
     }
-    bool isUnlocked() const { return currentPowerLimit > LOCKED_POWER_LIMIT; }
+    // Q16 master dimmer applied after every mode's own levels
+    void setMasterLevel(uint32_t level);
+    uint32_t getMasterLevel() const { return masterLevel; }
+    bool isUnlocked() const { return governor.isProfile(PowerGovernor::UNLOCKED); }
+    const PowerGovernor& getGovernor() const { return governor; }
     void unlock();
     void resetToSafeMode();
     void checkAndUpdatePowerLimit();
 
-    bool shouldUpdate(int current, int new_value);
-    void adjustThreshold(int current, int new_value);
+    // Channel index is 0 = red, 1 = green, 2 = blue
+    void setHysteresis(int channel, const HysteresisConfig& config) {
+        hysteresisConfig[channel] = config;
+        settings.setHysteresis(channel, config);
+    }
+    const HysteresisConfig& getHysteresis(int channel) const { return hysteresisConfig[channel]; }
 };
 
 #endif
\ No newline at end of file
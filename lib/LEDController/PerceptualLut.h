@@ -0,0 +1,66 @@
+#ifndef PERCEPTUAL_LUT_H
+#define PERCEPTUAL_LUT_H
+
+#include "Platform.h"
+
+// Input levels are 11-bit (pots and mapped WiFi values); outputs are duties
+// with 5 bits of fraction below the 11-bit LEDC resolution, ready for dithering
+static constexpr int LUT_SIZE = 2048;
+static constexpr uint32_t LUT_FULL_SCALE = 2047UL << 5;
+
+// Per-channel output trims. The pot tables below fold them in, and so does
+// ColorEngine::DEFAULT_MATRIX, so every path to the LEDs is trimmed alike
+static constexpr float RED_TRIM = 0.95f;   // Adjust these between 0.0-1.0
+static constexpr float GREEN_TRIM = 1.0f;  // to trim individual colors
+static constexpr float BLUE_TRIM = 0.40f;
+
+// CIE 1976 L*: treat the input as lightness and return relative luminance,
+// so equal knob travel gives roughly equal perceived brightness steps
+constexpr float cieLightnessCurve(float x) {
+    float lightness = x * 100.0f;
+    if (lightness <= 8.0f) {
+        return lightness / 903.3f;
+    }
+    float t = (lightness + 16.0f) / 116.0f;
+    return t * t * t;
+}
+
+constexpr float linearCurve(float x) {
+    return x;
+}
+
+struct ChannelLut {
+    uint16_t values[LUT_SIZE];
+};
+
+// Nearest input level for a duty, by binary search over a rising table.
+// Duties past the table's last entry give the top level
+inline int levelForDuty(const ChannelLut& lut, uint32_t duty) {
+    int low = 0;
+    int high = LUT_SIZE - 1;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (lut.values[mid] < duty) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    int32_t above = static_cast<int32_t>(lut.values[low]) - static_cast<int32_t>(duty);
+    if (low > 0 && static_cast<int32_t>(duty) - lut.values[low - 1] < above) {
+        low--;
+    }
+    return low;
+}
+
+// Builds one channel's table with the trim folded in, at compile time
+constexpr ChannelLut makeChannelLut(float trim, float (*curve)(float)) {
+    ChannelLut lut{};
+    for (int i = 0; i < LUT_SIZE; i++) {
+        float level = curve(static_cast<float>(i) / (LUT_SIZE - 1));
+        lut.values[i] = static_cast<uint16_t>(level * trim * LUT_FULL_SCALE + 0.5f);
+    }
+    return lut;
+}
+
+#endif
@@ -1,25 +1,31 @@
 #include "LTTController.h"
+#include "Hal.h"
 
-void LTTController::lttToRgb(int luminance, int temperature, int tintVal, int& r, int& g, int& b) {
-    float l = luminance / 2047.0f;
-    float t = temperature / 2047.0f;
-    float tv = tintVal / 2047.0f;
-    
-    float baseR = 1.0f - t * 0.8f;
-    float baseB = 0.2f + t * 0.8f;
-    float baseG = 0.8f * (0.5f + tv * 0.5f);
-    
-    r = static_cast<int>(baseR * l * 2047);
-    g = static_cast<int>(baseG * l * 2047);
-    b = static_cast<int>(baseB * l * 2047);
-    
-    r = constrain(r, 0, 2047);
-    g = constrain(g, 0, 2047);
-    b = constrain(b, 0, 2047);
+int LTTController::temperatureToKelvin(int temperature) {
+    int t = constrain(temperature, 0, 2047);
+    int mired = WARMEST_MIRED - ((WARMEST_MIRED - COOLEST_MIRED) * t) / 2047;
+    return 1000000 / mired;
+}
+
+// Centre is on the locus; the low end is pinker, the high end greener
+int LTTController::tintToDuv(int tint) {
+    int tv = constrain(tint, 0, 2047);
+    return ((tv - 1024) * ColorEngine::MAX_DUV) / 1023;
 }
 
 void LTTController::updateLTT(int luminance, int temperature, int tint) {
-    int r, g, b;
-    lttToRgb(luminance, temperature, tint, r, g, b);
-    ledController.setPWMDirectly(r, g, b);
-}
\ No newline at end of file
+    const int inputs[3] = {luminance, temperature, tint};
+    unsigned long now = Hal::nowMillis();
+    bool changed = false;
+    for (int i = 0; i < 3; i++) {
+        if (lastInput[i] < 0 || hysteresis[i].shouldUpdate(lastInput[i], inputs[i], now, hysteresisConfig)) {
+            lastInput[i] = inputs[i];
+            changed = true;
+        }
+    }
+    if (changed) {
+        colorEngine.cctToDuties(lastInput[0], temperatureToKelvin(lastInput[1]), tintToDuv(lastInput[2]), duties);
+    }
+    // Written every tick like the RGB path, so switching into LTT takes effect at once
+    ledController.setLinearDuties(duties);
+}
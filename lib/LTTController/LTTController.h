@@ -2,15 +2,31 @@
 #define LTT_CONTROLLER_H
 
 #include "LEDController.h"
+#include "ColorEngine.h"
 
+// Luminance, temperature and tint pots mapped onto real colorimetry:
+// temperature sweeps the Planckian locus evenly in mired and tint is Duv
 class LTTController {
 private:
     LEDController& ledController;
-    void lttToRgb(int luminance, int temperature, int tintVal, int& r, int& g, int& b);
+    const ColorEngine& colorEngine;
+
+    static constexpr int WARMEST_MIRED = 556; // 1800 K at temperature 0
+    static constexpr int COOLEST_MIRED = 125; // 8000 K at temperature 2047
+
+    // Dead-band on the pot inputs, so pot noise doesn't rerun the engine
+    HysteresisConfig hysteresisConfig;
+    ChannelHysteresis hysteresis[3];
+    int lastInput[3] = {-1, -1, -1};
+    uint32_t duties[3] = {0};
 
 public:
-    LTTController(LEDController& controller) : ledController(controller) {}
+    LTTController(LEDController& controller, const ColorEngine& engine)
+        : ledController(controller), colorEngine(engine) {}
     void updateLTT(int luminance, int temperature, int tint);
+
+    static int temperatureToKelvin(int temperature);
+    static int tintToDuv(int tint);
 };
 
-#endif
\ No newline at end of file
+#endif
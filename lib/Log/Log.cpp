@@ -0,0 +1,84 @@
+#include "Log.h"
+
+Log::Slot Log::slots[CAPACITY];
+std::atomic<uint32_t> Log::enqueuePos{0};
+uint32_t Log::dequeuePos = 0;
+std::atomic<uint32_t> Log::dropped{0};
+uint32_t Log::reportedDrops = 0;
+
+static const char *const LEVEL_NAMES[] = {"", "E", "W", "I", "D"};
+
+void Log::begin() {
+    static bool started = false;
+    if (started) {
+        return;
+    }
+    started = true;
+    Hal::startTask(drainTask, "log_drain", 3072, nullptr, 0);
+}
+
+// Slots store their sequence relative to their index, so the zero-initialized
+// array is already valid and records can be queued before begin()
+void Log::push(const Record &record) {
+    uint32_t pos = enqueuePos.load(std::memory_order_relaxed);
+    for (;;) {
+        uint32_t index = pos & (CAPACITY - 1);
+        Slot &slot = slots[index];
+        uint32_t sequence = slot.sequence.load(std::memory_order_acquire) + index;
+        int32_t diff = static_cast<int32_t>(sequence - pos);
+        if (diff == 0) {
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                slot.record = record;
+                slot.sequence.store(pos + 1 - index, std::memory_order_release);
+                return;
+            }
+        } else if (diff < 0) {
+            // Full: drop rather than block the caller
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+// Only the drain task consumes, so the dequeue side needs no CAS
+bool Log::pop(Record &record) {
+    uint32_t index = dequeuePos & (CAPACITY - 1);
+    Slot &slot = slots[index];
+    uint32_t sequence = slot.sequence.load(std::memory_order_acquire) + index;
+    if (static_cast<int32_t>(sequence - (dequeuePos + 1)) < 0) {
+        return false;
+    }
+    record = slot.record;
+    slot.sequence.store(dequeuePos + CAPACITY - index, std::memory_order_release);
+    dequeuePos++;
+    return true;
+}
+
+int Log::drain(Print &out) {
+    char line[160];
+    Record record;
+    int written = 0;
+    while (pop(record)) {
+        int prefix = snprintf(line, sizeof(line), "[%lu %s] ", (unsigned long)record.timestampMs,
+                              LEVEL_NAMES[record.level]);
+        snprintf(line + prefix, sizeof(line) - prefix, record.format,
+                 record.args[0], record.args[1], record.args[2], record.args[3]);
+        out.print(line);
+        written++;
+    }
+    uint32_t drops = droppedCount();
+    if (drops != reportedDrops) {
+        out.printf("[log] %lu records dropped\n", (unsigned long)(drops - reportedDrops));
+        reportedDrops = drops;
+    }
+    return written;
+}
+
+void Log::drainTask(void * /*arg*/) {
+    for (;;) {
+        drain(Serial);
+        Hal::sleepMillis(20);
+    }
+}
@@ -0,0 +1,114 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include "Platform.h"
+#include "Hal.h"
+#include <atomic>
+#include <type_traits>
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+// Override with -DLOG_LEVEL=... in build_flags. Calls above this level
+// compile to nothing, arguments included
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// Deferred logger. A call stores the format pointer, a timestamp and up to
+// MAX_ARGS word-sized arguments into a lock-free ring; a low-priority task does
+// the formatting and the Serial write. Callers never block on the console.
+//
+// Because formatting happens later, the format and any %s arguments must be
+// string literals or other storage that outlives the call. Arguments must be
+// integers, enums or const char*; floats are rejected at compile time.
+class Log {
+public:
+    static constexpr int MAX_ARGS = 4;
+    static constexpr int CAPACITY = 64; // Must be a power of two
+
+    struct Record {
+        uint32_t timestampMs;
+        const char *format;
+        uintptr_t args[MAX_ARGS];
+        uint8_t level;
+    };
+
+    // Starts the drain task. Records logged before this are kept until it runs
+    static void begin();
+
+    template <typename... Args>
+    static void write(uint8_t level, const char *format, Args... args) {
+        static_assert(sizeof...(Args) <= MAX_ARGS, "Too many log arguments");
+        Record record;
+        record.timestampMs = Hal::nowMillis();
+        record.format = format;
+        record.level = level;
+        uintptr_t packed[MAX_ARGS + 1] = {pack(args)...};
+        for (int i = 0; i < MAX_ARGS; i++) {
+            record.args[i] = packed[i];
+        }
+        push(record);
+    }
+
+    static uint32_t droppedCount() { return dropped.load(std::memory_order_relaxed); }
+
+    // Formats every queued record to out, then reports any drops since the
+    // last call. Only one task may drain: the drain task once begin() has run,
+    // or a host test that never calls begin(). Returns the records written
+    static int drain(Print &out);
+
+private:
+    // Bounded MPMC queue (Vyukov): each slot carries a sequence number, so
+    // producers on different tasks claim slots with one CAS and never lock
+    struct Slot {
+        std::atomic<uint32_t> sequence;
+        Record record;
+    };
+
+    static Slot slots[CAPACITY];
+    static std::atomic<uint32_t> enqueuePos;
+    static uint32_t dequeuePos;
+    static std::atomic<uint32_t> dropped;
+    static uint32_t reportedDrops;  // Drain side only
+
+    template <typename T>
+    static uintptr_t pack(T value) {
+        static_assert(std::is_integral<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value,
+                      "Log arguments must be integers or pointers");
+        return (uintptr_t)value;
+    }
+
+    static void push(const Record &record);
+    static bool pop(Record &record);
+    static void drainTask(void *arg);
+};
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) Log::write(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...) Log::write(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOG_WARN(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) Log::write(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) Log::write(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) do {} while (0)
+#endif
+
+#endif
@@ -0,0 +1,261 @@
+#include "Metrics.h"
+#include "Scheduler.h"
+
+namespace Metrics {
+
+Counter setPwmCalls;
+Counter deadbandPasses;
+Counter ledcWrites;
+Counter pwmLatches;
+Counter pwmLatchWraps;
+Gauge pwmLatchTicksMax;
+Counter powerDerateTicks;
+Gauge heatsinkMilliC;
+LatencyStat adcSweep;
+LatencyStat ditherTick;
+Counter dmxFrames;
+Counter dmxStale;
+Gauge wifiClients;
+Gauge wifiStartMillis;
+Gauge wifiStopMillis;
+LatencyStat routes[static_cast<int>(Route::Count)];
+Counter powerStateMillis[POWER_STATES];
+Counter sleptMillis;
+Counter buttonWakes;
+Counter timerWakes;
+LatencyStat wakeLatency;
+LatencyStat clockRestore;
+LatencyStat buttonWakeLatency;
+HeapStat routeHeap[static_cast<int>(Route::Count)];
+
+static uint32_t minFreeHeap = UINT32_MAX;
+static uint32_t minLargestBlock = UINT32_MAX;
+static uint32_t largestBlockHistory[HEAP_HISTORY] = {0};
+static int heapHistoryCount = 0;
+static int heapHistoryHead = 0;
+static uint32_t lastHistoryMs = 0;
+
+static const Scheduler *attachedScheduler = nullptr;
+
+static const char *const ROUTE_NAMES[] = {
+    "asset", "lockStatus", "unlock", "reset", "postRGB", "websocket", "metrics", "dmxConfig", "sync", "cue", "postCCT", "calibration", "trace", "presets", "recall", "sequence", "hysteresis", "role",
+};
+static const char *const POWER_STATE_NAMES[] = {"active", "downclocked", "lightSleep"};
+static_assert(sizeof(POWER_STATE_NAMES) / sizeof(POWER_STATE_NAMES[0]) == POWER_STATES,
+              "Every power state needs a name");
+
+static_assert(sizeof(ROUTE_NAMES) / sizeof(ROUTE_NAMES[0]) == static_cast<int>(Route::Count),
+              "Every route needs a name");
+
+void attachScheduler(const Scheduler *scheduler) {
+    attachedScheduler = scheduler;
+}
+
+// Only the housekeeping task writes these; readers may see a sample late
+void sampleHeap(uint32_t nowMs) {
+    uint32_t freeHeap = Hal::freeHeap();
+    uint32_t largestBlock = Hal::largestFreeBlock();
+    if (freeHeap < minFreeHeap) {
+        minFreeHeap = freeHeap;
+    }
+    if (largestBlock < minLargestBlock) {
+        minLargestBlock = largestBlock;
+    }
+    if (heapHistoryCount == 0 || nowMs - lastHistoryMs >= 60000) {
+        lastHistoryMs = nowMs;
+        largestBlockHistory[heapHistoryHead] = largestBlock;
+        heapHistoryHead = (heapHistoryHead + 1) % HEAP_HISTORY;
+        if (heapHistoryCount < HEAP_HISTORY) {
+            heapHistoryCount++;
+        }
+    }
+}
+
+static void writeHistogram(Print &out, const char *metric, const char *task, const uint32_t *buckets) {
+    uint32_t cumulative = 0;
+    uint32_t limit = TaskStats::FIRST_BUCKET_US;
+    for (int b = 0; b < TaskStats::BUCKETS; b++) {
+        cumulative += buckets[b];
+        if (b == TaskStats::BUCKETS - 1) {
+            out.printf("%s_bucket{task=\"%s\",le=\"+Inf\"} %lu\n", metric, task, (unsigned long)cumulative);
+        } else {
+            out.printf("%s_bucket{task=\"%s\",le=\"%lu\"} %lu\n", metric, task, (unsigned long)limit,
+                       (unsigned long)cumulative);
+        }
+        limit <<= 1;
+    }
+    out.printf("%s_count{task=\"%s\"} %lu\n", metric, task, (unsigned long)cumulative);
+}
+
+static void writeSummary(Print &out, const char *metric, const LatencyStat &stat) {
+    out.printf("# TYPE %s summary\n%s_count %lu\n%s_sum %lu\n%s_max %lu\n", metric, metric,
+               (unsigned long)stat.count.load(), metric, (unsigned long)stat.totalMicros.load(), metric,
+               (unsigned long)stat.maxMicros.load());
+}
+
+void writePrometheus(Print &out) {
+    out.printf("# TYPE lamp_set_pwm_calls_total counter\nlamp_set_pwm_calls_total %lu\n",
+               (unsigned long)setPwmCalls.get());
+    out.printf("# TYPE lamp_deadband_passes_total counter\nlamp_deadband_passes_total %lu\n",
+               (unsigned long)deadbandPasses.get());
+    out.printf("# TYPE lamp_ledc_writes_total counter\nlamp_ledc_writes_total %lu\n",
+               (unsigned long)ledcWrites.get());
+    out.printf("# TYPE lamp_pwm_latches_total counter\nlamp_pwm_latches_total %lu\n",
+               (unsigned long)pwmLatches.get());
+    out.printf("# TYPE lamp_pwm_latch_wraps_total counter\nlamp_pwm_latch_wraps_total %lu\n",
+               (unsigned long)pwmLatchWraps.get());
+    out.printf("# TYPE lamp_pwm_latch_ticks_max gauge\nlamp_pwm_latch_ticks_max %ld\n",
+               (long)pwmLatchTicksMax.get());
+    out.printf("# TYPE lamp_power_derate_ticks_total counter\nlamp_power_derate_ticks_total %lu\n",
+               (unsigned long)powerDerateTicks.get());
+    out.printf("# TYPE lamp_heatsink_estimate_celsius gauge\nlamp_heatsink_estimate_celsius %ld.%03ld\n",
+               (long)(heatsinkMilliC.get() / 1000), (long)(heatsinkMilliC.get() % 1000));
+    out.printf("# TYPE lamp_adc_sweep_micros summary\n");
+    out.printf("lamp_adc_sweep_micros_count %lu\nlamp_adc_sweep_micros_sum %lu\nlamp_adc_sweep_micros_max %lu\n",
+               (unsigned long)adcSweep.count.load(), (unsigned long)adcSweep.totalMicros.load(),
+               (unsigned long)adcSweep.maxMicros.load());
+    out.printf("# TYPE lamp_dither_tick_micros summary\n");
+    out.printf("lamp_dither_tick_micros_count %lu\nlamp_dither_tick_micros_sum %lu\nlamp_dither_tick_micros_max %lu\n",
+               (unsigned long)ditherTick.count.load(), (unsigned long)ditherTick.totalMicros.load(),
+               (unsigned long)ditherTick.maxMicros.load());
+    out.printf("# TYPE lamp_dmx_frames_total counter\nlamp_dmx_frames_total %lu\n", (unsigned long)dmxFrames.get());
+    out.printf("# TYPE lamp_dmx_stale_total counter\nlamp_dmx_stale_total %lu\n", (unsigned long)dmxStale.get());
+
+    out.printf("# TYPE lamp_power_state_millis_total counter\n");
+    for (int i = 0; i < POWER_STATES; i++) {
+        out.printf("lamp_power_state_millis_total{state=\"%s\"} %lu\n", POWER_STATE_NAMES[i],
+                   (unsigned long)powerStateMillis[i].get());
+    }
+    out.printf("# TYPE lamp_light_sleep_millis_total counter\nlamp_light_sleep_millis_total %lu\n",
+               (unsigned long)sleptMillis.get());
+    out.printf("# TYPE lamp_wakes_total counter\nlamp_wakes_total{source=\"button\"} %lu\n"
+               "lamp_wakes_total{source=\"timer\"} %lu\n",
+               (unsigned long)buttonWakes.get(), (unsigned long)timerWakes.get());
+    writeSummary(out, "lamp_wake_latency_micros", wakeLatency);
+    writeSummary(out, "lamp_clock_restore_micros", clockRestore);
+    writeSummary(out, "lamp_button_wake_micros", buttonWakeLatency);
+
+    out.printf("# TYPE lamp_http_request_micros summary\n");
+    for (int i = 0; i < static_cast<int>(Route::Count); i++) {
+        const LatencyStat &stat = routes[i];
+        out.printf("lamp_http_request_micros_count{route=\"%s\"} %lu\n", ROUTE_NAMES[i], (unsigned long)stat.count.load());
+        out.printf("lamp_http_request_micros_sum{route=\"%s\"} %lu\n", ROUTE_NAMES[i], (unsigned long)stat.totalMicros.load());
+        out.printf("lamp_http_request_micros_max{route=\"%s\"} %lu\n", ROUTE_NAMES[i], (unsigned long)stat.maxMicros.load());
+    }
+    out.printf("# TYPE lamp_http_heap_retained_bytes_total counter\n");
+    for (int i = 0; i < static_cast<int>(Route::Count); i++) {
+        out.printf("lamp_http_heap_retained_bytes_total{route=\"%s\"} %lu\n", ROUTE_NAMES[i],
+                   (unsigned long)routeHeap[i].retainedBytes.get());
+    }
+    out.printf("# TYPE lamp_http_heap_retaining_requests_total counter\n");
+    for (int i = 0; i < static_cast<int>(Route::Count); i++) {
+        out.printf("lamp_http_heap_retaining_requests_total{route=\"%s\"} %lu\n", ROUTE_NAMES[i],
+                   (unsigned long)routeHeap[i].retainingCalls.get());
+    }
+
+    if (attachedScheduler != nullptr) {
+        out.printf("# TYPE lamp_task_jitter_micros histogram\n");
+        for (int i = 0; i < attachedScheduler->getTaskCount(); i++) {
+            writeHistogram(out, "lamp_task_jitter_micros", attachedScheduler->getName(i),
+                           attachedScheduler->getStats(i)->jitterHistogram);
+        }
+        out.printf("# TYPE lamp_task_exec_micros histogram\n");
+        for (int i = 0; i < attachedScheduler->getTaskCount(); i++) {
+            writeHistogram(out, "lamp_task_exec_micros", attachedScheduler->getName(i),
+                           attachedScheduler->getStats(i)->execHistogram);
+        }
+        out.printf("# TYPE lamp_task_overruns_total counter\n");
+        for (int i = 0; i < attachedScheduler->getTaskCount(); i++) {
+            out.printf("lamp_task_overruns_total{task=\"%s\"} %lu\n", attachedScheduler->getName(i),
+                       (unsigned long)attachedScheduler->getStats(i)->overruns);
+        }
+    }
+
+    out.printf("# TYPE lamp_heap_free_bytes gauge\nlamp_heap_free_bytes %lu\n", (unsigned long)Hal::freeHeap());
+    out.printf("# TYPE lamp_heap_largest_free_block_bytes gauge\nlamp_heap_largest_free_block_bytes %lu\n",
+               (unsigned long)Hal::largestFreeBlock());
+    out.printf("# TYPE lamp_heap_free_min_bytes gauge\nlamp_heap_free_min_bytes %lu\n", (unsigned long)minFreeHeap);
+    out.printf("# TYPE lamp_heap_largest_free_block_min_bytes gauge\nlamp_heap_largest_free_block_min_bytes %lu\n",
+               (unsigned long)minLargestBlock);
+    out.printf("# TYPE lamp_wifi_clients gauge\nlamp_wifi_clients %u\n", (unsigned)wifiClients.get());
+    out.printf("# TYPE lamp_wifi_start_millis gauge\nlamp_wifi_start_millis %ld\n", (long)wifiStartMillis.get());
+    out.printf("# TYPE lamp_wifi_stop_millis gauge\nlamp_wifi_stop_millis %ld\n", (long)wifiStopMillis.get());
+}
+
+static void writeJsonArray(Print &out, const uint32_t *values, int count) {
+    out.printf("[");
+    for (int i = 0; i < count; i++) {
+        out.printf(i == 0 ? "%lu" : ",%lu", (unsigned long)values[i]);
+    }
+    out.printf("]");
+}
+
+void writeJson(Print &out) {
+    out.printf("{\"setPwmCalls\":%lu,\"ledcWrites\":%lu,\"pwmLatches\":%lu,", (unsigned long)setPwmCalls.get(),
+               (unsigned long)ledcWrites.get(), (unsigned long)pwmLatches.get());
+    out.printf("\"deadbandPasses\":%lu,", (unsigned long)deadbandPasses.get());
+    out.printf("\"pwmLatchWraps\":%lu,\"pwmLatchTicksMax\":%ld,", (unsigned long)pwmLatchWraps.get(),
+               (long)pwmLatchTicksMax.get());
+    out.printf("\"powerDerateTicks\":%lu,\"heatsinkMilliC\":%ld,", (unsigned long)powerDerateTicks.get(),
+               (long)heatsinkMilliC.get());
+    out.printf("\"adcSweep\":{\"count\":%lu,\"sumMicros\":%lu,\"maxMicros\":%lu},",
+               (unsigned long)adcSweep.count.load(), (unsigned long)adcSweep.totalMicros.load(),
+               (unsigned long)adcSweep.maxMicros.load());
+    out.printf("\"ditherTick\":{\"count\":%lu,\"sumMicros\":%lu,\"maxMicros\":%lu},",
+               (unsigned long)ditherTick.count.load(), (unsigned long)ditherTick.totalMicros.load(),
+               (unsigned long)ditherTick.maxMicros.load());
+    out.printf("\"dmxFrames\":%lu,\"dmxStale\":%lu,", (unsigned long)dmxFrames.get(), (unsigned long)dmxStale.get());
+
+    out.printf("\"powerStateMillis\":{");
+    for (int i = 0; i < POWER_STATES; i++) {
+        out.printf("%s\"%s\":%lu", i == 0 ? "" : ",", POWER_STATE_NAMES[i], (unsigned long)powerStateMillis[i].get());
+    }
+    out.printf("},\"sleptMillis\":%lu,\"buttonWakes\":%lu,\"timerWakes\":%lu,", (unsigned long)sleptMillis.get(),
+               (unsigned long)buttonWakes.get(), (unsigned long)timerWakes.get());
+    out.printf("\"wakeLatency\":{\"count\":%lu,\"sumMicros\":%lu,\"maxMicros\":%lu},",
+               (unsigned long)wakeLatency.count.load(), (unsigned long)wakeLatency.totalMicros.load(),
+               (unsigned long)wakeLatency.maxMicros.load());
+    out.printf("\"clockRestore\":{\"count\":%lu,\"sumMicros\":%lu,\"maxMicros\":%lu},",
+               (unsigned long)clockRestore.count.load(), (unsigned long)clockRestore.totalMicros.load(),
+               (unsigned long)clockRestore.maxMicros.load());
+    out.printf("\"buttonWakeLatency\":{\"count\":%lu,\"sumMicros\":%lu,\"maxMicros\":%lu},",
+               (unsigned long)buttonWakeLatency.count.load(), (unsigned long)buttonWakeLatency.totalMicros.load(),
+               (unsigned long)buttonWakeLatency.maxMicros.load());
+    out.printf("\"routes\":{");
+    for (int i = 0; i < static_cast<int>(Route::Count); i++) {
+        const LatencyStat &stat = routes[i];
+        out.printf("%s\"%s\":{\"count\":%lu,\"sumMicros\":%lu,\"maxMicros\":%lu,\"heapRetainedBytes\":%lu,"
+                   "\"heapRetainingRequests\":%lu}",
+                   i == 0 ? "" : ",", ROUTE_NAMES[i], (unsigned long)stat.count.load(),
+                   (unsigned long)stat.totalMicros.load(), (unsigned long)stat.maxMicros.load(),
+                   (unsigned long)routeHeap[i].retainedBytes.get(), (unsigned long)routeHeap[i].retainingCalls.get());
+    }
+    out.printf("},\"tasks\":{");
+    if (attachedScheduler != nullptr) {
+        for (int i = 0; i < attachedScheduler->getTaskCount(); i++) {
+            const TaskStats *stats = attachedScheduler->getStats(i);
+            out.printf("%s\"%s\":{\"runs\":%lu,\"overruns\":%lu,\"maxJitterMicros\":%lu,\"maxExecMicros\":%lu,\"jitter\":",
+                       i == 0 ? "" : ",", attachedScheduler->getName(i), (unsigned long)stats->runs,
+                       (unsigned long)stats->overruns, (unsigned long)stats->maxJitterUs,
+                       (unsigned long)stats->maxExecUs);
+            writeJsonArray(out, stats->jitterHistogram, TaskStats::BUCKETS);
+            out.printf(",\"exec\":");
+            writeJsonArray(out, stats->execHistogram, TaskStats::BUCKETS);
+            out.printf("}");
+        }
+    }
+    out.printf("},\"heapFree\":%lu,\"heapLargestFreeBlock\":%lu,\"heapFreeMin\":%lu,\"heapLargestFreeBlockMin\":%lu,",
+               (unsigned long)Hal::freeHeap(), (unsigned long)Hal::largestFreeBlock(), (unsigned long)minFreeHeap,
+               (unsigned long)minLargestBlock);
+    // Oldest first, one sample per minute
+    uint32_t history[HEAP_HISTORY];
+    for (int i = 0; i < heapHistoryCount; i++) {
+        history[i] = largestBlockHistory[(heapHistoryHead - heapHistoryCount + i + HEAP_HISTORY) % HEAP_HISTORY];
+    }
+    out.printf("\"heapLargestFreeBlockHistory\":");
+    writeJsonArray(out, history, heapHistoryCount);
+    out.printf(",\"wifiClients\":%u,\"wifiStartMillis\":%ld,\"wifiStopMillis\":%ld}", (unsigned)wifiClients.get(),
+               (long)wifiStartMillis.get(), (long)wifiStopMillis.get());
+}
+
+}
@@ -0,0 +1,146 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "Platform.h"
+#include "Hal.h"
+#include <atomic>
+
+class Scheduler;
+
+// Production counters. Updates are single relaxed atomic ops (or a plain
+// store for maxima, where a lost race only under-reports), so they stay on
+// in every build. Rendering happens only when /metrics is requested.
+namespace Metrics {
+
+struct Counter {
+    std::atomic<uint32_t> value{0};
+    void increment(uint32_t amount = 1) { value.fetch_add(amount, std::memory_order_relaxed); }
+    uint32_t get() const { return value.load(std::memory_order_relaxed); }
+};
+
+struct Gauge {
+    std::atomic<int32_t> value{0};
+    void set(int32_t newValue) { value.store(newValue, std::memory_order_relaxed); }
+    int32_t get() const { return value.load(std::memory_order_relaxed); }
+};
+
+struct LatencyStat {
+    std::atomic<uint32_t> count{0};
+    std::atomic<uint32_t> totalMicros{0};
+    std::atomic<uint32_t> maxMicros{0};
+
+    void record(uint32_t micros) {
+        count.fetch_add(1, std::memory_order_relaxed);
+        totalMicros.fetch_add(micros, std::memory_order_relaxed);
+        if (micros > maxMicros.load(std::memory_order_relaxed)) {
+            maxMicros.store(micros, std::memory_order_relaxed);
+        }
+    }
+};
+
+enum class Route : uint8_t {
+    Asset,
+    LockStatus,
+    Unlock,
+    Reset,
+    PostRgb,
+    WebSocket,
+    Metrics,
+    DmxConfig,
+    Sync,
+    Cue,
+    PostCct,
+    Calibration,
+    Trace,
+    Presets,
+    Recall,
+    Sequence,
+    Hysteresis,
+    Role,
+    Count,
+};
+
+extern Counter setPwmCalls;     // LEDController::setPWMDirectly calls (pot levels)
+extern Counter deadbandPasses;  // Of those, calls where a channel got past the dead-band
+// Channel duties the dither tick changed and staged into LEDC. Includes the
+// dither's own one-code toggles, so it tracks the fractional targets rather
+// than the dead-band; compare deadbandPasses with setPwmCalls for that
+extern Counter ledcWrites;
+extern Counter pwmLatches;      // Grouped latches of the staged duties
+extern Counter pwmLatchWraps;   // Latches the PWM period rolled over during; should stay 0
+extern Gauge pwmLatchTicksMax;  // Slowest latch in LEDC timer ticks; PwmOutput keeps twice this as guard
+extern Counter powerDerateTicks; // Control ticks with the thermal budget below peak
+extern Gauge heatsinkMilliC;    // PowerGovernor's heatsink temperature estimate
+extern LatencyStat adcSweep;    // One pass over all pots in PotSampler
+extern LatencyStat ditherTick;  // One dither timer callback in LEDController, latch included
+extern Counter dmxFrames;       // DMX packets accepted for the patched universe
+extern Counter dmxStale;        // DMX packets dropped as out of sequence
+extern Gauge wifiClients;       // Stations on the access point, set by WiFiManager
+extern Gauge wifiStartMillis;   // Last WiFi bring-up in ms, first step to serving
+extern Gauge wifiStopMillis;    // Last WiFi shutdown in ms, leaving Serving to stopped
+extern LatencyStat routes[static_cast<int>(Route::Count)];
+
+// Power management, indexed by PowerState: active, downclocked, light sleep
+constexpr int POWER_STATES = 3;
+extern Counter powerStateMillis[POWER_STATES]; // Wall time spent in each state
+extern Counter sleptMillis;      // Time actually inside light sleep
+extern Counter buttonWakes;      // Light sleeps ended by the button
+extern Counter timerWakes;       // Light sleeps ended by the housekeeping timer
+extern LatencyStat wakeLatency;  // Timer wakes: time past the requested wake-up
+extern LatencyStat clockRestore; // Raising the CPU back to full clock
+extern LatencyStat buttonWakeLatency; // Button wakes: from the press to full clock
+
+// Free heap lost across a handler's own work (positive deltas only), for
+// routes timed with ScopedRequest. Other tasks can allocate meanwhile, so a
+// route is only proven clean when this stays at zero
+struct HeapStat {
+    Counter retainedBytes;
+    Counter retainingCalls;
+};
+extern HeapStat routeHeap[static_cast<int>(Route::Count)];
+
+inline LatencyStat &route(Route r) { return routes[static_cast<int>(r)]; }
+
+// Heap sampled by the housekeeping task: low-water marks since boot and the
+// largest free block once a minute over the last HEAP_HISTORY minutes
+constexpr int HEAP_HISTORY = 60;
+void sampleHeap(uint32_t nowMs);
+
+// Scheduler whose per-task stats are included in the output
+void attachScheduler(const Scheduler *scheduler);
+
+void writePrometheus(Print &out);
+void writeJson(Print &out);
+
+// Times the enclosing scope into a latency stat
+class ScopedTimer {
+public:
+    explicit ScopedTimer(LatencyStat &target) : stat(target), start(Hal::nowMicros()) {}
+    ~ScopedTimer() { stat.record(Hal::nowMicros() - start); }
+
+private:
+    LatencyStat &stat;
+    uint32_t start;
+};
+
+// ScopedTimer for an HTTP route that also records heap retained by the handler
+class ScopedRequest {
+public:
+    explicit ScopedRequest(Route r) : timer(route(r)), heap(routeHeap[static_cast<int>(r)]), freeAtStart(Hal::freeHeap()) {}
+    ~ScopedRequest() {
+        uint32_t freeNow = Hal::freeHeap();
+        if (freeNow < freeAtStart) {
+            heap.retainedBytes.increment(freeAtStart - freeNow);
+            heap.retainingCalls.increment();
+        }
+    }
+
+private:
+    ScopedTimer timer;
+    HeapStat &heap;
+    uint32_t freeAtStart;
+};
+
+}
+
+#endif
@@ -0,0 +1,53 @@
+#include "PotSampler.h"
+#include "Hal.h"
+#include "Metrics.h"
+#include "Trace.h"
+
+void PotSampler::begin() {
+    if (started) {
+        return;
+    }
+    // Same priority as the Arduino loop task, so sampling interleaves with
+    // the control loop instead of preempting it mid-tick
+    started = Hal::startTask(samplerTask, "pot_sampler", 2048, this, 1);
+}
+
+void PotSampler::pushSample(int pot, uint16_t milliVolts) {
+    Ring& ring = rings[pot];
+    uint32_t head = ring.head.load(std::memory_order_relaxed);
+    ring.samples[head & (RING_SIZE - 1)] = milliVolts;
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+int PotSampler::read(int pot) const {
+    // The reader only looks at the newest SAMPLES_PER_READ slots. The writer
+    // would have to lap the other half of the ring during this loop to touch
+    // them, which cannot happen at the sampling period
+    const Ring& ring = rings[pot];
+    uint32_t head = ring.head.load(std::memory_order_acquire);
+    uint32_t count = head < SAMPLES_PER_READ ? head : SAMPLES_PER_READ;
+    if (count == 0) {
+        return 0;
+    }
+    uint32_t sum = 0;
+    for (uint32_t i = 1; i <= count; i++) {
+        sum += ring.samples[(head - i) & (RING_SIZE - 1)];
+    }
+    return sum / count;
+}
+
+void PotSampler::samplerTask(void* arg) {
+    PotSampler* self = static_cast<PotSampler*>(arg);
+    uint32_t lastWake = Hal::taskTicks();
+    for (;;) {
+        uint32_t start = Hal::nowMicros();
+        uint16_t sweep[NUM_POTS];
+        for (int pot = 0; pot < NUM_POTS; pot++) {
+            sweep[pot] = Hal::adcMilliVolts(self->pins[pot]);
+            self->pushSample(pot, sweep[pot]);
+        }
+        Metrics::adcSweep.record(Hal::nowMicros() - start);
+        Trace::record(Trace::Type::AdcSweep, 0, sweep[0], sweep[1], sweep[2]);
+        Hal::sleepUntil(lastWake, self->samplePeriodMs.load(std::memory_order_relaxed));
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef POT_SAMPLER_H
+#define POT_SAMPLER_H
+
+#include "Platform.h"
+#include <atomic>
+
+// Samples the three pots from a background FreeRTOS task into one ring buffer
+// per pot, so loop() only reads the latest averaged value and never waits on
+// the ADC. Each ring has a single writer (the sampler task) and a single reader
+// (the control loop); only the head index is shared.
+//
+// pushSample() is the producer entry point. On the device the sampler task
+// calls it; a host build can skip begin() and push synthetic samples instead.
+class PotSampler {
+public:
+    static constexpr int NUM_POTS = 3;
+    static constexpr int RING_SIZE = 8;         // Must be a power of two
+    static constexpr int SAMPLES_PER_READ = 4;  // Samples averaged by read()
+    static constexpr uint32_t DEFAULT_PERIOD_MS = 5;
+
+    PotSampler(int pot0Pin, int pot1Pin, int pot2Pin, uint32_t periodMs = DEFAULT_PERIOD_MS)
+        : pins{pot0Pin, pot1Pin, pot2Pin}, samplePeriodMs(periodMs) {}
+
+    void begin();
+    void pushSample(int pot, uint16_t milliVolts);
+    int read(int pot) const;
+
+    // Takes effect from the next sweep; the power manager slows sampling
+    // down while the lamp is idle
+    void setPeriod(uint32_t periodMs) { samplePeriodMs.store(periodMs, std::memory_order_relaxed); }
+    uint32_t getPeriod() const { return samplePeriodMs.load(std::memory_order_relaxed); }
+
+private:
+    struct Ring {
+        uint16_t samples[RING_SIZE] = {0};
+        std::atomic<uint32_t> head{0};
+    };
+
+    const int pins[NUM_POTS];
+    std::atomic<uint32_t> samplePeriodMs;
+    Ring rings[NUM_POTS];
+    bool started = false;
+
+    static void samplerTask(void* arg);
+};
+
+#endif
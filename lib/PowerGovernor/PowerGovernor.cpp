@@ -0,0 +1,38 @@
+#include "PowerGovernor.h"
+
+constexpr PowerProfile PowerGovernor::LOCKED;
+constexpr PowerProfile PowerGovernor::UNLOCKED;
+
+uint32_t PowerGovernor::budget() const {
+    const int32_t startQ20 = (profile->derateStartC - AMBIENT_C) << RISE_SHIFT;
+    const int32_t ceilingQ20 = (CEILING_C - AMBIENT_C) << RISE_SHIFT;
+    const uint32_t floor = profile->peakQ16 < SUSTAINABLE_Q16 ? profile->peakQ16 : SUSTAINABLE_Q16;
+    if (riseQ20 <= startQ20) {
+        return profile->peakQ16;
+    }
+    if (riseQ20 >= ceilingQ20) {
+        return floor;
+    }
+    // Linear ramp from the peak budget down to the sustainable one
+    uint64_t span = profile->peakQ16 - floor;
+    return profile->peakQ16 - static_cast<uint32_t>(span * (riseQ20 - startQ20) / (ceilingQ20 - startQ20));
+}
+
+uint32_t PowerGovernor::scaleFor(uint32_t requestedQ16) const {
+    uint32_t limit = budget();
+    if (requestedQ16 <= limit) {
+        return FULL_POWER_Q16;
+    }
+    return static_cast<uint32_t>((static_cast<uint64_t>(limit) << FIXED_SHIFT) / requestedQ16);
+}
+
+// Forward Euler on dRise/dt = (P * RISE_AT_FULL - rise) / tau. Control ticks
+// are milliseconds against a minutes-long time constant, so it is stable
+void PowerGovernor::integrate(uint32_t outputQ16, uint32_t elapsedMs) {
+    if (elapsedMs > TIME_CONSTANT_MS) {
+        elapsedMs = TIME_CONSTANT_MS;
+    }
+    int64_t targetQ20 = (static_cast<int64_t>(outputQ16) * RISE_AT_FULL_C) << (RISE_SHIFT - FIXED_SHIFT);
+    int64_t error = targetQ20 - riseQ20;
+    riseQ20 += static_cast<int32_t>(error * elapsedMs / TIME_CONSTANT_MS);
+}
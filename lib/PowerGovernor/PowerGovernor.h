@@ -0,0 +1,72 @@
+#ifndef POWER_GOVERNOR_H
+#define POWER_GOVERNOR_H
+
+#include "Platform.h"
+
+// Power is expressed as a Q16 fraction of all channels at full duty, so
+// 65536 is the hardware limit and one saturated channel is about 21845.
+struct PowerProfile {
+    uint32_t peakQ16;        // Instantaneous total power allowed while cool
+    int32_t derateStartC;    // Estimated heatsink temperature where derating begins
+};
+
+// Tracks total output power and a first-order RC estimate of heatsink
+// temperature, and returns the scale that keeps both inside the active
+// profile. Below derateStartC the full peak budget is available, so short
+// bursts and single-channel colors run unrestricted. Between derateStartC
+// and CEILING_C the budget ramps down to the power that holds the heatsink
+// at CEILING_C in steady state, so the estimate never crosses the ceiling.
+//
+// Integer only: the temperature rise is carried in Q20 °C and integrated
+// with 64-bit intermediates, which keeps per-tick rounding far below 1 °C
+// over a full time constant.
+class PowerGovernor {
+public:
+    static constexpr int FIXED_SHIFT = 16;
+    static constexpr uint32_t FULL_POWER_Q16 = 1UL << FIXED_SHIFT;
+
+    // Thermal model. RISE_AT_FULL_C is the steady-state heatsink rise with
+    // every channel at full duty; with it, the old 60% white cap settles
+    // just above the 63 °C hardware cutoff and the 30% cap well below it
+    static constexpr int32_t AMBIENT_C = 25;
+    static constexpr int32_t RISE_AT_FULL_C = 65;
+    static constexpr uint32_t TIME_CONSTANT_MS = 240000;
+    static constexpr int32_t CEILING_C = 58; // Margin below the 63 °C cutoff
+
+    // Power that holds the heatsink at CEILING_C indefinitely
+    static constexpr uint32_t SUSTAINABLE_Q16 =
+        static_cast<uint32_t>((static_cast<uint64_t>(CEILING_C - AMBIENT_C) << FIXED_SHIFT) / RISE_AT_FULL_C);
+
+    // Locked allows one channel at full (white lands near the old 30% cap);
+    // unlocked allows the hardware limit until the heatsink warms up
+    static constexpr PowerProfile LOCKED = {FULL_POWER_Q16 / 3 + 1, 45};
+    static constexpr PowerProfile UNLOCKED = {FULL_POWER_Q16, 48};
+
+    void setProfile(const PowerProfile& newProfile) { profile = &newProfile; }
+    bool isProfile(const PowerProfile& candidate) const { return profile == &candidate; }
+
+    // Scale (Q16, at most 1.0) to apply to a requested total power right now
+    uint32_t scaleFor(uint32_t requestedQ16) const;
+
+    // Integrates the thermal model over elapsedMs at the given output power
+    void integrate(uint32_t outputQ16, uint32_t elapsedMs);
+
+    // Budget at the current temperature estimate (Q16)
+    uint32_t budget() const;
+    // Estimated heatsink temperature in milli-degrees C
+    int32_t temperatureMilliC() const {
+        return AMBIENT_C * 1000 + static_cast<int32_t>((static_cast<int64_t>(riseQ20) * 1000) >> RISE_SHIFT);
+    }
+    bool isDerating() const { return budget() < profile->peakQ16; }
+
+private:
+    static constexpr int RISE_SHIFT = 20;
+    const PowerProfile* profile = &LOCKED;
+    // Heatsink temperature above ambient, Q20 °C. A reset can come while the
+    // heatsink is still hot, so the estimate starts at the ceiling and cools
+    // from there: the lamp boots at the sustainable budget, and the peak
+    // comes back within a time constant or two of running cool
+    int32_t riseQ20 = (CEILING_C - AMBIENT_C) << RISE_SHIFT;
+};
+
+#endif
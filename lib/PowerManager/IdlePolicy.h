@@ -0,0 +1,71 @@
+#ifndef IDLE_POLICY_H
+#define IDLE_POLICY_H
+
+#include "Platform.h"
+
+enum class PowerState : uint8_t {
+    Active,      // Full clock, full-rate pot sampling
+    Downclocked, // RGB/LTT with untouched pots: lower clock, slow pot checks
+    LightSleep,  // OFF: light sleep between button wakes and housekeeping
+    Count,
+};
+
+// What the control loop saw this tick. Pots are the filtered 0-2047 values
+struct IdleInputs {
+    bool off;          // OperationMode::OFF
+    bool serving;      // WiFi mode; the radio needs the full clock and no sleep
+    bool buttonIdle;   // No press, release or double-click window in progress
+    int pots[3];
+};
+
+// Decides the power state from the control loop's inputs. Pure logic on a
+// caller-supplied millis() time with no hardware access, so a host build can
+// drive it with a fake clock and scripted inputs; PowerManager applies it.
+//
+// Any button activity, mode change or pot movement beyond POT_WAKE_THRESHOLD
+// returns to Active at once. OFF sleeps after OFF_SETTLE_MS, long enough for
+// a double-click or long-press out of OFF and the settings flush; RGB and LTT
+// downclock after IDLE_AFTER_MS without a touch.
+class IdlePolicy {
+public:
+    static constexpr uint32_t IDLE_AFTER_MS = 30000;
+    static constexpr uint32_t OFF_SETTLE_MS = 2000;
+    static constexpr int POT_WAKE_THRESHOLD = 24; // Above filtered pot noise
+
+    PowerState update(uint32_t nowMs, const IdleInputs& in) {
+        bool moved = false;
+        for (int i = 0; i < 3; i++) {
+            int delta = in.pots[i] - potsAtRest[i];
+            if (delta > POT_WAKE_THRESHOLD || delta < -POT_WAKE_THRESHOLD) {
+                potsAtRest[i] = in.pots[i];
+                moved = true;
+            }
+        }
+        // Pots do nothing in OFF, so turning them there is not activity
+        if ((moved && !in.off) || in.serving || !in.buttonIdle || in.off != wasOff || !started) {
+            lastActivityMs = nowMs;
+        }
+        wasOff = in.off;
+        started = true;
+
+        uint32_t quietMs = nowMs - lastActivityMs;
+        if (in.serving) {
+            return PowerState::Active;
+        }
+        if (in.off) {
+            return quietMs >= OFF_SETTLE_MS ? PowerState::LightSleep : PowerState::Active;
+        }
+        return quietMs >= IDLE_AFTER_MS ? PowerState::Downclocked : PowerState::Active;
+    }
+
+    // A wake source fired (button or pot check); restarts the quiet period
+    void noteActivity(uint32_t nowMs) { lastActivityMs = nowMs; }
+
+private:
+    int potsAtRest[3] = {0};
+    uint32_t lastActivityMs = 0;
+    bool wasOff = false;
+    bool started = false;
+};
+
+#endif
@@ -0,0 +1,63 @@
+#include "PowerManager.h"
+#include "Log.h"
+#include "Metrics.h"
+#include "Hal.h"
+
+static_assert(static_cast<int>(PowerState::Count) == Metrics::POWER_STATES, "Metrics needs a slot per power state");
+
+static const char* const STATE_NAMES[] = {"active", "downclocked", "light sleep"};
+
+void PowerManager::begin() {
+    lastAccountMs = Hal::nowMillis();
+    Hal::configureSleepWakeups(SLEEP_CHUNK_US);
+}
+
+PowerState PowerManager::update(uint32_t nowMs, const IdleInputs& inputs) {
+    PowerState next = policy.update(nowMs, inputs);
+    account(nowMs);
+    if (next != state) {
+        enter(next);
+    }
+    return state;
+}
+
+void PowerManager::account(uint32_t nowMs) {
+    Metrics::powerStateMillis[static_cast<int>(state)].increment(nowMs - lastAccountMs);
+    lastAccountMs = nowMs;
+}
+
+void PowerManager::enter(PowerState next) {
+    if (next == PowerState::Active) {
+        uint32_t start = Hal::nowMicros();
+        Hal::setCpuMhz(FULL_MHZ);
+        sampler.setPeriod(PotSampler::DEFAULT_PERIOD_MS);
+        Metrics::clockRestore.record(Hal::nowMicros() - start);
+    } else if (state == PowerState::Active) {
+        Hal::setCpuMhz(IDLE_MHZ);
+        sampler.setPeriod(IDLE_SAMPLE_PERIOD_MS);
+    }
+    state = next;
+    LOG_INFO("Power state: %s\n", STATE_NAMES[static_cast<int>(state)]);
+}
+
+bool PowerManager::lightSleep() {
+    uint32_t start = Hal::nowMicros();
+    uint32_t wokeAt;
+    bool buttonWoke = Hal::lightSleep(wakePin, wokeAt);
+    uint32_t slept = Hal::nowMicros() - start;
+    Metrics::sleptMillis.increment(slept / 1000);
+
+    if (!buttonWoke) {
+        Metrics::timerWakes.increment();
+        Metrics::wakeLatency.record(slept > SLEEP_CHUNK_US ? slept - SLEEP_CHUNK_US : 0);
+        return false;
+    }
+    Metrics::buttonWakes.increment();
+    uint32_t nowMs = Hal::nowMillis();
+    account(nowMs);
+    policy.noteActivity(nowMs);
+    enter(PowerState::Active);
+    // What the user waits through before the loop runs at full speed again
+    Metrics::buttonWakeLatency.record(Hal::nowMicros() - wokeAt);
+    return true;
+}
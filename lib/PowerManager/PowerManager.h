@@ -0,0 +1,48 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include "Platform.h"
+#include "IdlePolicy.h"
+#include "PotSampler.h"
+
+// Applies IdlePolicy to the hardware. Downclocked drops the CPU to IDLE_MHZ,
+// the lowest clock that keeps APB (and so LEDC and the ADC) at 80 MHz, and
+// slows pot sampling to IDLE_SAMPLE_PERIOD_MS, which still catches the first
+// knob turn within one check. LightSleep additionally parks the whole chip
+// from loop() until the button pulls wakePin low or SLEEP_CHUNK_US passes,
+// so housekeeping still runs once a second.
+//
+// Runs on the loop task only. The USB serial console drops out while the
+// chip is asleep and reconnects on the next wake.
+class PowerManager {
+public:
+    static constexpr uint32_t FULL_MHZ = 160;
+    static constexpr uint32_t IDLE_MHZ = 80;
+    static constexpr uint32_t IDLE_SAMPLE_PERIOD_MS = 50;
+    static constexpr uint32_t SLEEP_CHUNK_US = 1000000;
+
+    PowerManager(int buttonPin, PotSampler& potSampler) : wakePin(buttonPin), sampler(potSampler) {}
+
+    void begin();
+
+    // Feeds the policy once per control tick and switches state if needed
+    PowerState update(uint32_t nowMs, const IdleInputs& inputs);
+
+    // Light-sleeps for up to SLEEP_CHUNK_US. Returns true if the button woke
+    // the chip, in which case full speed is already restored
+    bool lightSleep();
+
+    PowerState getState() const { return state; }
+
+private:
+    const int wakePin;
+    PotSampler& sampler;
+    IdlePolicy policy;
+    PowerState state = PowerState::Active;
+    uint32_t lastAccountMs = 0;
+
+    void enter(PowerState next);
+    void account(uint32_t nowMs);
+};
+
+#endif
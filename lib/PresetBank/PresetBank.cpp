@@ -0,0 +1,93 @@
+#include "PresetBank.h"
+#include "ColorEngine.h"
+#include "Log.h"
+
+static const char* NAMESPACE = "led";
+static const char* BLOB_KEY = "presets";
+
+void PresetBank::begin() {
+    PresetTable table;
+    preferences.begin(NAMESPACE, true);
+    if (preferences.getBytesLength(BLOB_KEY) == sizeof(PresetTable)) {
+        PresetTable stored;
+        preferences.getBytes(BLOB_KEY, &stored, sizeof(stored));
+        if (isValid(stored)) {
+            table = stored;
+        } else {
+            LOG_WARN("Stored presets rejected\n");
+        }
+    }
+    preferences.end();
+    for (int i = 0; i < PresetTable::COUNT; i++) {
+        slots[i].store(table.presets[i]);
+    }
+}
+
+bool PresetBank::get(int index, Preset& preset) const {
+    if (index < 0 || index >= PresetTable::COUNT) {
+        return false;
+    }
+    preset = slots[index].load();
+    return preset.kind != PresetKind::Empty;
+}
+
+PresetTable PresetBank::snapshot() const {
+    PresetTable table;
+    for (int i = 0; i < PresetTable::COUNT; i++) {
+        table.presets[i] = slots[i].load();
+    }
+    return table;
+}
+
+void PresetBank::replace(const PresetTable& table) {
+    for (int i = 0; i < PresetTable::COUNT; i++) {
+        slots[i].store(table.presets[i]);
+    }
+    dirty.store(true, std::memory_order_release);
+}
+
+bool PresetBank::isValid(const PresetTable& table) {
+    if (table.version != PresetTable::VERSION || table.count != PresetTable::COUNT) {
+        return false;
+    }
+    for (const Preset& preset : table.presets) {
+        if (static_cast<uint8_t>(preset.power) > static_cast<uint8_t>(PresetPower::Unlocked)) {
+            return false;
+        }
+        switch (preset.kind) {
+        case PresetKind::Empty:
+            break;
+        case PresetKind::Rgb:
+            if (preset.values[0] > 2047 || preset.values[1] > 2047 || preset.values[2] > 2047) {
+                return false;
+            }
+            break;
+        case PresetKind::Cct: {
+            int16_t duv = static_cast<int16_t>(preset.values[2]);
+            if (preset.values[0] > 2047 || preset.values[1] < ColorEngine::MIN_KELVIN ||
+                preset.values[1] > ColorEngine::MAX_KELVIN || duv < -ColorEngine::MAX_DUV ||
+                duv > ColorEngine::MAX_DUV) {
+                return false;
+            }
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+void PresetBank::flush(unsigned long now, bool force) {
+    if (!dirty.load(std::memory_order_acquire) || (!force && now - lastFlush < MIN_FLUSH_INTERVAL)) {
+        return;
+    }
+    // Cleared before the snapshot, so an upload landing meanwhile flushes again
+    dirty.store(false, std::memory_order_relaxed);
+    PresetTable table = snapshot();
+    preferences.begin(NAMESPACE, false);
+    preferences.putBytes(BLOB_KEY, &table, sizeof(table));
+    preferences.end();
+    lastFlush = now;
+    LOG_INFO("Presets saved\n");
+}
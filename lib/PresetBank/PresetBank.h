@@ -0,0 +1,73 @@
+#ifndef PRESET_BANK_H
+#define PRESET_BANK_H
+
+#include "Platform.h"
+#ifdef ARDUINO
+#include <Preferences.h>
+#else
+#include "HostPreferences.h"
+#endif
+#include <atomic>
+#include "ControlMailbox.h"
+
+enum class PresetKind : uint8_t {
+    Empty,
+    Rgb,  // values: red, green, blue on the 11-bit PWM scale
+    Cct,  // values: lightness 0-2047, Kelvin, Duv * 10^4 (as int16 bits)
+};
+
+enum class PresetPower : uint8_t {
+    Keep,     // Leave the power profile as it is
+    Locked,
+    Unlocked,
+};
+
+// One stored look. Fixed 10-byte layout, little-endian like the C3
+struct Preset {
+    PresetKind kind = PresetKind::Empty;
+    PresetPower power = PresetPower::Keep;
+    uint16_t fadeMs = 0;   // Rgb only; CCT presets apply at once
+    uint16_t values[3] = {0};
+};
+static_assert(sizeof(Preset) == 10, "Preset layout is part of the NVS blob and the /presets wire format");
+
+// The whole bank, exactly as stored in NVS and exchanged over /presets
+struct PresetTable {
+    static constexpr uint8_t VERSION = 1;
+    static constexpr int COUNT = 16;
+
+    uint8_t version = VERSION;
+    uint8_t count = COUNT;
+    uint16_t reserved = 0;
+    Preset presets[COUNT];
+};
+
+// RAM mirror of the preset blob. Each slot is its own seqlock, so recall
+// copies one 10-byte preset without locking and never touches flash, even
+// while a new bank is being uploaded. replace() is the only writer and runs
+// on the AsyncTCP task; flush() commits from housekeeping at most once per
+// MIN_FLUSH_INTERVAL, like SettingsStore.
+class PresetBank {
+public:
+    static constexpr unsigned long MIN_FLUSH_INTERVAL = 5000;
+
+    void begin();
+
+    // Any task. False for an empty or out-of-range slot
+    bool get(int index, Preset& preset) const;
+    PresetTable snapshot() const;
+
+    // Writer side. The table must have passed isValid()
+    void replace(const PresetTable& table);
+    static bool isValid(const PresetTable& table);
+
+    void flush(unsigned long now, bool force = false);
+
+private:
+    Preferences preferences;
+    SeqLock<Preset> slots[PresetTable::COUNT];
+    std::atomic<bool> dirty{false};
+    unsigned long lastFlush = 0;
+};
+
+#endif
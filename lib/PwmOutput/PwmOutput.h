@@ -0,0 +1,89 @@
+#ifndef PWM_OUTPUT_H
+#define PWM_OUTPUT_H
+
+#include "Platform.h"
+#include "Hal.h"
+#include "Metrics.h"
+
+// LEDC output stage with the logical-channel-to-pin map fixed at compile
+// time: PwmOutput<7, 6, 5> drives logical channel 0 on GPIO7 through LEDC
+// channel 0, and so on. Any number of channels up to the LEDC count works,
+// so an RGBW build only adds a pin.
+//
+// All channels share one LEDC timer. stage() loads a channel's next duty
+// without touching the pin, and commit() latches everything staged at the
+// same period boundary, so a color change never shows a PWM period with
+// some channels old and some new. Only one task may stage and commit.
+template <int... Pins>
+class PwmOutput {
+public:
+    static constexpr int CHANNELS = sizeof...(Pins);
+    static_assert(CHANNELS > 0 && CHANNELS <= Hal::PWM_MAX_CHANNELS, "One LEDC channel per output pin");
+
+    // Starting guard before the counter wraps, ample for a few register
+    // writes even at the idle CPU clock. commit() times every latch against
+    // the LEDC counter and widens the guard to twice the slowest latch seen
+    static constexpr uint32_t LATCH_GUARD_US = 2;
+
+    static constexpr int pin(int channel) { return PINS[channel]; }
+
+    bool begin(uint32_t frequency, int resolutionBits) {
+        if (!Hal::pwmTimerSetup(frequency, resolutionBits)) {
+            return false;
+        }
+        for (int i = 0; i < CHANNELS; i++) {
+            if (!Hal::pwmChannelSetup(PINS[i], i)) {
+                return false;
+            }
+        }
+        periodTicks = 1UL << resolutionBits;
+        uint32_t guardTicks =
+            static_cast<uint32_t>(((static_cast<uint64_t>(frequency) << resolutionBits) * LATCH_GUARD_US) / 1000000) + 1;
+        latestTick = periodTicks - guardTicks;
+        return true;
+    }
+
+    // Next duty for one channel; it reaches the pin at the next commit()
+    void stage(int channel, uint32_t duty) {
+        Hal::pwmStage(channel, duty);
+        stagedMask |= 1UL << channel;
+    }
+
+    // Latches every staged channel in the same PWM period. False if nothing was staged
+    bool commit() {
+        if (stagedMask == 0) {
+            return false;
+        }
+        Hal::LatchTiming timing = Hal::pwmLatch(stagedMask, latestTick);
+        stagedMask = 0;
+        bool wrapped = timing.endTick < timing.startTick;
+        uint32_t latchTicks = wrapped ? timing.endTick + periodTicks - timing.startTick : timing.endTick - timing.startTick;
+        if (wrapped) {
+            // The channels may have switched a period apart; the guard was too short
+            Metrics::pwmLatchWraps.increment();
+        }
+        if (latchTicks > worstLatchTicks) {
+            worstLatchTicks = latchTicks;
+            Metrics::pwmLatchTicksMax.set(latchTicks);
+            uint32_t guardTicks = 2 * latchTicks + 1;
+            guardTicks = guardTicks < periodTicks / 2 ? guardTicks : periodTicks / 2;
+            if (periodTicks - guardTicks < latestTick) {
+                latestTick = periodTicks - guardTicks;
+            }
+        }
+        return true;
+    }
+
+    // Counter value past which a latch waits for the next period
+    uint32_t getLatestTick() const { return latestTick; }
+    uint32_t getWorstLatchTicks() const { return worstLatchTicks; }
+
+private:
+    static constexpr int PINS[CHANNELS] = {Pins...};
+    uint32_t stagedMask = 0;
+    uint32_t periodTicks = 0;
+    uint32_t latestTick = 0;
+    uint32_t worstLatchTicks = 0;
+};
+
+#endif
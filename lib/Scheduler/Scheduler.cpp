@@ -0,0 +1,101 @@
+#include "Scheduler.h"
+#include "Hal.h"
+
+int TaskStats::bucketFor(uint32_t us) {
+    int bucket = 0;
+    uint32_t limit = FIRST_BUCKET_US;
+    while (bucket < BUCKETS - 1 && us >= limit) {
+        bucket++;
+        limit <<= 1;
+    }
+    return bucket;
+}
+
+void TaskStats::record(uint32_t jitterUs, uint32_t execUs) {
+    runs++;
+    jitterHistogram[bucketFor(jitterUs)]++;
+    execHistogram[bucketFor(execUs)]++;
+    if (jitterUs > maxJitterUs) {
+        maxJitterUs = jitterUs;
+    }
+    if (execUs > maxExecUs) {
+        maxExecUs = execUs;
+    }
+}
+
+int Scheduler::add(const char* name, uint32_t periodMicros, TaskFunction function) {
+    if (taskCount >= MAX_TASKS) {
+        return -1;
+    }
+    Task& task = tasks[taskCount];
+    task.name = name;
+    task.periodMicros = periodMicros;
+    task.function = function;
+    task.nextDueMicros = Hal::nowMicros();
+    task.stats = TaskStats();
+    return taskCount++;
+}
+
+void Scheduler::run() {
+    for (int i = 0; i < taskCount; i++) {
+        Task& task = tasks[i];
+        uint32_t start = Hal::nowMicros();
+        int32_t late = static_cast<int32_t>(start - task.nextDueMicros);
+        if (late < 0) {
+            continue;
+        }
+
+        task.function();
+        uint32_t exec = Hal::nowMicros() - start;
+        task.stats.record(late, exec);
+
+        // Keep a fixed phase; if we fell a whole period behind, skip ahead
+        // instead of running back-to-back to catch up
+        task.nextDueMicros += task.periodMicros;
+        if (static_cast<int32_t>(Hal::nowMicros() - task.nextDueMicros) >= 0) {
+            task.stats.overruns++;
+            task.nextDueMicros = Hal::nowMicros() + task.periodMicros;
+        }
+    }
+}
+
+uint32_t Scheduler::microsUntilNextDue() const {
+    uint32_t now = Hal::nowMicros();
+    uint32_t soonest = UINT32_MAX;
+    for (int i = 0; i < taskCount; i++) {
+        int32_t remaining = static_cast<int32_t>(tasks[i].nextDueMicros - now);
+        if (remaining <= 0) {
+            return 0;
+        }
+        if (static_cast<uint32_t>(remaining) < soonest) {
+            soonest = remaining;
+        }
+    }
+    return soonest;
+}
+
+void Scheduler::resume() {
+    uint32_t now = Hal::nowMicros();
+    for (int i = 0; i < taskCount; i++) {
+        tasks[i].nextDueMicros = now;
+    }
+}
+
+void Scheduler::printStats(Print& out) const {
+    for (int i = 0; i < taskCount; i++) {
+        const Task& task = tasks[i];
+        const TaskStats& stats = task.stats;
+        out.printf("[%s] period=%luus runs=%lu overruns=%lu maxJitter=%luus maxExec=%luus\n",
+                   task.name, (unsigned long)task.periodMicros, (unsigned long)stats.runs,
+                   (unsigned long)stats.overruns, (unsigned long)stats.maxJitterUs, (unsigned long)stats.maxExecUs);
+        out.printf("  jitter:");
+        for (int b = 0; b < TaskStats::BUCKETS; b++) {
+            out.printf(" %lu", (unsigned long)stats.jitterHistogram[b]);
+        }
+        out.printf("\n  exec:  ");
+        for (int b = 0; b < TaskStats::BUCKETS; b++) {
+            out.printf(" %lu", (unsigned long)stats.execHistogram[b]);
+        }
+        out.printf("\n");
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "Platform.h"
+
+// Period jitter and execution time for one task, as counts in power-of-two
+// microsecond buckets: [0, 64), [64, 128), ... [4096, inf)
+struct TaskStats {
+    static constexpr int BUCKETS = 8;
+    static constexpr uint32_t FIRST_BUCKET_US = 64;
+
+    uint32_t runs = 0;
+    uint32_t overruns = 0;
+    uint32_t maxJitterUs = 0;
+    uint32_t maxExecUs = 0;
+    uint32_t jitterHistogram[BUCKETS] = {0};
+    uint32_t execHistogram[BUCKETS] = {0};
+
+    static int bucketFor(uint32_t us);
+    void record(uint32_t jitterUs, uint32_t execUs);
+};
+
+// Rate-group scheduler run from loop(). Each task has its own period; when
+// several are due in the same pass they run in registration order, so tasks
+// added first have priority. Everything runs on the loop task, so stages can
+// share controller state without locking.
+class Scheduler {
+public:
+    typedef void (*TaskFunction)();
+    static constexpr int MAX_TASKS = 6;
+
+    // Returns the task index, or -1 if the table is full
+    int add(const char* name, uint32_t periodMicros, TaskFunction function);
+    void run();
+    uint32_t microsUntilNextDue() const;
+    // Makes every task due now after the loop was deliberately parked (light
+    // sleep), so the gap is not recorded as jitter or overruns
+    void resume();
+    const TaskStats* getStats(int index) const { return index < taskCount ? &tasks[index].stats : nullptr; }
+    const char* getName(int index) const { return index < taskCount ? tasks[index].name : nullptr; }
+    int getTaskCount() const { return taskCount; }
+    void printStats(Print& out) const;
+
+private:
+    struct Task {
+        const char* name;
+        uint32_t periodMicros;
+        TaskFunction function;
+        uint32_t nextDueMicros;
+        TaskStats stats;
+    };
+
+    Task tasks[MAX_TASKS];
+    int taskCount = 0;
+};
+
+#endif
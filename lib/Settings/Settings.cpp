@@ -0,0 +1,92 @@
+#include "Settings.h"
+#include "Log.h"
+
+static const char* NAMESPACE = "led";
+static const char* BLOB_KEY = "settings";
+
+void SettingsStore::begin() {
+    preferences.begin(NAMESPACE, true);
+    size_t storedLength = preferences.getBytesLength(BLOB_KEY);
+    PersistedSettings stored;
+    bool valid = storedLength == sizeof(stored) && preferences.getBytes(BLOB_KEY, &stored, sizeof(stored)) == sizeof(stored) &&
+                 stored.version == PersistedSettings::VERSION;
+    if (valid) {
+        settings = stored;
+    } else {
+        if (storedLength > 0) {
+            LOG_WARN("Stored settings rejected\n");
+        }
+        // Firmware from before the blob only stored the unlock flag
+        settings.unlocked = preferences.getBool("unlocked", false);
+    }
+    preferences.end();
+    LOG_INFO("Settings loaded (%s)\n", settings.unlocked ? "unlocked" : "locked");
+}
+
+void SettingsStore::setUnlocked(bool unlocked) {
+    if (settings.unlocked != unlocked) {
+        settings.unlocked = unlocked;
+        markDirty();
+    }
+}
+
+void SettingsStore::setLastMode(uint8_t mode) {
+    if (settings.lastMode != mode) {
+        settings.lastMode = mode;
+        markDirty();
+    }
+}
+
+void SettingsStore::setWifiColor(int red, int green, int blue) {
+    if (settings.wifiRed != red || settings.wifiGreen != green || settings.wifiBlue != blue) {
+        settings.wifiRed = red;
+        settings.wifiGreen = green;
+        settings.wifiBlue = blue;
+        markDirty();
+    }
+}
+
+void SettingsStore::setHysteresis(int channel, const HysteresisConfig& config) {
+    HysteresisConfig& current = settings.hysteresis[channel];
+    if (current.noiseThreshold != config.noiseThreshold ||
+        current.minThreshold != config.minThreshold ||
+        current.idleTimeThreshold != config.idleTimeThreshold) {
+        current = config;
+        markDirty();
+    }
+}
+
+void SettingsStore::setDmxPatch(uint16_t universe, uint16_t startAddress) {
+    if (settings.dmxUniverse != universe || settings.dmxStartAddress != startAddress) {
+        settings.dmxUniverse = universe;
+        settings.dmxStartAddress = startAddress;
+        markDirty();
+    }
+}
+
+void SettingsStore::setColorMatrix(const int32_t matrix[9]) {
+    if (!settings.colorMatrixSet || memcmp(settings.colorMatrix, matrix, sizeof(settings.colorMatrix)) != 0) {
+        memcpy(settings.colorMatrix, matrix, sizeof(settings.colorMatrix));
+        settings.colorMatrixSet = true;
+        markDirty();
+    }
+}
+
+void SettingsStore::setNetworkRole(NetworkRole role) {
+    if (settings.networkRole != role) {
+        settings.networkRole = role;
+        markDirty();
+    }
+}
+
+void SettingsStore::flush(unsigned long now, bool force) {
+    if (!dirty || (!force && now - lastFlush < MIN_FLUSH_INTERVAL)) {
+        return;
+    }
+    preferences.begin(NAMESPACE, false);
+    preferences.putBytes(BLOB_KEY, &settings, sizeof(settings));
+    preferences.end();
+    dirty = false;
+    lastFlush = now;
+    flushCount++;
+}
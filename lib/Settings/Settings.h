@@ -0,0 +1,71 @@
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include "Platform.h"
+#ifdef ARDUINO
+#include <Preferences.h>
+#else
+#include "HostPreferences.h"
+#endif
+#include "InputFilter.h"
+
+// How a lamp takes part in a multi-lamp network. The leader runs the access
+// point and is the shared-clock reference; followers join its network as
+// stations and sync to it, so every lamp is reachable on one network
+enum class NetworkRole : uint8_t { Leader = 0, Follower = 1 };
+
+// Everything persisted to NVS, stored as one blob in the "led" namespace.
+// Bump VERSION on any layout change: a blob with another version or size is
+// discarded on load rather than read into the wrong fields
+struct PersistedSettings {
+    static constexpr uint8_t VERSION = 4;
+
+    uint8_t version = VERSION;
+    bool unlocked = false;
+    uint8_t lastMode = 0;           // OperationMode, as stored by main.cpp
+    uint16_t wifiRed = 0;           // Last WiFi color, 11-bit PWM scale
+    uint16_t wifiGreen = 0;
+    uint16_t wifiBlue = 0;
+    HysteresisConfig hysteresis[3];
+    uint16_t dmxUniverse = 1;       // E1.31 / Art-Net universe
+    uint16_t dmxStartAddress = 1;   // 1-based DMX slot of the red channel
+    bool colorMatrixSet = false;    // Otherwise ColorEngine uses its default
+    int32_t colorMatrix[9] = {0};   // Q16 XYZ to channel drive, row-major
+    NetworkRole networkRole = NetworkRole::Leader;
+};
+
+// RAM copy of the persisted settings. It is loaded once in begin(), reads never
+// touch flash, and writes only mark it dirty. flush() is called from
+// housekeeping and commits at most once per MIN_FLUSH_INTERVAL, so bursts of
+// changes cost one NVS write and never stall a network handler.
+class SettingsStore {
+public:
+    static constexpr unsigned long MIN_FLUSH_INTERVAL = 5000;
+
+    void begin();
+    const PersistedSettings& get() const { return settings; }
+
+    void setUnlocked(bool unlocked);
+    void setLastMode(uint8_t mode);
+    void setWifiColor(int red, int green, int blue);
+    void setHysteresis(int channel, const HysteresisConfig& config);
+    void setDmxPatch(uint16_t universe, uint16_t startAddress);
+    void setColorMatrix(const int32_t matrix[9]);
+    void setNetworkRole(NetworkRole role);
+
+    // Writes pending changes if the minimum interval has passed, or right away when forced
+    void flush(unsigned long now, bool force = false);
+    bool isDirty() const { return dirty; }
+    uint32_t getFlushCount() const { return flushCount; }
+
+private:
+    Preferences preferences;
+    PersistedSettings settings;
+    bool dirty = false;
+    unsigned long lastFlush = 0;
+    uint32_t flushCount = 0;
+
+    void markDirty() { dirty = true; }
+};
+
+#endif
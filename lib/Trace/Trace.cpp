@@ -0,0 +1,85 @@
+#include "Trace.h"
+
+Trace::Record Trace::ring[CAPACITY];
+std::atomic<uint32_t> Trace::head{0};
+std::atomic<bool> Trace::paused{false};
+std::atomic<uint32_t> Trace::writers{0};
+
+void Trace::recordAt(uint32_t timeMicros, Type type, uint8_t arg, uint16_t v0, uint16_t v1, uint16_t v2) {
+    writers.fetch_add(1, std::memory_order_acquire);
+    if (!paused.load(std::memory_order_acquire)) {
+        uint32_t slot = head.fetch_add(1, std::memory_order_relaxed) & (CAPACITY - 1);
+        ring[slot] = {timeMicros, static_cast<uint8_t>(type), arg, {v0, v1, v2}};
+    }
+    writers.fetch_sub(1, std::memory_order_release);
+}
+
+// Stops new records and waits out any writer already inside record(). The
+// wait sleeps rather than yields: a writer preempted mid-record may sit below
+// the caller's priority (AsyncTCP outranks the loop), and a yield would never
+// hand it the CPU
+void Trace::pause() {
+    paused.store(true, std::memory_order_seq_cst);
+    while (writers.load(std::memory_order_acquire) != 0) {
+        Hal::sleepMillis(1);
+    }
+}
+
+void Trace::resume() {
+    paused.store(false, std::memory_order_release);
+}
+
+void Trace::buildHeader(uint8_t header[16], uint32_t count, uint32_t lost) {
+    memcpy(header, "CSTR", 4);
+    header[4] = VERSION;
+    header[5] = sizeof(Record);
+    header[6] = 0;
+    header[7] = 0;
+    memcpy(&header[8], &count, 4);
+    memcpy(&header[12], &lost, 4);
+}
+
+void Trace::dump(Print &out) {
+    pause();
+    uint32_t end = head.load(std::memory_order_relaxed);
+    uint32_t count = end < CAPACITY ? end : CAPACITY;
+    uint8_t header[16];
+    buildHeader(header, count, end - count);
+    out.write(header, sizeof(header));
+    for (uint32_t i = end - count; i != end; i++) {
+        out.write(reinterpret_cast<const uint8_t *>(&ring[i & (CAPACITY - 1)]), sizeof(Record));
+    }
+    resume();
+}
+
+static void writeHexLine(Print &out, const uint8_t *bytes, size_t length) {
+    static const char DIGITS[] = "0123456789abcdef";
+    char line[2 * 16 + 1];
+    for (size_t i = 0; i < length; i++) {
+        line[2 * i] = DIGITS[bytes[i] >> 4];
+        line[2 * i + 1] = DIGITS[bytes[i] & 0x0F];
+    }
+    line[2 * length] = '\0';
+    out.println(line);
+}
+
+void Trace::dumpHex(Print &out) {
+    pause();
+    uint32_t end = head.load(std::memory_order_relaxed);
+    uint32_t count = end < CAPACITY ? end : CAPACITY;
+    uint8_t header[16];
+    buildHeader(header, count, end - count);
+    out.println("TRACE BEGIN");
+    writeHexLine(out, header, sizeof(header));
+    for (uint32_t i = end - count; i != end; i++) {
+        writeHexLine(out, reinterpret_cast<const uint8_t *>(&ring[i & (CAPACITY - 1)]), sizeof(Record));
+    }
+    out.println("TRACE END");
+    resume();
+}
+
+void Trace::clear() {
+    pause();
+    head.store(0, std::memory_order_relaxed);
+    resume();
+}
@@ -0,0 +1,74 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "Platform.h"
+#include "Hal.h"
+#include <atomic>
+
+// Records per trace; override with -DTRACE_CAPACITY=... (power of two)
+#ifndef TRACE_CAPACITY
+#define TRACE_CAPACITY 2048
+#endif
+
+// Input trace recorder. Raw ADC sweeps, button edges, mode changes and
+// applied network commands go into a RAM ring with microsecond timestamps,
+// overwriting the oldest records, so the last few seconds of input can be
+// pulled off the lamp (Serial 'd' or GET /trace) and replayed off-device.
+//
+// Binary format, little-endian: a 16-byte header ("CSTR", version, record
+// size, 2 reserved bytes, record count, records lost to overwrite) followed
+// by fixed 12-byte records, oldest first.
+class Trace {
+public:
+    static constexpr uint8_t VERSION = 1;
+    static constexpr uint32_t CAPACITY = TRACE_CAPACITY;
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "Trace capacity must be a power of two");
+
+    enum class Type : uint8_t {
+        AdcSweep = 1,  // values: millivolts of pots 0-2
+        Button = 2,    // arg: 1 pressed, 0 released
+        Mode = 3,      // arg: OperationMode entered
+        NetColor = 4,  // values: red, green, blue on the 11-bit scale; arg: ColorSource
+        NetFade = 5,   // values[0]: fade ms for the NetColor just before
+        NetPower = 6,  // arg: 1 unlocked, 0 locked
+        NetCct = 7,    // values: level, Kelvin, Duv * 10^4 (as int16)
+    };
+
+    enum ColorSource : uint8_t { FromHttp = 0, FromDmx = 1, FromCue = 2, FromPreset = 3 };
+
+    struct Record {
+        uint32_t timeMicros;
+        uint8_t type;
+        uint8_t arg;
+        uint16_t values[3];
+    };
+    static_assert(sizeof(Record) == 12, "Trace records must stay 12 bytes");
+
+    // Safe from any task; a call is a fetch_add and a 12-byte copy
+    static void record(Type type, uint8_t arg, uint16_t v0 = 0, uint16_t v1 = 0, uint16_t v2 = 0) {
+        recordAt(Hal::nowMicros(), type, arg, v0, v1, v2);
+    }
+    // For events timestamped earlier, such as button edges taken in an ISR
+    static void recordAt(uint32_t timeMicros, Type type, uint8_t arg, uint16_t v0 = 0, uint16_t v1 = 0,
+                         uint16_t v2 = 0);
+
+    // Writes header and records. Recording pauses for the duration
+    static void dump(Print &out);
+    // Same content as hex lines between TRACE BEGIN / TRACE END markers, for
+    // capture from a serial terminal that also shows log output. Blocks the
+    // caller while the console drains (a full ring is about 4 s at 115200)
+    static void dumpHex(Print &out);
+    static void clear();
+
+private:
+    static Record ring[CAPACITY];
+    static std::atomic<uint32_t> head;
+    static std::atomic<bool> paused;
+    static std::atomic<uint32_t> writers;
+
+    static void pause();
+    static void resume();
+    static void buildHeader(uint8_t header[16], uint32_t count, uint32_t lost);
+};
+
+#endif
@@ -0,0 +1,153 @@
+#ifndef TRANSITION_H
+#define TRANSITION_H
+
+#include "Platform.h"
+
+enum class Easing : uint8_t {
+    Linear,
+    EaseIn,
+    EaseOut,
+    EaseInOut,
+};
+
+// One step of a sequence: fade to this color over durationMs, then hold for holdMs
+struct Keyframe {
+    uint16_t red;   // 11-bit input levels, same scale as setPWMDirectly
+    uint16_t green;
+    uint16_t blue;
+    uint16_t durationMs;
+    uint16_t holdMs;
+    Easing easing;
+};
+
+// Fixed-rate software interpolator. Time is always passed in, so the
+// engine has no clock of its own and can be stepped with a fake one.
+// Progress and easing are Q16 integer math; no floats on the FPU-less C3.
+class TransitionEngine {
+public:
+    static constexpr int CHANNELS = 3;
+    static constexpr int MAX_KEYFRAMES = 16;
+
+    void fadeTo(const int from[CHANNELS], const int to[CHANNELS], uint32_t durationMs, Easing easing, unsigned long nowMs) {
+        sequenceLength = 0;
+        startSegment(from, to, durationMs, 0, easing, nowMs);
+    }
+
+    // Plays frames in order starting from the current levels; repeats if loop is set
+    bool playSequence(const int from[CHANNELS], const Keyframe* frames, int count, bool loop, unsigned long nowMs) {
+        if (count <= 0 || count > MAX_KEYFRAMES) {
+            return false;
+        }
+        for (int i = 0; i < count; i++) {
+            sequence[i] = frames[i];
+        }
+        sequenceLength = count;
+        sequenceIndex = 0;
+        loopSequence = loop;
+        startKeyframe(from, nowMs);
+        return true;
+    }
+
+    void cancel() {
+        active = false;
+        sequenceLength = 0;
+    }
+
+    bool isActive() const { return active; }
+
+    // Writes the levels for nowMs into out. Returns false once nothing is running
+    bool sample(unsigned long nowMs, int out[CHANNELS]) {
+        if (!active) {
+            return false;
+        }
+        uint32_t elapsed = nowMs - segmentStart;
+        if (elapsed >= durationMs) {
+            for (int i = 0; i < CHANNELS; i++) {
+                out[i] = target[i];
+            }
+            if (elapsed >= durationMs + holdMs && !advance(out, segmentStart + durationMs + holdMs)) {
+                active = false;
+            }
+            return true;
+        }
+        uint32_t progress = ease((static_cast<uint64_t>(elapsed) << 16) / durationMs, easing);
+        for (int i = 0; i < CHANNELS; i++) {
+            int32_t delta = target[i] - start[i];
+            out[i] = start[i] + static_cast<int32_t>((static_cast<int64_t>(delta) * progress) >> 16);
+        }
+        return true;
+    }
+
+    // Maps linear progress p (Q16, 0-65536) through the easing curve
+    static uint32_t ease(uint32_t p, Easing easing) {
+        const uint32_t one = 1UL << 16;
+        switch (easing) {
+        case Easing::EaseIn:
+            return static_cast<uint32_t>((static_cast<uint64_t>(p) * p) >> 16);
+        case Easing::EaseOut: {
+            uint32_t inverse = one - p;
+            return one - static_cast<uint32_t>((static_cast<uint64_t>(inverse) * inverse) >> 16);
+        }
+        case Easing::EaseInOut: {
+            // Smoothstep: 3p^2 - 2p^3
+            uint64_t p2 = (static_cast<uint64_t>(p) * p) >> 16;
+            uint64_t p3 = (p2 * p) >> 16;
+            return static_cast<uint32_t>(3 * p2 - 2 * p3);
+        }
+        case Easing::Linear:
+        default:
+            return p;
+        }
+    }
+
+private:
+    int start[CHANNELS] = {0};
+    int target[CHANNELS] = {0};
+    unsigned long segmentStart = 0;
+    uint32_t durationMs = 0;
+    uint32_t holdMs = 0;
+    Easing easing = Easing::Linear;
+    bool active = false;
+
+    Keyframe sequence[MAX_KEYFRAMES];
+    int sequenceLength = 0;
+    int sequenceIndex = 0;
+    bool loopSequence = false;
+
+    void startSegment(const int from[CHANNELS], const int to[CHANNELS], uint32_t duration, uint32_t hold, Easing curve, unsigned long nowMs) {
+        for (int i = 0; i < CHANNELS; i++) {
+            start[i] = from[i];
+            target[i] = to[i];
+        }
+        segmentStart = nowMs;
+        durationMs = duration;
+        holdMs = hold;
+        easing = curve;
+        active = true;
+    }
+
+    void startKeyframe(const int from[CHANNELS], unsigned long nowMs) {
+        const Keyframe& frame = sequence[sequenceIndex];
+        const int to[CHANNELS] = {frame.red, frame.green, frame.blue};
+        startSegment(from, to, frame.durationMs, frame.holdMs, frame.easing, nowMs);
+    }
+
+    // Moves to the next keyframe, starting it at segmentEnd so sequences don't drift
+    bool advance(const int current[CHANNELS], unsigned long segmentEnd) {
+        if (sequenceLength == 0) {
+            return false;
+        }
+        sequenceIndex++;
+        if (sequenceIndex >= sequenceLength) {
+            if (!loopSequence) {
+                sequenceLength = 0;
+                return false;
+            }
+            sequenceIndex = 0;
+        }
+        startKeyframe(current, segmentEnd);
+        return true;
+    }
+};
+
+#endif
@@ -1,205 +1,1046 @@
 #include <WiFi.h>
 #include <ESPAsyncWebServer.h>
 #include <AsyncTCP.h>
-#include <SPIFFS.h>
 #include "LEDController.h"
 #include <ESPmDNS.h>
+#include "ControlMailbox.h"
+#include "DmxReceiver.h"
+#include "CueSync.h"
+#include "ColorEngine.h"
+#include "Settings.h"
+#include "PresetBank.h"
+#include "WebAssets.h"
+#include "Log.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "ControlRequest.h"
+#include "Hal.h"
 
 class WiFiManager
 {
 private:
     AsyncWebServer server;
+    AsyncWebSocket ws;
     LEDController &ledController;
+    SettingsStore &settings;
+    ColorEngine &colorEngine;
+    PresetBank &presets;
     const char *ssid = "Color_Shadow";
     const char *password = "password";
     unsigned long lastUpdate = 0;
     const unsigned long MIN_UPDATE_INTERVAL = 5;
+    bool routesRegistered = false;
 
-    void handleRoot(AsyncWebServerRequest *request)
+    // Handlers run on the AsyncTCP task and only publish here; update() drains
+    // it on the control loop, which is the only place LED state is written
+    ControlMailbox mailbox;
+
+    // E1.31 / Art-Net input while the access point is up
+    DmxReceiver dmx;
+
+    // Shared clock with other lamps and cues fired against it
+    CueSync cueSync;
+
+    // Preformatted bodies for the control routes, sent from flash without a String copy
+    static constexpr const char *OK_BODY = "OK";
+    static constexpr const char *UNLOCKED_BODY = "{\"unlocked\":true}";
+    static constexpr const char *LOCKED_BODY = "{\"unlocked\":false}";
+    static constexpr const char *BAD_COLOR_BODY = "Expected r,g,b[,t]";
+    static constexpr const char *BAD_SEQUENCE_BODY = "Expected r,g,b,fade[,hold];...[;loop]";
+    static constexpr const char *BAD_PRESETS_BODY = "Bad preset table";
+    static constexpr const char *BAD_RECALL_BODY = "No such preset";
+
+    static void sendStatic(AsyncWebServerRequest *request, int code, const char *contentType, const char *body)
+    {
+        request->send(request->beginResponse_P(code, contentType, reinterpret_cast<const uint8_t *>(body), strlen(body)));
+    }
+
+    // /postRGB, /sequence, /presets and /recall bodies are parsed in the body callback, before the
+    // request handler runs. The verdict is parked here by request pointer, so
+    // the handler can answer without any per-request allocation
+    enum class BodyVerdict : uint8_t { None, Applied, Rejected };
+    struct ParsedBody
+    {
+        const AsyncWebServerRequest *request = nullptr;
+        BodyVerdict verdict = BodyVerdict::None;
+    };
+    static constexpr int MAX_PARSED_BODIES = 4;
+    ParsedBody parsedBodies[MAX_PARSED_BODIES];
+
+    // Runs on the AsyncTCP task for every chunk of a /postRGB body. Control
+    // bodies are a few dozen bytes, so they only count when they arrive whole
+    void handleColorBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
     {
-        Serial.println("Serving index.html");
-        request->send(SPIFFS, "/index.html", "text/html");
+        BodyVerdict verdict = BodyVerdict::Rejected;
+        {
+            Metrics::ScopedRequest timer(Metrics::Route::PostRgb);
+            ColorRequest color;
+            if (index == 0 && len == total && parseColorRequest(data, len, color))
+            {
+                LOG_DEBUG("[WiFi] Received RGB: %d,%d,%d\n", color.red, color.green, color.blue);
+                // Applied by the control loop on its next tick
+                mailbox.publishColor(map(color.red, 0, 255, 0, 2047), map(color.green, 0, 255, 0, 2047),
+                                     map(color.blue, 0, 255, 0, 2047), color.fadeMs);
+                verdict = BodyVerdict::Applied;
+            }
+        }
+        parkBodyVerdict(request, verdict);
+    }
+
+    // /sequence bodies are a few keyframes of text, parsed whole like /postRGB
+    // into a member rather than the AsyncTCP task's stack
+    SequenceRequest sequenceStaging;
+
+    void handleSequenceBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+    {
+        BodyVerdict verdict = BodyVerdict::Rejected;
+        {
+            Metrics::ScopedRequest timer(Metrics::Route::Sequence);
+            if (index == 0 && len == total && parseSequenceRequest(data, len, sequenceStaging))
+            {
+                LOG_DEBUG("[WiFi] Received sequence of %d keyframes\n", sequenceStaging.count);
+                mailbox.publishSequence(sequenceStaging);
+                verdict = BodyVerdict::Applied;
+            }
+        }
+        parkBodyVerdict(request, verdict);
+    }
+
+    void parkBodyVerdict(const AsyncWebServerRequest *request, BodyVerdict verdict)
+    {
+        // Reuse a slot left by a dropped connection once all are taken
+        ParsedBody *slot = &parsedBodies[0];
+        for (ParsedBody &candidate : parsedBodies)
+        {
+            if (candidate.request == nullptr || candidate.request == request)
+            {
+                slot = &candidate;
+                break;
+            }
+        }
+        slot->request = request;
+        slot->verdict = verdict;
+    }
+
+    BodyVerdict takeBodyVerdict(const AsyncWebServerRequest *request)
+    {
+        for (ParsedBody &slot : parsedBodies)
+        {
+            if (slot.request == request)
+            {
+                slot.request = nullptr;
+                return slot.verdict;
+            }
+        }
+        return BodyVerdict::None;
+    }
+
+    void handleColorRequest(AsyncWebServerRequest *request)
+    {
+        switch (takeBodyVerdict(request))
+        {
+        case BodyVerdict::Applied:
+            sendStatic(request, 200, "text/plain", OK_BODY);
+            return;
+        case BodyVerdict::Rejected:
+            sendStatic(request, 400, "text/plain", BAD_COLOR_BODY);
+            return;
+        case BodyVerdict::None:
+            break;
+        }
+
+        // Form-encoded bodies are consumed by the server's own parameter
+        // parser and never reach the body callback. Kept for older clients;
+        // this path allocates Strings
+        Metrics::ScopedTimer timer(Metrics::route(Metrics::Route::PostRgb));
+        auto param = [request](const char *name) -> const char * {
+            return request->hasParam(name, true) ? request->getParam(name, true)->value().c_str() : nullptr;
+        };
+        ColorRequest color;
+        if (!parseColorForm(param("r"), param("g"), param("b"), param("t"), color))
+        {
+            sendStatic(request, 400, "text/plain", BAD_COLOR_BODY);
+            return;
+        }
+        mailbox.publishColor(map(color.red, 0, 255, 0, 2047), map(color.green, 0, 255, 0, 2047),
+                             map(color.blue, 0, 255, 0, 2047), color.fadeMs);
+        sendStatic(request, 200, "text/plain", OK_BODY);
+    }
+
+    void handleSequence(AsyncWebServerRequest *request)
+    {
+        answerBodyVerdict(request, BAD_SEQUENCE_BODY);
+    }
+
+    void answerBodyVerdict(AsyncWebServerRequest *request, const char *badBody)
+    {
+        if (takeBodyVerdict(request) == BodyVerdict::Applied)
+        {
+            sendStatic(request, 200, "text/plain", OK_BODY);
+        }
+        else
+        {
+            sendStatic(request, 400, "text/plain", badBody);
+        }
+    }
+
+    // A /presets upload is a raw PresetTable (see PresetBank.h) and may arrive
+    // in several chunks. One upload is staged at a time: a newer one takes the
+    // buffer over (so a dropped connection can't hold it), and the older one's
+    // remaining chunks are ignored and answered with 400, never mixed in
+    PresetTable uploadStaging;
+    const AsyncWebServerRequest *uploadOwner = nullptr;
+
+    void handlePresetsBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+    {
+        Metrics::ScopedRequest timer(Metrics::Route::Presets);
+        if (index == 0)
+        {
+            uploadOwner = request;
+        }
+        if (request != uploadOwner)
+        {
+            return;
+        }
+        if (total != sizeof(PresetTable) || index + len > total)
+        {
+            uploadOwner = nullptr;
+            parkBodyVerdict(request, BodyVerdict::Rejected);
+            return;
+        }
+        memcpy(reinterpret_cast<uint8_t *>(&uploadStaging) + index, data, len);
+        if (index + len < total)
+        {
+            return;
+        }
+        uploadOwner = nullptr;
+        if (!PresetBank::isValid(uploadStaging))
+        {
+            parkBodyVerdict(request, BodyVerdict::Rejected);
+            return;
+        }
+        presets.replace(uploadStaging);
+        LOG_INFO("Preset bank replaced\n");
+        parkBodyVerdict(request, BodyVerdict::Applied);
     }
 
-    void handleIroMin(AsyncWebServerRequest *request)
+    // GET downloads the whole bank as a binary PresetTable; POST with the same
+    // layout as an application/octet-stream body replaces it in one request
+    void handlePresets(AsyncWebServerRequest *request)
     {
-        Serial.println("Serving iro.min.js");
-        AsyncWebServerResponse *response = request->beginResponse(SPIFFS, "/iro.min.js", "text/javascript");
-        response->addHeader("Cache-Control", "max-age=31536000");
-        response->addHeader("Expires", "Thu, 31 Dec 2037 23:59:59 GMT");
+        if (request->method() == HTTP_POST)
+        {
+            if (takeBodyVerdict(request) == BodyVerdict::Applied)
+            {
+                sendStatic(request, 200, "text/plain", OK_BODY);
+            }
+            else
+            {
+                sendStatic(request, 400, "text/plain", BAD_PRESETS_BODY);
+            }
+            return;
+        }
+        Metrics::ScopedTimer timer(Metrics::route(Metrics::Route::Presets));
+        PresetTable table = presets.snapshot();
+        AsyncResponseStream *response = request->beginResponseStream("application/octet-stream");
+        response->write(reinterpret_cast<const uint8_t *>(&table), sizeof(table));
         request->send(response);
     }
 
-    void handleIroScript(AsyncWebServerRequest *request)
+    // The body is the preset index as text/plain, e.g. "3", parsed in place
+    // like /postRGB; the preset applies on the next control tick. The
+    // WebSocket takes a one-byte frame for the same thing
+    void handleRecallBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+    {
+        BodyVerdict verdict = BodyVerdict::Rejected;
+        {
+            Metrics::ScopedRequest timer(Metrics::Route::Recall);
+            uint32_t preset;
+            if (index == 0 && len == total && parseRecallRequest(data, len, preset) && preset < PresetTable::COUNT)
+            {
+                mailbox.publishRecall(preset);
+                verdict = BodyVerdict::Applied;
+            }
+        }
+        parkBodyVerdict(request, verdict);
+    }
+
+    void handleRecall(AsyncWebServerRequest *request)
     {
-        Serial.println("Serving iro_script.js");
-        request->send(SPIFFS, "/iro_script.js", "text/javascript");
+        answerBodyVerdict(request, BAD_RECALL_BODY);
+    }
+
+    // UI files are embedded pre-gzipped in flash (see scripts/embed_assets.py)
+    // and streamed straight from there. Clients revalidate with If-None-Match
+    void handleAsset(AsyncWebServerRequest *request, const WebAsset &asset)
+    {
+        Metrics::ScopedTimer timer(Metrics::route(Metrics::Route::Asset));
+        if (request->hasHeader("If-None-Match") && request->getHeader("If-None-Match")->value() == asset.etag)
+        {
+            AsyncWebServerResponse *notModified = request->beginResponse(304);
+            notModified->addHeader("ETag", asset.etag);
+            notModified->addHeader("Cache-Control", asset.cacheControl);
+            request->send(notModified);
+            return;
+        }
+        LOG_DEBUG("Serving %s\n", asset.path);
+        AsyncWebServerResponse *response = request->beginResponse_P(200, asset.contentType, asset.data, asset.length);
+        response->addHeader("Content-Encoding", "gzip");
+        response->addHeader("ETag", asset.etag);
+        response->addHeader("Cache-Control", asset.cacheControl);
+        request->send(response);
     }
 
     void handleLockStatus(AsyncWebServerRequest *request)
     {
-        Serial.println("Lock status requested");
-        bool isUnlocked = ledController.isUnlocked();
-        Serial.printf("Current lock status: %s\n", isUnlocked ? "unlocked" : "locked");
-        String response = isUnlocked ? "{\"unlocked\":true}" : "{\"unlocked\":false}";
-        request->send(200, "application/json", response);
+        Metrics::ScopedTimer timer(Metrics::route(Metrics::Route::LockStatus));
+        LOG_DEBUG("Lock status requested\n");
+        // Until the control loop has applied the last /unlock or /reset, report
+        // the request so a poll right after it doesn't read the old profile.
+        // After that the governor is the truth, whatever else changed it since
+        const ControlState &requested = mailbox.lastPublished();
+        bool isUnlocked = mailbox.isApplied(requested.powerSeq) ? ledController.isUnlocked() : requested.unlocked;
+        LOG_DEBUG("Current lock status: %s\n", isUnlocked ? "unlocked" : "locked");
+        sendStatic(request, 200, "application/json", isUnlocked ? UNLOCKED_BODY : LOCKED_BODY);
     }
 
     void handleUnlock(AsyncWebServerRequest *request)
     {
-        Serial.println("Unlock requested");
-        ledController.unlock();
-        ledController.checkAndUpdatePowerLimit();
-        Serial.println("Unlock complete");
-        request->send(200, "text/plain", "OK");
+        Metrics::ScopedTimer timer(Metrics::route(Metrics::Route::Unlock));
+        LOG_INFO("Unlock requested\n");
+        mailbox.publishPowerProfile(true);
+        sendStatic(request, 200, "text/plain", OK_BODY);
     }
 
     void handleReset(AsyncWebServerRequest *request)
     {
-        Serial.println("Reset requested");
-        ledController.resetToSafeMode();
-        ledController.checkAndUpdatePowerLimit();
-        Serial.println("Reset complete");
-        request->send(200, "text/plain", "OK");
+        Metrics::ScopedTimer timer(Metrics::route(Metrics::Route::Reset));
+        LOG_INFO("Reset requested\n");
+        mailbox.publishPowerProfile(false);
+        sendStatic(request, 200, "text/plain", OK_BODY);
     }
 
-    void handleRGB(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+    // Prometheus text by default, JSON with ?format=json
+    void handleMetrics(AsyncWebServerRequest *request)
     {
-        if (request->hasParam("r", true) && request->hasParam("g", true) && request->hasParam("b", true))
+        Metrics::ScopedTimer timer(Metrics::route(Metrics::Route::Metrics));
+        bool json = request->hasParam("format") && request->getParam("format")->value() == "json";
+        AsyncResponseStream *response = request->beginResponseStream(json ? "application/json" : "text/plain; version=0.0.4");
+        if (json)
         {
-            int r = request->getParam("r", true)->value().toInt();
-            int g = request->getParam("g", true)->value().toInt();
-            int b = request->getParam("b", true)->value().toInt();
-
-            // Debug print
-            Serial.printf("Received RGB request: r=%d, g=%d, b=%d\n", r, g, b);
-
-            int mappedR = map(constrain(r, 0, 255), 0, 255, 0, 2047);
-            int mappedG = map(constrain(g, 0, 255), 0, 255, 0, 2047);
-            int mappedB = map(constrain(b, 0, 255), 0, 255, 0, 2047);
+            Metrics::writeJson(*response);
+        }
+        else
+        {
+            Metrics::writePrometheus(*response);
+        }
+        request->send(response);
+    }
 
-            Serial.printf("Mapped RGB values: r=%d, g=%d, b=%d\n", mappedR, mappedG, mappedB);
+    // GET reports the DMX patch, POST with u (universe) and/or a (1-based start
+    // address) repatches it; the control loop applies and saves the change
+    void handleDmxConfig(AsyncWebServerRequest *request)
+    {
+        Metrics::ScopedTimer timer(Metrics::route(Metrics::Route::DmxConfig));
+        const ControlState &requested = mailbox.lastPublished();
+        uint16_t universe = requested.dmxSeq != 0 ? requested.dmxUniverse : settings.get().dmxUniverse;
+        uint16_t startAddress = requested.dmxSeq != 0 ? requested.dmxStartAddress : settings.get().dmxStartAddress;
+        if (request->method() == HTTP_POST)
+        {
+            if (request->hasParam("u", true))
+            {
+                universe = constrain(request->getParam("u", true)->value().toInt(), 0, 63999);
+            }
+            if (request->hasParam("a", true))
+            {
+                startAddress = constrain(request->getParam("a", true)->value().toInt(), 1, 512 - DmxReceiver::CHANNELS + 1);
+            }
+            mailbox.publishDmxPatch(universe, startAddress);
+        }
+        char body[48];
+        snprintf(body, sizeof(body), "{\"universe\":%u,\"address\":%u}", universe, startAddress);
+        request->send(200, "application/json", body);
+    }
 
-            ledController.setPWMDirectly(mappedR, mappedG, mappedB);
-            request->send(200, "text/plain", "OK");
+    // GET reports the pot dead-band per channel. POST with c (0-2, or omitted
+    // for all three) and any of n (noise threshold), m (minimum threshold) and
+    // i (idle ms before falling back to n) retunes it; the control loop
+    // applies and saves the change
+    void handleHysteresis(AsyncWebServerRequest *request)
+    {
+        Metrics::ScopedTimer timer(Metrics::route(Metrics::Route::Hysteresis));
+        const ControlPayload &requested = mailbox.lastPublishedPayload();
+        HysteresisConfig configs[3];
+        for (int i = 0; i < 3; i++)
+        {
+            configs[i] = requested.hysteresisSeq != 0 ? requested.hysteresis[i] : settings.get().hysteresis[i];
         }
-        else
+        if (request->method() == HTTP_POST)
+        {
+            int first = 0;
+            int last = 2;
+            if (request->hasParam("c", true))
+            {
+                first = last = constrain(request->getParam("c", true)->value().toInt(), 0, 2);
+            }
+            for (int i = first; i <= last; i++)
+            {
+                HysteresisConfig &config = configs[i];
+                if (request->hasParam("n", true))
+                {
+                    config.noiseThreshold = constrain(request->getParam("n", true)->value().toInt(), 0, 2047);
+                }
+                if (request->hasParam("m", true))
+                {
+                    config.minThreshold = constrain(request->getParam("m", true)->value().toInt(), 0, 2047);
+                }
+                if (request->hasParam("i", true))
+                {
+                    config.idleTimeThreshold = constrain(request->getParam("i", true)->value().toInt(), 0, 3600000);
+                }
+                // The sensitive band can't be wider than the noise band it relaxes from
+                if (config.minThreshold > config.noiseThreshold)
+                {
+                    config.minThreshold = config.noiseThreshold;
+                }
+            }
+            mailbox.publishHysteresis(configs);
+        }
+        AsyncResponseStream *response = request->beginResponseStream("application/json");
+        response->printf("{\"channels\":[");
+        for (int i = 0; i < 3; i++)
         {
-            Serial.println("Invalid RGB parameters received");
-            request->send(400, "text/plain", "Bad Request");
+            response->printf(i == 0 ? "{\"n\":%d,\"m\":%d,\"i\":%lu}" : ",{\"n\":%d,\"m\":%d,\"i\":%lu}",
+                             configs[i].noiseThreshold, configs[i].minThreshold, configs[i].idleTimeThreshold);
         }
+        response->printf("]}");
+        request->send(response);
     }
 
-public:
-    WiFiManager(LEDController &controller) : server(80), ledController(controller) {}
+    // GET reports the stored and the running network role. POST with
+    // r=leader or r=follower stores a new one; the control loop saves it and
+    // restarts the network in that role
+    void handleRole(AsyncWebServerRequest *request)
+    {
+        Metrics::ScopedTimer timer(Metrics::route(Metrics::Route::Role));
+        const ControlState &requested = mailbox.lastPublished();
+        NetworkRole stored = requested.roleSeq != 0 ? static_cast<NetworkRole>(requested.networkRole)
+                                                    : settings.get().networkRole;
+        if (request->method() == HTTP_POST)
+        {
+            if (!request->hasParam("r", true))
+            {
+                request->send(400, "text/plain", "Expected r=leader or r=follower");
+                return;
+            }
+            const String &value = request->getParam("r", true)->value();
+            if (value != "leader" && value != "follower")
+            {
+                request->send(400, "text/plain", "Expected r=leader or r=follower");
+                return;
+            }
+            stored = value == "follower" ? NetworkRole::Follower : NetworkRole::Leader;
+            mailbox.publishNetworkRole(static_cast<uint8_t>(stored));
+        }
+        char body[64];
+        snprintf(body, sizeof(body), "{\"role\":\"%s\",\"active\":\"%s\"}", roleName(stored), roleName(activeRole));
+        request->send(200, "application/json", body);
+    }
 
-    void begin()
+    static const char *roleName(NetworkRole role)
     {
-        if (!SPIFFS.begin(true))
+        return role == NetworkRole::Follower ? "follower" : "leader";
+    }
+
+    // GET reports the shared clock; POST with ref=<ip> follows another lamp's
+    // clock, and ref=0.0.0.0 makes this lamp the reference
+    void handleSync(AsyncWebServerRequest *request)
+    {
+        Metrics::ScopedTimer timer(Metrics::route(Metrics::Route::Sync));
+        if (request->method() == HTTP_POST && request->hasParam("ref", true))
         {
-            Serial.println("SPIFFS Mount Failed");
+            IPAddress reference;
+            if (!reference.fromString(request->getParam("ref", true)->value()))
+            {
+                request->send(400, "text/plain", "Bad reference address");
+                return;
+            }
+            cueSync.setReference(reference);
+        }
+        char body[128];
+        snprintf(body, sizeof(body), "{\"now\":%lu,\"offsetUs\":%lld,\"delayUs\":%lld,\"ref\":\"%s\"}",
+                 (unsigned long)cueSync.sharedMillis(), (long long)cueSync.getOffsetMicros(),
+                 (long long)cueSync.getDelayMicros(), cueSync.getReference().toString().c_str());
+        request->send(200, "application/json", body);
+    }
+
+    // Schedules r, g, b (0-255) with optional fade t (ms) at shared time at (ms)
+    void handleCue(AsyncWebServerRequest *request)
+    {
+        Metrics::ScopedTimer timer(Metrics::route(Metrics::Route::Cue));
+        if (!request->hasParam("r", true) || !request->hasParam("g", true) || !request->hasParam("b", true) ||
+            !request->hasParam("at", true))
+        {
+            request->send(400, "text/plain", "Missing parameters");
             return;
         }
+        Cue cue;
+        cue.atMs = strtoul(request->getParam("at", true)->value().c_str(), nullptr, 10);
+        cue.red = map(constrain(request->getParam("r", true)->value().toInt(), 0, 255), 0, 255, 0, 2047);
+        cue.green = map(constrain(request->getParam("g", true)->value().toInt(), 0, 255), 0, 255, 0, 2047);
+        cue.blue = map(constrain(request->getParam("b", true)->value().toInt(), 0, 255), 0, 255, 0, 2047);
+        if (request->hasParam("t", true))
+        {
+            cue.fadeMs = constrain(request->getParam("t", true)->value().toInt(), 0, 65535);
+        }
+        if (!cueSync.scheduleCue(cue))
+        {
+            request->send(503, "text/plain", "Cue queue full");
+            return;
+        }
+        request->send(200, "text/plain", "OK");
+    }
 
-        // 1. Register WiFi event handler FIRST
-        WiFi.onEvent([](WiFiEvent_t event, WiFiEventInfo_t info)
-                     { Serial.printf("[WiFi] Event: %d\n", event); });
+    // Color temperature through the color engine: k (Kelvin), l (0-2047
+    // lightness) and optional duv (Duv * 10^4)
+    void handleCct(AsyncWebServerRequest *request)
+    {
+        Metrics::ScopedTimer timer(Metrics::route(Metrics::Route::PostCct));
+        if (!request->hasParam("k", true) || !request->hasParam("l", true))
+        {
+            request->send(400, "text/plain", "Missing parameters");
+            return;
+        }
+        int kelvin = constrain(request->getParam("k", true)->value().toInt(), ColorEngine::MIN_KELVIN, ColorEngine::MAX_KELVIN);
+        int level = constrain(request->getParam("l", true)->value().toInt(), 0, 2047);
+        int duv = 0;
+        if (request->hasParam("duv", true))
+        {
+            duv = constrain(request->getParam("duv", true)->value().toInt(), -ColorEngine::MAX_DUV, ColorEngine::MAX_DUV);
+        }
+        mailbox.publishCct(level, kelvin, duv);
+        request->send(200, "text/plain", "OK");
+    }
 
-        // Disable WiFi power save for better responsiveness
-        WiFi.setSleep(false);
-        WiFi.setTxPower(WIFI_POWER_19_5dBm);
+    // GET returns the XYZ-to-channel matrix; POST m=<9 comma-separated
+    // values, row-major> stores a measured one for this lamp
+    void handleCalibration(AsyncWebServerRequest *request)
+    {
+        Metrics::ScopedTimer timer(Metrics::route(Metrics::Route::Calibration));
+        if (request->method() == HTTP_POST)
+        {
+            if (!request->hasParam("m", true))
+            {
+                request->send(400, "text/plain", "Missing parameters");
+                return;
+            }
+            int32_t matrix[9];
+            const char *cursor = request->getParam("m", true)->value().c_str();
+            for (int i = 0; i < 9; i++)
+            {
+                char *end;
+                float value = strtof(cursor, &end);
+                if (end == cursor || (i < 8 && *end != ','))
+                {
+                    request->send(400, "text/plain", "Matrix needs 9 values");
+                    return;
+                }
+                matrix[i] = static_cast<int32_t>(value * LOCUS_ONE);
+                cursor = end + 1;
+            }
+            mailbox.publishCalibration(matrix);
+            request->send(200, "text/plain", "OK");
+            return;
+        }
+        const ControlPayload &requested = mailbox.lastPublishedPayload();
+        const int32_t *matrix = requested.calibrationSeq != 0 ? requested.calibration : colorEngine.getMatrix().m;
+        AsyncResponseStream *response = request->beginResponseStream("application/json");
+        response->printf("{\"matrix\":[");
+        for (int i = 0; i < 9; i++)
+        {
+            response->printf(i == 0 ? "%.5f" : ",%.5f", matrix[i] / static_cast<double>(LOCUS_ONE));
+        }
+        response->printf("]}");
+        request->send(response);
+    }
 
-        // Start AP before server
-        WiFi.softAPdisconnect(true);
-        delay(100);
-        WiFi.softAP(ssid, password);
-        delay(500); // Crucial for AP stabilization
+    // Binary input trace (format in Trace.h); ?clear=1 empties the ring afterwards
+    void handleTrace(AsyncWebServerRequest *request)
+    {
+        Metrics::ScopedTimer timer(Metrics::route(Metrics::Route::Trace));
+        AsyncResponseStream *response = request->beginResponseStream("application/octet-stream");
+        response->addHeader("Content-Disposition", "attachment; filename=\"lamp.trace\"");
+        Trace::dump(*response);
+        if (request->hasParam("clear"))
+        {
+            Trace::clear();
+        }
+        request->send(response);
+    }
 
-        // Verify AP IP
-        IPAddress apIP = WiFi.softAPIP();
-        if (apIP == IPAddress(0, 0, 0, 0))
+    // Binary frames are [r, g, b] (0-255), optionally followed by a sequence byte
+    // and then a little-endian 16-bit fade time in ms. A nonzero sequence byte
+    // is echoed straight back so clients can measure round trips. A one-byte
+    // frame recalls that preset
+    void handleWebSocketEvent(AsyncWebSocket * /*socket*/, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len)
+    {
+        if (type != WS_EVT_DATA)
+        {
+            return;
+        }
+        Metrics::ScopedRequest timer(Metrics::Route::WebSocket);
+        AwsFrameInfo *info = static_cast<AwsFrameInfo *>(arg);
+        if (info->opcode != WS_BINARY || !info->final || info->index != 0 || (len != 1 && len != 3 && len != 4 && len != 6))
         {
-            Serial.println("AP Failed - Rebooting");
-            ESP.restart();
+            return;
         }
+        if (len == 1)
+        {
+            if (data[0] < PresetTable::COUNT)
+            {
+                mailbox.publishRecall(data[0]);
+            }
+            return;
+        }
+        uint16_t fadeMs = len == 6 ? data[4] | (data[5] << 8) : 0;
+        mailbox.publishColor(map(data[0], 0, 255, 0, 2047),
+                             map(data[1], 0, 255, 0, 2047),
+                             map(data[2], 0, 255, 0, 2047),
+                             fadeMs);
+        if (len >= 4 && data[3] != 0)
+        {
+            client->binary(&data[3], 1);
+        }
+    }
 
-        // mDNS setup after AP is confirmed working
-        if (MDNS.begin("colorshadow")) {
-            Serial.println("MDNS responder started");
-            MDNS.addService("http", "tcp", 80);
+    // Routes and handlers are registered once; the server keeps them across WiFi restarts
+    void registerRoutes()
+    {
+        if (routesRegistered)
+        {
+            return;
         }
+        routesRegistered = true;
 
-        
         DefaultHeaders::Instance().addHeader("Access-Control-Allow-Origin", "*");
         DefaultHeaders::Instance().addHeader("Access-Control-Allow-Methods", "GET, POST, PUT");
         DefaultHeaders::Instance().addHeader("Access-Control-Allow-Headers", "Content-Type");
 
-        server.on("/", HTTP_GET, std::bind(&WiFiManager::handleRoot, this, std::placeholders::_1));
-        server.on("/iro.min.js", HTTP_GET, std::bind(&WiFiManager::handleIroMin, this, std::placeholders::_1));
-        server.on("/iro_script.js", HTTP_GET, std::bind(&WiFiManager::handleIroScript, this, std::placeholders::_1));
+        for (size_t i = 0; i < WEB_ASSET_COUNT; i++)
+        {
+            const WebAsset &asset = WEB_ASSETS[i];
+            server.on(asset.path, HTTP_GET, [this, &asset](AsyncWebServerRequest *request)
+                      { handleAsset(request, asset); });
+        }
         server.on("/lockStatus", HTTP_GET, std::bind(&WiFiManager::handleLockStatus, this, std::placeholders::_1));
         server.on("/unlock", HTTP_POST, std::bind(&WiFiManager::handleUnlock, this, std::placeholders::_1));
         server.on("/reset", HTTP_POST, std::bind(&WiFiManager::handleReset, this, std::placeholders::_1));
+        server.on("/metrics", HTTP_GET, std::bind(&WiFiManager::handleMetrics, this, std::placeholders::_1));
+        server.on("/postCCT", HTTP_POST, std::bind(&WiFiManager::handleCct, this, std::placeholders::_1));
+        server.on("/calibration", HTTP_GET | HTTP_POST, std::bind(&WiFiManager::handleCalibration, this, std::placeholders::_1));
+        server.on("/trace", HTTP_GET, std::bind(&WiFiManager::handleTrace, this, std::placeholders::_1));
+        server.on("/sync", HTTP_GET | HTTP_POST, std::bind(&WiFiManager::handleSync, this, std::placeholders::_1));
+        server.on("/cue", HTTP_POST, std::bind(&WiFiManager::handleCue, this, std::placeholders::_1));
+        server.on("/role", HTTP_GET | HTTP_POST, std::bind(&WiFiManager::handleRole, this, std::placeholders::_1));
+        server.on("/hysteresis", HTTP_GET | HTTP_POST, std::bind(&WiFiManager::handleHysteresis, this, std::placeholders::_1));
+        server.on("/dmxConfig", HTTP_GET | HTTP_POST, std::bind(&WiFiManager::handleDmxConfig, this, std::placeholders::_1));
 
-        // In WiFiManager.h constructor
-        server.on("/postRGB", HTTP_POST, [this](AsyncWebServerRequest *request)
-                  {
-            // Check for all 3 parameters first
-            if(!request->hasParam("r", true) || !request->hasParam("g", true) || !request->hasParam("b", true)) {
-                request->send(400, "text/plain", "Missing parameters");
-                return;
+        // "r,g,b[,t]" as text/plain reaches handleColorBody unparsed; r=&g=&b= form
+        // bodies are decoded by the server and handled in handleColorRequest
+        server.on("/postRGB", HTTP_POST, std::bind(&WiFiManager::handleColorRequest, this, std::placeholders::_1), nullptr,
+                  std::bind(&WiFiManager::handleColorBody, this, std::placeholders::_1, std::placeholders::_2,
+                            std::placeholders::_3, std::placeholders::_4, std::placeholders::_5));
+
+        server.on("/sequence", HTTP_POST, std::bind(&WiFiManager::handleSequence, this, std::placeholders::_1), nullptr,
+                  std::bind(&WiFiManager::handleSequenceBody, this, std::placeholders::_1, std::placeholders::_2,
+                            std::placeholders::_3, std::placeholders::_4, std::placeholders::_5));
+
+        server.on("/presets", HTTP_GET | HTTP_POST, std::bind(&WiFiManager::handlePresets, this, std::placeholders::_1),
+                  nullptr,
+                  std::bind(&WiFiManager::handlePresetsBody, this, std::placeholders::_1, std::placeholders::_2,
+                            std::placeholders::_3, std::placeholders::_4, std::placeholders::_5));
+        server.on("/recall", HTTP_POST, std::bind(&WiFiManager::handleRecall, this, std::placeholders::_1), nullptr,
+                  std::bind(&WiFiManager::handleRecallBody, this, std::placeholders::_1, std::placeholders::_2,
+                            std::placeholders::_3, std::placeholders::_4, std::placeholders::_5));
+
+        server.on("/favicon.ico", HTTP_GET, [](AsyncWebServerRequest *request)
+                  { request->send(404); });
+
+        ws.onEvent(std::bind(&WiFiManager::handleWebSocketEvent, this, std::placeholders::_1, std::placeholders::_2,
+                             std::placeholders::_3, std::placeholders::_4, std::placeholders::_5, std::placeholders::_6));
+        server.addHandler(&ws);
+    }
+
+    // Bring-up and teardown advance one step per update() so the control loop
+    // keeps its cadence; the settle delays become deadlines instead of delay()
+    enum class WiFiState
+    {
+        Stopped,
+        Configure,
+        ApReset,
+        ApStart,
+        StaJoin,
+        ApVerify,
+        Serving,
+        StopServer,
+        StopAp,
+        StopSettle,
+    };
+
+    WiFiState state = WiFiState::Stopped;
+    bool wantRunning = false;
+    unsigned long stepDeadline = 0;
+    unsigned long transitionStart = 0;
+    unsigned long lastStartLatency = 0;
+    unsigned long lastStopLatency = 0;
+
+    // Role the network was brought up in. A follower that finds no leader
+    // within JOIN_TIMEOUT_MS runs its own access point instead, so a lone
+    // lamp stays reachable
+    static constexpr unsigned long JOIN_TIMEOUT_MS = 15000;
+    NetworkRole activeRole = NetworkRole::Leader;
+    unsigned long joinDeadline = 0;
+    bool restartNetwork = false;
+
+    void waitThen(WiFiState next, unsigned long now, unsigned long settleMs)
+    {
+        stepDeadline = now + settleMs;
+        state = next;
+    }
+
+    void step(unsigned long now)
+    {
+        if (state != WiFiState::Stopped && state != WiFiState::Serving &&
+            static_cast<long>(now - stepDeadline) < 0)
+        {
+            return;
+        }
+
+        switch (state)
+        {
+        case WiFiState::Stopped:
+            if (wantRunning)
+            {
+                transitionStart = now;
+                state = WiFiState::Configure;
             }
+            break;
 
-            // Get and constrain values
-            int r = request->getParam("r", true)->value().toInt();
-            int g = request->getParam("g", true)->value().toInt();
-            int b = request->getParam("b", true)->value().toInt();
-            
-            r = constrain(r, 0, 255);
-            g = constrain(g, 0, 255);
-            b = constrain(b, 0, 255);
+        case WiFiState::Configure:
+            // 1. Register WiFi event handler FIRST
+            // event is only read when debug logging is compiled in
+            WiFi.onEvent([]([[maybe_unused]] WiFiEvent_t event, WiFiEventInfo_t /*info*/)
+                         { LOG_DEBUG("[WiFi] Event: %d\n", event); });
 
-            // Convert to 11-bit PWM range (0-2047)
-            int pwm_r = map(r, 0, 255, 0, 2047);
-            int pwm_g = map(g, 0, 255, 0, 2047);
-            int pwm_b = map(b, 0, 255, 0, 2047);
+            // Disable WiFi power save for better responsiveness
+            WiFi.setSleep(false);
+            WiFi.setTxPower(WIFI_POWER_19_5dBm);
+            activeRole = settings.get().networkRole;
+            state = WiFiState::ApReset;
+            break;
 
-            // Debug output
-            Serial.printf("[WiFi] Received RGB: %d,%d,%d -> PWM: %d,%d,%d\n", 
-                        r, g, b, pwm_r, pwm_g, pwm_b);
+        case WiFiState::ApReset:
+            // Start AP before server
+            WiFi.softAPdisconnect(true);
+            waitThen(WiFiState::ApStart, now, 100);
+            break;
 
-            // Set LEDs - account for physical pin swap
-            ledController.setPWMDirectly(pwm_r, pwm_g, pwm_b);
-    
-        request->send(200, "text/plain", "OK"); });
+        case WiFiState::ApStart:
+            if (activeRole == NetworkRole::Follower)
+            {
+                WiFi.mode(WIFI_STA);
+                WiFi.begin(ssid, password);
+                joinDeadline = now + JOIN_TIMEOUT_MS;
+                waitThen(WiFiState::StaJoin, now, 100);
+                break;
+            }
+            WiFi.softAP(ssid, password);
+            waitThen(WiFiState::ApVerify, now, 500); // Crucial for AP stabilization
+            break;
 
-        server.on("/favicon.ico", HTTP_GET, [](AsyncWebServerRequest *request)
-                  { request->send(404); });
+        case WiFiState::StaJoin:
+            if (WiFi.status() == WL_CONNECTED)
+            {
+                state = WiFiState::ApVerify;
+            }
+            else if (static_cast<long>(now - joinDeadline) >= 0)
+            {
+                LOG_WARN("[WiFi] No leader found, starting own access point\n");
+                WiFi.disconnect(true);
+                activeRole = NetworkRole::Leader;
+                waitThen(WiFiState::ApStart, now, 100);
+            }
+            else
+            {
+                waitThen(WiFiState::StaJoin, now, 100);
+            }
+            break;
+
+        case WiFiState::ApVerify:
+        {
+            // Verify AP IP, or the address the leader gave us
+            bool follower = activeRole == NetworkRole::Follower;
+            IPAddress apIP = follower ? WiFi.localIP() : WiFi.softAPIP();
+            if (apIP == IPAddress(0, 0, 0, 0))
+            {
+                // Written directly: the deferred log would not drain before the restart
+                Serial.println("AP Failed - Rebooting");
+                Hal::restart();
+            }
+
+            // mDNS setup after AP is confirmed working. Followers share the
+            // leader's network, so each takes a name of its own
+            char hostname[24] = "colorshadow";
+            if (follower)
+            {
+                uint8_t mac[6];
+                WiFi.macAddress(mac);
+                snprintf(hostname, sizeof(hostname), "colorshadow-%02x%02x", mac[4], mac[5]);
+            }
+            if (MDNS.begin(hostname)) {
+                LOG_INFO("MDNS responder started as %s\n", hostname);
+                MDNS.addService("http", "tcp", 80);
+            }
+
+            registerRoutes();
+
+            try
+            {
+                server.begin();
+                LOG_INFO("Async HTTP server started successfully\n");
+            }
+            catch (...)
+            {
+                LOG_ERROR("Failed to start server - attempting restart\n");
+                Hal::sleepMillis(1000);
+                Hal::restart();
+            }
+            dmx.begin(settings.get().dmxUniverse, settings.get().dmxStartAddress);
+            cueSync.begin();
+            if (follower)
+            {
+                // The leader's access point is our gateway and the shared clock
+                cueSync.setReference(WiFi.gatewayIP());
+            }
+            state = WiFiState::Serving;
+
+            // Resume the last color set over WiFi
+            ledController.setLevels(settings.get().wifiRed, settings.get().wifiGreen, settings.get().wifiBlue);
+
+            lastStartLatency = now - transitionStart;
+            Metrics::wifiStartMillis.set(lastStartLatency);
+            LOG_INFO("WiFi start took %lu ms\n", lastStartLatency);
+            break;
+        }
+
+        case WiFiState::Serving:
+            // A role change restarts the network; wantRunning stays set, so
+            // it comes back up in the new role from Stopped
+            if (!wantRunning || restartNetwork)
+            {
+                restartNetwork = false;
+                transitionStart = now;
+                state = WiFiState::StopServer;
+            }
+            break;
+
+        case WiFiState::StopServer:
+            dmx.stop();
+            cueSync.stop();
+            ws.closeAll();
+            server.end();
+            waitThen(WiFiState::StopAp, now, 100);
+            break;
+
+        case WiFiState::StopAp:
+            if (activeRole == NetworkRole::Follower)
+            {
+                WiFi.disconnect(true);
+            }
+            else
+            {
+                WiFi.softAPdisconnect(true);
+            }
+            waitThen(WiFiState::StopSettle, now, 100);
+            break;
+
+        case WiFiState::StopSettle:
+            state = WiFiState::Stopped;
+            lastStopLatency = now - transitionStart;
+            Metrics::wifiStopMillis.set(lastStopLatency);
+            LOG_INFO("WiFi and server stopped in %lu ms\n", lastStopLatency);
+            break;
+        }
+    }
+
+    // A color to show and remember, from a handler, cue or preset. fadeMs 0 applies it at once
+    void applyColor(Trace::ColorSource source, int red, int green, int blue, uint16_t fadeMs)
+    {
+        Trace::record(Trace::Type::NetColor, source, red, green, blue);
+        if (fadeMs > 0)
+        {
+            Trace::record(Trace::Type::NetFade, 0, fadeMs);
+            ledController.fadeTo(red, green, blue, fadeMs);
+        }
+        else
+        {
+            ledController.setLevels(red, green, blue);
+        }
+        settings.setWifiColor(red, green, blue);
+    }
+
+    // O(1): one slot copy from the RAM bank, no flash access
+    void applyPreset(uint8_t index)
+    {
+        Preset preset;
+        if (!presets.get(index, preset))
+        {
+            LOG_DEBUG("Preset %u is empty\n", index);
+            return;
+        }
+        if (preset.power == PresetPower::Unlocked)
+        {
+            ledController.unlock();
+        }
+        else if (preset.power == PresetPower::Locked)
+        {
+            ledController.resetToSafeMode();
+        }
+        if (preset.kind == PresetKind::Rgb)
+        {
+            applyColor(Trace::FromPreset, preset.values[0], preset.values[1], preset.values[2], preset.fadeMs);
+        }
+        else
+        {
+            int16_t duv = static_cast<int16_t>(preset.values[2]);
+            Trace::record(Trace::Type::NetCct, 0, preset.values[0], preset.values[1], preset.values[2]);
+            uint32_t duties[3];
+            colorEngine.cctToDuties(preset.values[0], preset.values[1], duv, duties);
+            ledController.setLinearDuties(duties);
+        }
+    }
 
-        try
+    void applyPublishedState()
+    {
+        ControlChanges changed;
+        const ControlState &published = mailbox.drain(changed);
+        const ControlPayload &payload = mailbox.payload();
+        // In arrival order, so the newest of a color, a CCT and a recall wins
+        for (int i = 0; i < changed.count; i++)
         {
-            server.begin();
-            Serial.println("Async HTTP server started successfully");
+            switch (changed.order[i])
+            {
+            case ControlGroup::Power:
+                Trace::record(Trace::Type::NetPower, published.unlocked);
+                if (published.unlocked)
+                {
+                    ledController.unlock();
+                }
+                else
+                {
+                    ledController.resetToSafeMode();
+                }
+                LOG_INFO("Power profile applied: %s\n", published.unlocked ? "unlocked" : "locked");
+                break;
+            case ControlGroup::Calibration:
+            {
+                ColorMatrix matrix;
+                memcpy(matrix.m, payload.calibration, sizeof(matrix.m));
+                colorEngine.setMatrix(matrix);
+                LOG_INFO("Color calibration updated\n");
+                break;
+            }
+            case ControlGroup::Recall:
+                applyPreset(published.recallIndex);
+                break;
+            case ControlGroup::Color:
+                applyColor(Trace::FromHttp, published.red, published.green, published.blue, published.fadeMs);
+                break;
+            case ControlGroup::Cct:
+            {
+                Trace::record(Trace::Type::NetCct, 0, published.cctLevel, published.cctKelvin, published.cctDuv);
+                uint32_t duties[3];
+                colorEngine.cctToDuties(published.cctLevel, published.cctKelvin, published.cctDuv, duties);
+                ledController.setLinearDuties(duties);
+                break;
+            }
+            case ControlGroup::Sequence:
+                // Not remembered as the WiFi color; the last keyframe is where it rests
+                ledController.playSequence(payload.keyframes.frames, payload.keyframes.count, payload.keyframes.loop);
+                break;
+            case ControlGroup::Hysteresis:
+                for (int channel = 0; channel < 3; channel++)
+                {
+                    ledController.setHysteresis(channel, payload.hysteresis[channel]);
+                }
+                LOG_INFO("Pot dead-band updated\n");
+                break;
+            case ControlGroup::Role:
+            {
+                NetworkRole role = static_cast<NetworkRole>(published.networkRole);
+                settings.setNetworkRole(role);
+                restartNetwork = role != activeRole;
+                LOG_INFO("Network role set to %s\n", roleName(role));
+                break;
+            }
+            case ControlGroup::Dmx:
+                dmx.configure(published.dmxUniverse, published.dmxStartAddress);
+                settings.setDmxPatch(published.dmxUniverse, published.dmxStartAddress);
+                break;
+            }
+        }
+        mailbox.acknowledge();
+        // Cues fire on the first control tick at or after their shared time
+        cueSync.update(Hal::nowMillis());
+        Cue cue;
+        while (cueSync.takeDueCue(cue))
+        {
+            applyColor(Trace::FromCue, cue.red, cue.green, cue.blue, cue.fadeMs);
         }
-        catch (...)
+        // A DMX frame is a live level, not a color to remember, so it isn't saved
+        uint8_t levels[DmxReceiver::CHANNELS];
+        if (dmx.poll(levels))
         {
-            Serial.println("Failed to start server - attempting restart");
-            delay(1000);
-            ESP.restart();
+            Trace::record(Trace::Type::NetColor, Trace::FromDmx, map(levels[0], 0, 255, 0, 2047),
+                          map(levels[1], 0, 255, 0, 2047), map(levels[2], 0, 255, 0, 2047));
+            ledController.setLevels(map(levels[0], 0, 255, 0, 2047),
+                                    map(levels[1], 0, 255, 0, 2047),
+                                    map(levels[2], 0, 255, 0, 2047));
         }
+        ws.cleanupClients();
     }
 
+public:
+    WiFiManager(LEDController &controller, SettingsStore &settingsStore, ColorEngine &engine, PresetBank &presetBank)
+        : server(80), ws("/ws"), ledController(controller), settings(settingsStore), colorEngine(engine),
+          presets(presetBank) {}
+
+    // Requests the access point and server; bring-up happens over the next update() calls
+    void begin()
+    {
+        wantRunning = true;
+    }
+
+    // Called once per control tick in every mode: advances start/stop by at
+    // most one step and, while serving, applies published network commands
     void update()
     {
-        // Not needed with AsyncWebServer
+        step(Hal::nowMillis());
+        if (state == WiFiState::Serving && wantRunning)
+        {
+            applyPublishedState();
+            Metrics::wifiClients.set(WiFi.softAPgetStationNum());
+        }
     }
 
+    // Requests teardown; it completes over the next update() calls
     void stop()
     {
-        server.end();
-        delay(100);
-        WiFi.softAPdisconnect(true);
-        delay(100);
-        Serial.println("WiFi and server stopped");
+        wantRunning = false;
     }
+
+    bool isServing() const { return state == WiFiState::Serving; }
+    bool isTransitioning() const { return state != WiFiState::Stopped && state != WiFiState::Serving; }
+    unsigned long getLastStartLatency() const { return lastStartLatency; }
+    unsigned long getLastStopLatency() const { return lastStopLatency; }
 };
\ No newline at end of file
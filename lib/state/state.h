@@ -1,8 +1,12 @@
 #ifndef STATE_H
 #define STATE_H
 
-#include <Arduino.h>
+#include "Platform.h"
 #include "LEDController.h"
+#include "ButtonInput.h"
+#include "GestureDecoder.h"
+#include "Trace.h"
+#include "Hal.h"
 
 enum class OperationMode {
     RGB,
@@ -11,55 +15,113 @@ enum class OperationMode {
     OFF,
 };
 
+// Mode selection from button gestures: click steps forward through the modes,
+// double-click steps back, long-press switches off (or back on from OFF).
+// Holding the button while turning a pot is reported as an adjustment instead.
+// OFF has no double-click, so the click that turns the lamp on isn't held
+// back for the double-click window
 class StateHandler {
-private:
+public:
     static constexpr int BUTTON_PIN = 9;
-    static constexpr int DEBOUNCE_TIME = 50;
-    
+
+private:
     OperationMode currentMode;
-    unsigned long lastButtonPress;
-    bool buttonWasPressed;
+    ButtonInput button;
+    GestureDecoder gestures;
+    uint32_t seenOverflows = 0;
     LEDController &ledController;
 
+    void setMode(OperationMode mode) {
+        currentMode = mode;
+        gestures.setDoubleClickEnabled(hasDoubleClick(mode));
+        Trace::record(Trace::Type::Mode, static_cast<uint8_t>(currentMode));
+    }
+
+    static bool hasDoubleClick(OperationMode mode) {
+        return mode != OperationMode::OFF;
+    }
+
+    static OperationMode nextMode(OperationMode mode) {
+        switch (mode) {
+            case OperationMode::OFF: return OperationMode::RGB;
+            case OperationMode::RGB: return OperationMode::LTT;
+            case OperationMode::LTT: return OperationMode::WIFI;
+            case OperationMode::WIFI: return OperationMode::OFF;
+        }
+        return OperationMode::RGB;
+    }
+
+    static OperationMode previousMode(OperationMode mode) {
+        switch (mode) {
+            case OperationMode::OFF: return OperationMode::WIFI;
+            case OperationMode::RGB: return OperationMode::OFF;
+            case OperationMode::LTT: return OperationMode::RGB;
+            case OperationMode::WIFI: return OperationMode::LTT;
+        }
+        return OperationMode::RGB;
+    }
+
 public:
     StateHandler(LEDController &controller)
-        : currentMode(OperationMode::RGB), lastButtonPress(0), buttonWasPressed(false), ledController(controller) {}
+        : currentMode(OperationMode::RGB), button(BUTTON_PIN), ledController(controller) {}
 
-    void begin() {
-        currentMode = OperationMode::RGB;
-        pinMode(BUTTON_PIN, INPUT);
+    void begin(OperationMode initialMode = OperationMode::RGB) {
+        currentMode = initialMode;
+        gestures.setDoubleClickEnabled(hasDoubleClick(initialMode));
+        button.begin();
     }
 
     OperationMode getCurrentMode() const {
         return currentMode;
     }
 
-    void update() {
-        bool buttonIsPressed = (digitalRead(BUTTON_PIN) == 0);
-        
-        if (buttonIsPressed && !buttonWasPressed) {
-            unsigned long now = millis();
-            if (now - lastButtonPress >= DEBOUNCE_TIME) {
-                lastButtonPress = now;
-                
-                switch (currentMode) {
-                    case OperationMode::OFF:
-                        currentMode = OperationMode::RGB;
-                        break;
-                    case OperationMode::RGB:
-                        currentMode = OperationMode::LTT;
-                        break;
-                    case OperationMode::LTT:
-                        currentMode = OperationMode::WIFI;
-                        break;
-                    case OperationMode::WIFI:
-                        currentMode = OperationMode::OFF;
-                        break;
-                }
-            }
+    // Drains the edges captured since the last call and applies any gesture.
+    // Returns the gesture so the caller can act on adjustments
+    Gesture update() {
+        ButtonInput::Edge edge;
+        while (button.pop(edge)) {
+            Trace::recordAt(edge.timeMicros, Trace::Type::Button, edge.pressed);
+            gestures.edge(edge.pressed, edge.timeMicros);
+        }
+        // If the ring overflowed the final edge may be missing; resync to the pin
+        uint32_t overflows = button.getOverflowCount();
+        if (overflows != seenOverflows) {
+            seenOverflows = overflows;
+            syncButton(Hal::nowMicros());
+        }
+
+        Gesture gesture = gestures.poll(Hal::nowMicros());
+        switch (gesture) {
+            case Gesture::Click:
+                setMode(nextMode(currentMode));
+                break;
+            case Gesture::DoubleClick:
+                setMode(previousMode(currentMode));
+                break;
+            case Gesture::LongPress:
+                setMode(currentMode == OperationMode::OFF ? OperationMode::RGB : OperationMode::OFF);
+                break;
+            default:
+                break;
         }
-        buttonWasPressed = buttonIsPressed;
+        return gesture;
     }
+
+    // Feeds the current pin level in as an edge if the decoder missed it, e.g.
+    // a press that woke the chip from light sleep before its interrupt was live
+    void syncButton(uint32_t timeMicros) {
+        bool pressed = button.isPressed();
+        if (pressed != gestures.isRawPressed()) {
+            gestures.edge(pressed, timeMicros);
+        }
+    }
+
+    bool isButtonIdle() const { return gestures.isIdle(); }
+
+    // Press-and-turn: the caller reports pot movement while the button is held
+    bool isButtonHeld() const { return gestures.isPressed(); }
+    void reportTurn() { gestures.turn(); }
+    bool isAdjusting() const { return gestures.isTurning(); }
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,195 @@
+#!/usr/bin/env python3
+# Web UI size and load-time report. Serves data/ from a local stand-in for the
+# lamp's web server, once the way the SPIFFS handlers did (raw files, only
+# iro.min.js cacheable) and once the way WiFiManager::handleAsset does
+# (gzipped, ETag, Cache-Control from web_assets.py), and loads the page with
+# a browser-like client: a cold load with an empty cache, then a warm one.
+#
+# For each it reports the bytes the lamp sends (headers and bodies) and the
+# time to first paint, taken as the moment the HTML and every script in its
+# <head> have arrived, since those block rendering. The soft AP link is
+# modelled as one shared pipe of --kbps with --rtt-ms per connection setup
+# and per request; defaults are typical of a phone on the C3's access point.
+#
+#   python3 scripts/asset_report.py
+#   python3 scripts/asset_report.py --kbps 1000 --rtt-ms 30 --markdown
+
+import argparse
+import gzip
+import http.client
+import http.server
+import os
+import re
+import threading
+import time
+
+from web_assets import ASSETS, pack
+
+DATA_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "data")
+SEGMENT = 1460  # TCP payload per packet on the AP
+
+
+class Link:
+    """One pipe shared by every connection: bytes queue behind each other."""
+
+    def __init__(self, kbps, rtt_ms):
+        self.bytes_per_s = kbps * 1000 / 8
+        self.rtt = rtt_ms / 1000
+        self.lock = threading.Lock()
+        self.free_at = 0.0
+        self.sent = 0
+
+    def round_trip(self):
+        time.sleep(self.rtt)
+
+    def send(self, sock, data):
+        for offset in range(0, len(data), SEGMENT):
+            segment = data[offset:offset + SEGMENT]
+            with self.lock:
+                start = max(time.perf_counter(), self.free_at)
+                self.free_at = start + len(segment) / self.bytes_per_s
+                done = self.free_at
+                self.sent += len(segment)
+            delay = done - time.perf_counter()
+            if delay > 0:
+                time.sleep(delay)
+            sock.sendall(segment)
+
+
+def load_assets(variant):
+    """Maps path to (body, headers) as the given firmware served it."""
+    served = {}
+    for path, filename, content_type, cache_control in ASSETS:
+        with open(os.path.join(DATA_DIR, filename), "rb") as source:
+            raw = source.read()
+        if variant == "spiffs":
+            headers = {"Content-Type": content_type}
+            if filename == "iro.min.js":
+                headers["Cache-Control"] = "max-age=31536000"
+                headers["Expires"] = "Thu, 31 Dec 2037 23:59:59 GMT"
+            served[path] = (raw, headers, None)
+        else:
+            packed, etag = pack(raw)
+            headers = {"Content-Type": content_type, "Content-Encoding": "gzip", "ETag": etag,
+                       "Cache-Control": cache_control}
+            served[path] = (packed, headers, etag)
+    return served
+
+
+def make_handler(served, link):
+    class Handler(http.server.BaseHTTPRequestHandler):
+        protocol_version = "HTTP/1.1"
+
+        def setup(self):
+            super().setup()
+            link.round_trip()  # TCP handshake
+
+        def log_message(self, *args):
+            pass
+
+        def do_GET(self):
+            link.round_trip()
+            if self.path not in served:
+                self.respond(404, {}, b"")
+                return
+            body, headers, etag = served[self.path]
+            if etag is not None and self.headers.get("If-None-Match") == etag:
+                self.respond(304, {"ETag": etag, "Cache-Control": headers["Cache-Control"]}, b"")
+                return
+            self.respond(200, headers, body)
+
+        def respond(self, code, headers, body):
+            head = "HTTP/1.1 %d %s\r\n" % (code, self.responses[code][0])
+            for name, value in headers.items():
+                head += "%s: %s\r\n" % (name, value)
+            head += "Content-Length: %d\r\n\r\n" % len(body)
+            link.send(self.connection, head.encode() + body)
+
+    return Handler
+
+
+class Browser:
+    """Just enough of a browser cache: max-age skips the request, an ETag revalidates."""
+
+    def __init__(self, port):
+        self.port = port
+        self.cache = {}  # path -> (body, etag, fresh until)
+
+    def fetch(self, path):
+        cached = self.cache.get(path)
+        if cached and cached[2] > time.time():
+            return cached[0]
+        headers = {"Accept-Encoding": "gzip"}
+        if cached and cached[1]:
+            headers["If-None-Match"] = cached[1]
+        connection = http.client.HTTPConnection("127.0.0.1", self.port)
+        connection.request("GET", path, headers=headers)
+        response = connection.getresponse()
+        body = response.read()
+        connection.close()
+        if response.status == 304:
+            return cached[0]
+        if response.getheader("Content-Encoding") == "gzip":
+            body = gzip.decompress(body)
+        etag = response.getheader("ETag")
+        match = re.search(r"max-age=(\d+)", response.getheader("Cache-Control") or "")
+        fresh_until = time.time() + int(match.group(1)) if match else 0
+        # Without a validator or a lifetime there is nothing to reuse
+        if etag or fresh_until:
+            self.cache[path] = (body, etag, fresh_until)
+        return body
+
+    def first_paint(self):
+        """Seconds until the HTML and its head scripts are all in."""
+        start = time.perf_counter()
+        html = self.fetch("/").decode()
+        head = html.split("</head>", 1)[0]
+        scripts = re.findall(r'<script src="([^"]+)"', head)
+        # Fetched in parallel, as a browser's preload scanner would
+        threads = [threading.Thread(target=self.fetch, args=(src,)) for src in scripts]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        return time.perf_counter() - start
+
+
+def measure(variant, args):
+    link = Link(args.kbps, args.rtt_ms)
+    server = http.server.ThreadingHTTPServer(("127.0.0.1", 0), make_handler(load_assets(variant), link))
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    browser = Browser(server.server_address[1])
+    results = []
+    for load in ("cold", "warm"):
+        link.sent = 0
+        seconds = browser.first_paint()
+        results.append((variant, load, link.sent, seconds * 1000))
+    server.shutdown()
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Web UI bytes and time to first paint, before and after embedding")
+    parser.add_argument("--kbps", type=float, default=2000, help="soft AP throughput in kbit/s")
+    parser.add_argument("--rtt-ms", type=float, default=10, help="round trip per connection and per request")
+    parser.add_argument("--markdown", action="store_true", help="print tables for the README")
+    args = parser.parse_args()
+
+    print("Flash per file:" if not args.markdown else "| File | Raw bytes | Gzipped bytes |\n|---|---:|---:|")
+    for _, filename, _, _ in ASSETS:
+        with open(os.path.join(DATA_DIR, filename), "rb") as source:
+            raw = source.read()
+        packed, _ = pack(raw)
+        row = (filename, len(raw), len(packed))
+        print("| %s | %d | %d |" % row if args.markdown else "  %-14s %6d raw, %6d gzipped" % row)
+
+    print()
+    print("Page load at %g kbit/s, %g ms RTT:" % (args.kbps, args.rtt_ms) if not args.markdown else
+          "| Served from | Load | Bytes sent | First paint (ms) |\n|---|---|---:|---:|")
+    for variant in ("spiffs", "embedded"):
+        for row in measure(variant, args):
+            print("| %s | %s | %d | %.0f |" % row if args.markdown else "  %-9s %-5s %7d bytes, first paint %6.0f ms" % row)
+
+
+if __name__ == "__main__":
+    main()
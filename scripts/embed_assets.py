@@ -0,0 +1,73 @@
+# PlatformIO pre-build script: gzips the web UI in data/ and embeds it as
+# const flash arrays in include/WebAssets.h, so WiFiManager can serve the UI
+# without mounting SPIFFS. ETags are content hashes of the gzipped bytes.
+Import("env")
+
+import os
+import sys
+
+project_dir = env.subst("$PROJECT_DIR")
+# SCons runs this file without __file__, so find web_assets.py from the project
+sys.path.insert(0, os.path.join(project_dir, "scripts"))
+from web_assets import ASSETS, pack
+
+data_dir = os.path.join(project_dir, "data")
+output_path = os.path.join(project_dir, "include", "WebAssets.h")
+
+
+def symbol_for(filename):
+    return "ASSET_" + "".join(c.upper() if c.isalnum() else "_" for c in filename)
+
+
+def render():
+    lines = [
+        "// Generated by scripts/embed_assets.py from data/ - do not edit",
+        "#ifndef WEB_ASSETS_H",
+        "#define WEB_ASSETS_H",
+        "",
+        "#include <Arduino.h>",
+        "",
+        "struct WebAsset {",
+        "    const char *path;",
+        "    const char *contentType;",
+        "    const char *cacheControl;",
+        "    const char *etag;",
+        "    const uint8_t *data;",
+        "    size_t length;",
+        "};",
+        "",
+    ]
+    entries = []
+    for path, filename, content_type, cache_control in ASSETS:
+        with open(os.path.join(data_dir, filename), "rb") as source:
+            raw = source.read()
+        packed, etag = pack(raw)
+        symbol = symbol_for(filename)
+        lines.append("// %s: %d bytes, %d gzipped" % (filename, len(raw), len(packed)))
+        lines.append("static const uint8_t %s[] PROGMEM = {" % symbol)
+        for offset in range(0, len(packed), 16):
+            chunk = packed[offset:offset + 16]
+            lines.append("    " + ", ".join("0x%02x" % b for b in chunk) + ",")
+        lines.append("};")
+        lines.append("")
+        entries.append('    {"%s", "%s", "%s", "%s", %s, sizeof(%s)},' % (
+            path, content_type, cache_control, etag.replace('"', '\\"'), symbol, symbol))
+    lines.append("static const WebAsset WEB_ASSETS[] = {")
+    lines.extend(entries)
+    lines.append("};")
+    lines.append("static constexpr size_t WEB_ASSET_COUNT = sizeof(WEB_ASSETS) / sizeof(WEB_ASSETS[0]);")
+    lines.append("")
+    lines.append("#endif")
+    return "\n".join(lines) + "\n"
+
+
+contents = render()
+existing = None
+if os.path.exists(output_path):
+    with open(output_path) as current:
+        existing = current.read()
+# Only rewrite on change so an unchanged UI doesn't trigger a rebuild
+if contents != existing:
+    with open(output_path, "w") as output:
+        output.write(contents)
+    print("Embedded web assets into include/WebAssets.h")
@@ -0,0 +1,20 @@
+# The web UI files and how the lamp serves them. Shared by embed_assets.py,
+# which builds them into flash, and asset_report.py, which measures them.
+
+import gzip
+import hashlib
+
+ASSETS = [
+    # (request path, file in data/, content type, cache-control)
+    ("/", "index.html", "text/html", "no-cache"),
+    ("/iro.min.js", "iro.min.js", "text/javascript", "max-age=31536000"),
+    ("/iro_script.js", "iro_script.js", "text/javascript", "no-cache"),
+]
+
+
+def pack(raw):
+    """Returns (gzipped bytes, quoted ETag) for one file's contents."""
+    # mtime=0 keeps the output (and so the ETag) stable across builds
+    packed = gzip.compress(raw, compresslevel=9, mtime=0)
+    etag = '"%s"' % hashlib.sha1(packed).hexdigest()[:16]
+    return packed, etag
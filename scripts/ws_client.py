@@ -0,0 +1,190 @@
+#!/usr/bin/env python3
+# Test client for the lamp's two color paths: the /ws WebSocket and POST
+# /postRGB. Measures round-trip latency and frames per second for each, using
+# only the standard library, so it runs from any laptop joined to the lamp's
+# network.
+#
+# WebSocket frames are [r, g, b, seq] (optionally plus a little-endian fade
+# in ms); the lamp echoes a nonzero seq byte once it has queued the frame.
+# With --window 1 each frame waits for its echo (latency); a larger window
+# keeps that many frames in flight (throughput). /postRGB is a text/plain
+# "r,g,b[,t]" body on one keep-alive connection, one request at a time.
+#
+#   python3 scripts/ws_client.py                  # both paths, 500 frames each
+#   python3 scripts/ws_client.py --path ws --window 8 --count 2000
+#   python3 scripts/ws_client.py --host colorshadow.local --fade 40
+
+import argparse
+import base64
+import http.client
+import os
+import socket
+import statistics
+import struct
+import time
+
+
+class WebSocket:
+    """Minimal RFC 6455 client: binary frames out, masked; frames in, unmasked."""
+
+    def __init__(self, host, port, path, timeout):
+        self.sock = socket.create_connection((host, port), timeout=timeout)
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        key = base64.b64encode(os.urandom(16)).decode()
+        request = (
+            f"GET {path} HTTP/1.1\r\nHost: {host}:{port}\r\nUpgrade: websocket\r\n"
+            f"Connection: Upgrade\r\nSec-WebSocket-Key: {key}\r\nSec-WebSocket-Version: 13\r\n\r\n"
+        )
+        self.sock.sendall(request.encode())
+        response = b""
+        while b"\r\n\r\n" not in response:
+            chunk = self.sock.recv(1024)
+            if not chunk:
+                raise ConnectionError("connection closed during the WebSocket handshake")
+            response += chunk
+        head, self.buffer = response.split(b"\r\n\r\n", 1)
+        if b" 101 " not in head.split(b"\r\n", 1)[0]:
+            raise ConnectionError("WebSocket upgrade refused: " + head.split(b"\r\n", 1)[0].decode())
+
+    def send_binary(self, payload):
+        mask = os.urandom(4)
+        masked = bytes(b ^ mask[i % 4] for i, b in enumerate(payload))
+        # Color frames are always under 126 bytes
+        self.sock.sendall(bytes([0x82, 0x80 | len(payload)]) + mask + masked)
+
+    def _read(self, count):
+        while len(self.buffer) < count:
+            chunk = self.sock.recv(4096)
+            if not chunk:
+                raise ConnectionError("WebSocket closed")
+            self.buffer += chunk
+        data, self.buffer = self.buffer[:count], self.buffer[count:]
+        return data
+
+    def receive(self):
+        """Returns (opcode, payload) of the next frame."""
+        first, second = self._read(2)
+        length = second & 0x7F
+        if length == 126:
+            length = struct.unpack(">H", self._read(2))[0]
+        elif length == 127:
+            length = struct.unpack(">Q", self._read(8))[0]
+        return first & 0x0F, self._read(length)
+
+    def close(self):
+        try:
+            self.sock.sendall(bytes([0x88, 0x80]) + os.urandom(4))
+        finally:
+            self.sock.close()
+
+
+def color_for(i):
+    # A slow hue walk, so the lamp visibly follows along
+    phase = i % 768
+    if phase < 256:
+        return 255 - phase, phase, 0
+    if phase < 512:
+        return 0, 511 - phase, phase - 256
+    return phase - 512, 0, 767 - phase
+
+
+def summarize(name, latencies, frames, elapsed, lost=0):
+    if latencies:
+        ordered = sorted(latencies)
+        p50 = ordered[len(ordered) // 2]
+        p99 = ordered[min(len(ordered) - 1, len(ordered) * 99 // 100)]
+        print(
+            f"{name:8} {frames} frames in {elapsed:.2f} s: {frames / elapsed:7.1f} fps, "
+            f"rtt p50 {p50:6.2f} ms, p99 {p99:6.2f} ms, max {ordered[-1]:6.2f} ms, "
+            f"mean {statistics.mean(ordered):6.2f} ms, lost {lost}"
+        )
+    else:
+        print(f"{name:8} no replies")
+
+
+def run_ws(args):
+    ws = WebSocket(args.host, args.port, "/ws", args.timeout)
+    sent_at = {}
+    latencies = []
+    lost = 0
+    start = time.perf_counter()
+    sent = 0
+    seq = 0
+    while sent < args.count or sent_at:
+        while sent < args.count and len(sent_at) < args.window:
+            seq = seq % 255 + 1  # Zero means "don't echo"
+            if seq in sent_at:
+                break
+            r, g, b = color_for(sent)
+            frame = bytes([r, g, b, seq])
+            if args.fade:
+                frame += struct.pack("<H", args.fade)
+            sent_at[seq] = time.perf_counter()
+            ws.send_binary(frame)
+            sent += 1
+            if args.rate:
+                time.sleep(1.0 / args.rate)
+        try:
+            opcode, payload = ws.receive()
+        except socket.timeout:
+            # The lamp keeps one frame per control tick; an unanswered one was
+            # dropped on the way, not coalesced
+            lost += len(sent_at)
+            sent_at.clear()
+            continue
+        if opcode == 0x2 and len(payload) == 1 and payload[0] in sent_at:
+            latencies.append((time.perf_counter() - sent_at.pop(payload[0])) * 1000)
+    elapsed = time.perf_counter() - start
+    ws.close()
+    summarize("ws", latencies, sent, elapsed, lost)
+
+
+def run_http(args):
+    connection = http.client.HTTPConnection(args.host, args.port, timeout=args.timeout)
+    latencies = []
+    failures = 0
+    start = time.perf_counter()
+    for i in range(args.count):
+        r, g, b = color_for(i)
+        body = f"{r},{g},{b}" + (f",{args.fade}" if args.fade else "")
+        began = time.perf_counter()
+        try:
+            connection.request("POST", "/postRGB", body, {"Content-Type": "text/plain"})
+            response = connection.getresponse()
+            response.read()
+            if response.status == 200:
+                latencies.append((time.perf_counter() - began) * 1000)
+            else:
+                failures += 1
+        except (OSError, http.client.HTTPException):
+            failures += 1
+            connection.close()
+            connection = http.client.HTTPConnection(args.host, args.port, timeout=args.timeout)
+        if args.rate:
+            time.sleep(1.0 / args.rate)
+    elapsed = time.perf_counter() - start
+    connection.close()
+    summarize("/postRGB", latencies, args.count, elapsed, failures)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Round-trip latency and fps for the lamp's color paths")
+    parser.add_argument("--host", default="192.168.4.1", help="lamp address (default: the access point's)")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--path", choices=["ws", "http", "both"], default="both")
+    parser.add_argument("--count", type=int, default=500, help="frames per path")
+    parser.add_argument("--window", type=int, default=1, help="WebSocket frames in flight (max 255)")
+    parser.add_argument("--rate", type=float, default=0, help="frames per second to send at; 0 is flat out")
+    parser.add_argument("--fade", type=int, default=0, help="fade in ms carried by every frame")
+    parser.add_argument("--timeout", type=float, default=2.0, help="seconds to wait for a reply")
+    args = parser.parse_args()
+    args.window = max(1, min(args.window, 255))
+
+    if args.path in ("ws", "both"):
+        run_ws(args)
+    if args.path in ("http", "both"):
+        run_http(args)
+
+
+if __name__ == "__main__":
+    main()
@@ -3,143 +3,154 @@
 #include "LTTController.h"
 #include "WiFiManager.h"
 #include "State.h"
-
-const int RED_PIN = 5;
-const int GREEN_PIN = 6;
-const int BLUE_PIN = 7;
+#include "PotSampler.h"
+#include "ControlLoop.h"
+#include "Scheduler.h"
+#include "Settings.h"
+#include "Log.h"
+#include "Metrics.h"
+#include "ColorEngine.h"
+#include "Trace.h"
+#include "PowerManager.h"
+#include "PresetBank.h"
+#include "Hal.h"
 
 const int POT_RED_PIN = 4;
 const int POT_GREEN_PIN = 3;
 const int POT_BLUE_PIN = 0;
 
-const int MOVING_AVERAGE_SIZE = 8; // Size of the moving average window
-
-int pot1Values[MOVING_AVERAGE_SIZE] = {0};
-int pot2Values[MOVING_AVERAGE_SIZE] = {0};
-int pot3Values[MOVING_AVERAGE_SIZE] = {0};
-int potIndex = 0;
-
-int lastPot1 = 0;
-int lastPot2 = 0;
-int lastPot3 = 0;
+const uint32_t SENSE_INTERVAL_US = 20000;        // Pot filtering, 50 Hz
+const uint32_t CONTROL_INTERVAL_US = 5000;       // Button, modes and output, 200 Hz
+const uint32_t HOUSEKEEPING_INTERVAL_US = 1000000; // Settings flush and stats, 1 Hz
 
-//unsigned long potTimer = 0;
-//const int potInterval = 50; // Check every 50ms
-//bool potChanged = false;
+SettingsStore settings;
+PresetBank presetBank;
 
-LEDController ledController(
-    RED_PIN, GREEN_PIN, BLUE_PIN,
-    0, 1, 2);
+// Output pins are fixed at compile time by LampOutput in LEDController.h
+LEDController ledController(settings);
 
-LTTController lttController(ledController);
-WiFiManager wifiManager(ledController);
+ColorEngine colorEngine(settings);
+LTTController lttController(ledController, colorEngine);
+WiFiManager wifiManager(ledController, settings, colorEngine, presetBank);
 StateHandler stateHandler(ledController);
+PotSampler potSampler(POT_RED_PIN, POT_GREEN_PIN, POT_BLUE_PIN);
+PowerManager powerManager(StateHandler::BUTTON_PIN, potSampler);
+ControlLoop controlLoop(ledController, lttController, stateHandler, potSampler, settings);
+Scheduler scheduler;
 
-int readAveragedADC(int pin, int samples = 4)
-{
-  int32_t sum = 0;
-  for (int i = 0; i < samples; i++)
-  {
-    sum += analogReadMilliVolts(pin);
-  }
-  return sum / samples;
-}
-
-int calculateMovingAverage(int *values, int size)
-{
-  int sum = 0;
-  for (int i = 0; i < size; i++)
-  {
-    sum += values[i];
-  }
-  return sum / size;
-}
+void senseTask();
+void controlTask();
+void housekeepingTask();
 
 void setup()
 {
   Serial.begin(115200);
+  Log::begin();
+  settings.begin();
+  presetBank.begin();
   ledController.begin();
-  stateHandler.begin();
+  colorEngine.begin();
+
+  // Come back up in the mode the lamp was last left in
+  uint8_t lastMode = settings.get().lastMode;
+  stateHandler.begin(lastMode <= static_cast<uint8_t>(OperationMode::OFF)
+                         ? static_cast<OperationMode>(lastMode)
+                         : OperationMode::RGB);
 
   analogSetAttenuation(ADC_2_5db);
   analogSetPinAttenuation(POT_RED_PIN, ADC_2_5db);
   analogSetPinAttenuation(POT_GREEN_PIN, ADC_2_5db);
   analogSetPinAttenuation(POT_BLUE_PIN, ADC_2_5db);
+
+  // Start background pot sampling only after the ADC is configured
+  potSampler.begin();
+  powerManager.begin();
+
+  // Registration order is priority order when several tasks are due together
+  scheduler.add("control", CONTROL_INTERVAL_US, controlTask);
+  scheduler.add("sense", SENSE_INTERVAL_US, senseTask);
+  scheduler.add("housekeeping", HOUSEKEEPING_INTERVAL_US, housekeepingTask);
+  Metrics::attachScheduler(&scheduler);
 }
 
-void loop()
+void senseTask()
 {
-  static unsigned long lastUpdate = 0;
-  const unsigned long UPDATE_INTERVAL = 20;
+  controlLoop.sense(Hal::nowMillis());
+}
 
-  unsigned long currentMillis = millis();
-  if (currentMillis - lastUpdate >= UPDATE_INTERVAL)
-  {
-    lastUpdate = currentMillis;
-    stateHandler.update();
+void controlTask()
+{
+  controlLoop.readInputs();
 
-    if (stateHandler.getCurrentMode() == OperationMode::WIFI)
-    {
-      wifiManager.update();
-    }
+  static bool wasInWiFiMode = false;
+  bool isInWiFiMode = controlLoop.getMode() == OperationMode::WIFI;
 
-    int pot1 = readAveragedADC(POT_RED_PIN);
-    int pot2 = readAveragedADC(POT_GREEN_PIN);
-    int pot3 = readAveragedADC(POT_BLUE_PIN);
+  if (isInWiFiMode && !wasInWiFiMode)
+  {
+    wifiManager.begin();
+    ledController.checkAndUpdatePowerLimit();
+  }
+  else if (!isInWiFiMode && wasInWiFiMode)
+  {
+    wifiManager.stop();
+    ledController.setLevels(0, 0, 0);
+    ledController.checkAndUpdatePowerLimit();
+  }
+  wasInWiFiMode = isInWiFiMode;
 
-    pot1 = map(constrain(pot1, 5, 950), 5, 950, 0, 2047); // Left pot (meant for Red)
-    pot2 = map(constrain(pot2, 5, 950), 5, 950, 0, 2047); // Middle pot (meant for Green)
-    pot3 = map(constrain(pot3, 5, 950), 5, 950, 0, 2047); // Right pot (meant for Blue)
+  // Advances WiFi start/stop one step per tick and, while serving,
+  // applies whatever the network handlers published since the last tick
+  wifiManager.update();
 
-    // Update moving average arrays
-    pot1Values[potIndex] = pot1;
-    pot2Values[potIndex] = pot2;
-    pot3Values[potIndex] = pot3;
-    potIndex = (potIndex + 1) % MOVING_AVERAGE_SIZE;
+  controlLoop.applyOutputs();
 
-    // Calculate moving averages
-    pot1 = calculateMovingAverage(pot1Values, MOVING_AVERAGE_SIZE);
-    pot2 = calculateMovingAverage(pot2Values, MOVING_AVERAGE_SIZE);
-    pot3 = calculateMovingAverage(pot3Values, MOVING_AVERAGE_SIZE);
+  // Downclock or sleep once the lamp is off or left alone
+  bool serving = isInWiFiMode || wifiManager.isServing() || wifiManager.isTransitioning();
+  powerManager.update(Hal::nowMillis(), controlLoop.idleInputs(serving));
+}
 
-    //Serial.print("pot1: ");
-    //Serial.print(pot1);
-    //Serial.print(", pot2: ");
-    //Serial.print(pot2);
-    //Serial.print(", pot3: ");
-    //Serial.println(pot3);
+void housekeepingTask()
+{
+  // Coalesced, rate-limited NVS commit of anything changed since the last flush
+  settings.flush(Hal::nowMillis());
+  presetBank.flush(Hal::nowMillis());
 
-    static bool wasInWiFiMode = false;
-    bool isInWiFiMode = stateHandler.getCurrentMode() == OperationMode::WIFI;
+  // Free heap and largest free block low-water marks, for fragmentation soaks
+  Metrics::sampleHeap(Hal::nowMillis());
 
-    if (isInWiFiMode && !wasInWiFiMode)
+  // Send 's' over Serial to dump per-task jitter and execution histograms,
+  // or 'd' to dump the input trace as hex
+  while (Serial.available() > 0)
+  {
+    int command = Serial.read();
+    if (command == 's')
     {
-      wifiManager.begin();
-      ledController.checkAndUpdatePowerLimit();
+      scheduler.printStats(Serial);
     }
-    else if (!isInWiFiMode && wasInWiFiMode)
+    else if (command == 'd')
     {
-      wifiManager.stop();
-      ledController.setPWMDirectly(0, 0, 0);
-      ledController.checkAndUpdatePowerLimit();
+      Trace::dumpHex(Serial);
     }
-    wasInWiFiMode = isInWiFiMode;
+  }
+}
+
+void loop()
+{
+  scheduler.run();
 
-    switch (stateHandler.getCurrentMode())
+  // In OFF the whole chip sleeps until the button or the next housekeeping pass
+  if (powerManager.getState() == PowerState::LightSleep)
+  {
+    if (powerManager.lightSleep())
     {
-    case OperationMode::RGB:
-      // pot1 is LEFT (physically red), pot3 is RIGHT (physically blue)
-      // since the LED pins are now swapped in begin(), we need to swap these too
-      ledController.setPWMDirectly(pot3, pot2, pot1); // Swap values to match physical layout
-      break;
-    case OperationMode::LTT:
-      lttController.updateLTT(pot1, pot2, pot3);
-      break;
-    case OperationMode::OFF:
-    case OperationMode::WIFI:
-      // LED control happens via WiFi in WIFI mode
-      break;
+      // The waking press may predate the edge interrupt being re-armed
+      stateHandler.syncButton(Hal::nowMicros());
     }
+    scheduler.resume();
+    return;
   }
-  delay(2);
+
+  // Sleep until the next task is due so the idle time goes to other FreeRTOS tasks
+  uint32_t idleMicros = scheduler.microsUntilNextDue();
+  delay(idleMicros >= 1000 ? idleMicros / 1000 : 1);
 }
\ No newline at end of file
@@ -0,0 +1,30 @@
+#ifndef BENCHMARK_BASELINE_H
+#define BENCHMARK_BASELINE_H
+
+// Host nanoseconds per operation for test_benchmark, from a -O2 native build
+// on a ~3 GHz x86-64 desktop. A stage fails once it is slower than
+// BENCHMARK_TOLERANCE times its baseline, which absorbs machine-to-machine
+// and run-to-run spread but catches a stage that picks up a loop, a float
+// path or an allocation. After a deliberate change, rerun, check the printed
+// figures and update the numbers here in the same commit.
+#ifndef BENCHMARK_TOLERANCE
+#define BENCHMARK_TOLERANCE 4.0
+#endif
+
+namespace baseline {
+
+constexpr double SENSE_NS = 80;            // ControlLoop::sense, three pots
+constexpr double READ_INPUTS_NS = 20;      // Button drain, gestures, press-and-turn
+constexpr double RGB_OUTPUT_NS = 30;       // setPWMDirectly with every channel moving
+constexpr double LEVEL_CONVERSION_NS = 25; // setLevels: LUT, Q16 master and governor scaling
+constexpr double LTT_OUTPUT_NS = 75;       // updateLTT with every pot moving
+constexpr double GOVERNOR_UPDATE_NS = 30;  // LEDController::update, no fade
+constexpr double FADE_STEP_NS = 50;        // LEDController::update during a fade
+constexpr double DITHER_TICK_NS = 70;      // One dither timer callback
+constexpr double CONTROL_TICK_NS = 60;     // readInputs + applyOutputs in RGB, on top of sense
+constexpr double MODE_TRANSITION_NS = 200; // The control tick that takes a click
+constexpr double LOG_CALL_NS = 20;         // LOG_INFO with three arguments, ring not full
+
+}
+
+#endif
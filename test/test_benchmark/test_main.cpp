@@ -0,0 +1,315 @@
+// Control-path benchmarks on the native build. Each stage main.cpp runs per
+// tick is timed against the fake Hal and compared with baseline.h, so a
+// regression fails `pio test -e native` instead of showing up as jitter on
+// the lamp. Figures are host nanoseconds, useful for relative cost only.
+#include <unity.h>
+#include <algorithm>
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "ControlLoop.h"
+#include "ColorEngine.h"
+#include "HalFake.h"
+#include "Log.h"
+#include "baseline.h"
+
+namespace {
+
+const int POT_PINS[PotSampler::NUM_POTS] = {4, 3, 0};
+constexpr int RUNS = 7;
+
+SettingsStore settings;
+LEDController led(settings);
+ColorEngine colorEngine(settings);
+LTTController ltt(led, colorEngine);
+StateHandler stateHandler(led);
+PotSampler potSampler(POT_PINS[0], POT_PINS[1], POT_PINS[2]);
+ControlLoop controlLoop(led, ltt, stateHandler, potSampler, settings);
+
+volatile uint32_t sink;
+
+double nowNs() {
+    using namespace std::chrono;
+    return duration<double, std::nano>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Median over RUNS batches of the mean time per call
+template <typename Body>
+double nsPerCall(int iterations, Body body) {
+    double samples[RUNS];
+    for (int run = 0; run < RUNS; run++) {
+        double start = nowNs();
+        for (int i = 0; i < iterations; i++) {
+            body(i);
+        }
+        samples[run] = (nowNs() - start) / iterations;
+    }
+    std::sort(samples, samples + RUNS);
+    return samples[RUNS / 2];
+}
+
+// Host TSC cycles for one call, where the host has a TSC; 0 elsewhere
+template <typename Body>
+double cyclesPerCall(int iterations, Body body) {
+#if defined(__x86_64__) || defined(__i386__)
+    double samples[RUNS];
+    for (int run = 0; run < RUNS; run++) {
+        uint64_t start = __rdtsc();
+        for (int i = 0; i < iterations; i++) {
+            body(i);
+        }
+        samples[run] = static_cast<double>(__rdtsc() - start) / iterations;
+    }
+    std::sort(samples, samples + RUNS);
+    return samples[RUNS / 2];
+#else
+    (void)iterations;
+    (void)body;
+    return 0;
+#endif
+}
+
+void check(const char* stage, double ns, double baselineNs) {
+    char message[160];
+    snprintf(message, sizeof(message), "%-16s %8.1f ns (baseline %.0f, limit %.0f)", stage, ns, baselineNs,
+             baselineNs * BENCHMARK_TOLERANCE);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_TRUE_MESSAGE(ns <= baselineNs * BENCHMARK_TOLERANCE, message);
+}
+
+// Pot samples that sweep the whole range, so no stage is short-circuited by
+// a dead-band or an unchanged input
+void pushPots(int i) {
+    for (int pot = 0; pot < PotSampler::NUM_POTS; pot++) {
+        potSampler.pushSample(pot, static_cast<uint16_t>(5 + ((i * 37 + pot * 300) % 945)));
+    }
+}
+
+void setMode(OperationMode mode) {
+    while (controlLoop.getMode() != mode) {
+        Hal::Fake::setPinLevel(StateHandler::BUTTON_PIN, 0);
+        Hal::Fake::advanceMillis(60);
+        controlLoop.readInputs();
+        Hal::Fake::setPinLevel(StateHandler::BUTTON_PIN, 1);
+        Hal::Fake::advanceMillis(300);
+        controlLoop.readInputs();
+    }
+}
+
+}
+
+void setUp() {
+    setMode(OperationMode::RGB);
+}
+
+void tearDown() {}
+
+void test_sense() {
+    double ns = nsPerCall(20000, [](int i) {
+        pushPots(i);
+        controlLoop.sense(i * 20);
+    });
+    check("sense", ns, baseline::SENSE_NS);
+}
+
+void test_read_inputs() {
+    double ns = nsPerCall(20000, [](int) { controlLoop.readInputs(); });
+    check("readInputs", ns, baseline::READ_INPUTS_NS);
+}
+
+void test_rgb_output() {
+    double ns = nsPerCall(20000, [](int i) { led.setPWMDirectly(i % 2048, (i * 7) % 2048, (i * 13) % 2048); });
+    check("rgb output", ns, baseline::RGB_OUTPUT_NS);
+}
+
+// The float math the LUT and Q16 path replaced, for comparison only: curve
+// and trim per channel, master level, then the governor's share
+volatile float floatSink;
+void floatConversion(int i) {
+    const float trims[3] = {RED_TRIM, GREEN_TRIM, BLUE_TRIM};
+    const int levels[3] = {i % 2048, (i * 7) % 2048, (i * 13) % 2048};
+    float duties[3];
+    float total = 0;
+    for (int ch = 0; ch < 3; ch++) {
+        duties[ch] = cieLightnessCurve(levels[ch] / 2047.0f) * trims[ch] * LUT_FULL_SCALE * 0.75f;
+        total += duties[ch];
+    }
+    float requested = total / (3.0f * LUT_FULL_SCALE);
+    float scale = requested > 0.5f ? 0.5f / requested : 1.0f;
+    floatSink = duties[0] * scale + duties[1] * scale + duties[2] * scale;
+}
+
+// One network color through to the dither targets. The host has an FPU, so
+// the float figure flatters it; on the FPU-less C3 every float op there is a
+// soft-float call
+void test_level_conversion() {
+    led.setMasterLevel(PowerGovernor::FULL_POWER_Q16 * 3 / 4);
+    auto lut = [](int i) { led.setLevels(i % 2048, (i * 7) % 2048, (i * 13) % 2048); };
+    double ns = nsPerCall(20000, lut);
+    char line[160];
+    snprintf(line, sizeof(line), "level conversion: %.0f host cycles (LUT + Q16), %.0f (float reference)",
+             cyclesPerCall(20000, lut), cyclesPerCall(20000, floatConversion));
+    TEST_MESSAGE(line);
+    led.setMasterLevel(PowerGovernor::FULL_POWER_Q16);
+    check("level conversion", ns, baseline::LEVEL_CONVERSION_NS);
+}
+
+void test_ltt_output() {
+    double ns = nsPerCall(20000, [](int i) { ltt.updateLTT((i * 3) % 2048, (i * 11) % 2048, (i * 17) % 2048); });
+    check("ltt output", ns, baseline::LTT_OUTPUT_NS);
+}
+
+void test_governor_update() {
+    led.setPWMDirectly(2047, 2047, 2047);
+    double ns = nsPerCall(20000, [](int) {
+        Hal::Fake::advanceMicros(100);
+        led.update();
+    });
+    check("governor update", ns, baseline::GOVERNOR_UPDATE_NS);
+}
+
+void test_fade_step() {
+    double ns = nsPerCall(20000, [](int i) {
+        if (!led.isFading()) {
+            led.fadeTo(i % 2 ? 2047 : 0, 1024, i % 2 ? 0 : 2047, 1000);
+        }
+        Hal::Fake::advanceMicros(100);
+        led.update();
+    });
+    check("fade step", ns, baseline::FADE_STEP_NS);
+}
+
+// advanceMicros() by one period fires exactly one dither tick; the
+// cost includes the fake stage/latch writes, which stand in for LEDC
+void test_dither_tick() {
+    double ns = nsPerCall(20000, [](int i) {
+        if (i % 3 == 0) {
+            led.setPWMDirectly(i % 2048, (i * 5) % 2048, (i * 9) % 2048);
+        }
+        Hal::Fake::advanceMicros(500);
+    });
+    check("dither tick", ns, baseline::DITHER_TICK_NS);
+}
+
+void test_control_tick() {
+    double ns = nsPerCall(20000, [](int i) {
+        pushPots(i);
+        controlLoop.sense(i * 5);
+        controlLoop.readInputs();
+        controlLoop.applyOutputs();
+    });
+    // sense runs at a quarter of the control rate on the lamp; it is
+    // included here only to keep the outputs moving
+    check("control tick", ns, baseline::CONTROL_TICK_NS + baseline::SENSE_NS);
+}
+
+// Only the tick in which the click is decoded and the mode changes is timed;
+// the press, release and double-click wait are set up outside the clock. OFF
+// has no double-click, so there the click is decoded on the release tick
+void test_mode_transition() {
+    double samples[RUNS];
+    for (int run = 0; run < RUNS; run++) {
+        double total = 0;
+        const int transitions = 400;
+        for (int i = 0; i < transitions; i++) {
+            OperationMode before = controlLoop.getMode();
+            Hal::Fake::setPinLevel(StateHandler::BUTTON_PIN, 0);
+            Hal::Fake::advanceMillis(60);
+            controlLoop.readInputs();
+            Hal::Fake::setPinLevel(StateHandler::BUTTON_PIN, 1);
+            Hal::Fake::advanceMillis(60);
+            if (before != OperationMode::OFF) {
+                controlLoop.readInputs();
+                Hal::Fake::advanceMillis(GestureDecoder::DOUBLE_CLICK_US / 1000);
+            }
+
+            double start = nowNs();
+            controlLoop.readInputs();
+            controlLoop.applyOutputs();
+            total += nowNs() - start;
+            TEST_ASSERT_TRUE(controlLoop.getMode() != before);
+        }
+        samples[run] = total / transitions;
+    }
+    std::sort(samples, samples + RUNS);
+    check("mode transition", samples[RUNS / 2], baseline::MODE_TRANSITION_NS);
+}
+
+// Counts what the console would have received, without the console's cost
+class NullPrint : public Print {
+public:
+    size_t bytes = 0;
+    size_t write(uint8_t) override {
+        bytes++;
+        return 1;
+    }
+    size_t write(const uint8_t* buffer, size_t size) override {
+        (void)buffer;
+        bytes += size;
+        return size;
+    }
+};
+
+// What a call site pays: a deferred LOG_INFO against the Serial.printf it
+// replaced, both formatting into a null console. On the lamp printf also
+// waits on the UART, so the real gap is wider. Records are drained off the
+// clock every BATCH calls, so none is dropped (a drop would flatter the ring)
+void test_log_call() {
+    NullPrint console;
+    Log::drain(console);
+    const int BATCH = Log::CAPACITY / 2;
+    double samples[RUNS];
+    double drainNs = 0;
+    for (int run = 0; run < RUNS; run++) {
+        double total = 0;
+        const int batches = 500;
+        for (int batch = 0; batch < batches; batch++) {
+            double start = nowNs();
+            for (int i = 0; i < BATCH; i++) {
+                LOG_INFO("Power limit updated to: %s (%d of %d)\n", "unlocked", i, 2047);
+            }
+            total += nowNs() - start;
+            start = nowNs();
+            TEST_ASSERT_EQUAL(BATCH, Log::drain(console));
+            drainNs += nowNs() - start;
+        }
+        samples[run] = total / (batches * BATCH);
+    }
+    std::sort(samples, samples + RUNS);
+    drainNs /= RUNS * 500.0 * BATCH;
+    double printfNs = nsPerCall(20000, [](int i) {
+        static NullPrint direct;
+        direct.printf("Power limit updated to: %s (%d of %d)\n", "unlocked", i, 2047);
+    });
+    char line[160];
+    snprintf(line, sizeof(line), "log call: %.1f ns deferred, %.1f ns synchronous printf; drain %.1f ns per record",
+             samples[RUNS / 2], printfNs, drainNs);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_EQUAL_UINT32(0, Log::droppedCount());
+    TEST_ASSERT_TRUE_MESSAGE(samples[RUNS / 2] < printfNs, line);
+    check("log call", samples[RUNS / 2], baseline::LOG_CALL_NS);
+}
+
+int main() {
+    Hal::Fake::reset();
+    settings.begin();
+    colorEngine.begin();
+    led.begin();
+    stateHandler.begin(OperationMode::RGB);
+    sink = Hal::Fake::timerCount();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_sense);
+    RUN_TEST(test_read_inputs);
+    RUN_TEST(test_rgb_output);
+    RUN_TEST(test_level_conversion);
+    RUN_TEST(test_ltt_output);
+    RUN_TEST(test_governor_update);
+    RUN_TEST(test_fade_step);
+    RUN_TEST(test_dither_tick);
+    RUN_TEST(test_control_tick);
+    RUN_TEST(test_mode_transition);
+    RUN_TEST(test_log_call);
+    return UNITY_END();
+}
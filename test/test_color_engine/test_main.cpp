@@ -0,0 +1,65 @@
+// ColorEngine: the channel trims reach the linear CCT path through
+// DEFAULT_MATRIX, the same way the pot path gets them through its LUTs
+#include <unity.h>
+#include "ColorEngine.h"
+#include "HalFake.h"
+
+namespace {
+
+constexpr ColorMatrix UNTRIMMED = color_detail::invertPrimaries(
+    {0.690, 0.309, 0.30}, {0.170, 0.700, 0.60}, {0.136, 0.048, 0.10});
+
+double ratio(const uint32_t duties[3], int channel) {
+    return static_cast<double>(duties[channel]) / duties[1];
+}
+
+}
+
+void setUp() {
+    Hal::Fake::reset();
+}
+
+void tearDown() {}
+
+void test_default_matrix_rows_carry_the_trims() {
+    const float trims[3] = {RED_TRIM, GREEN_TRIM, BLUE_TRIM};
+    for (int i = 0; i < 9; i++) {
+        TEST_ASSERT_INT_WITHIN(1, static_cast<int32_t>(UNTRIMMED.m[i] * trims[i / 3]), ColorEngine::DEFAULT_MATRIX.m[i]);
+    }
+}
+
+void test_cct_duties_match_the_trimmed_pot_path() {
+    SettingsStore settings;
+    settings.begin();
+    ColorEngine trimmed(settings);
+    trimmed.begin();
+    ColorEngine untrimmed(settings);
+    untrimmed.setMatrix(UNTRIMMED);
+
+    const int kelvins[] = {2700, 4000, 6500};
+    for (int kelvin : kelvins) {
+        uint32_t raw[3], out[3];
+        untrimmed.cctToDuties(1024, kelvin, 0, raw);
+        trimmed.cctToDuties(1024, kelvin, 0, out);
+        TEST_ASSERT_FLOAT_WITHIN(0.01, ratio(raw, 0) * RED_TRIM / GREEN_TRIM, ratio(out, 0));
+        TEST_ASSERT_FLOAT_WITHIN(0.01, ratio(raw, 2) * BLUE_TRIM / GREEN_TRIM, ratio(out, 2));
+    }
+}
+
+void test_stored_calibration_replaces_the_default() {
+    SettingsStore settings;
+    settings.begin();
+    ColorEngine engine(settings);
+    engine.setMatrix(UNTRIMMED);
+    ColorEngine reloaded(settings);
+    reloaded.begin();
+    TEST_ASSERT_EQUAL_INT32_ARRAY(UNTRIMMED.m, reloaded.getMatrix().m, 9);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_default_matrix_rows_carry_the_trims);
+    RUN_TEST(test_cct_duties_match_the_trimmed_pot_path);
+    RUN_TEST(test_stored_calibration_replaces_the_default);
+    return UNITY_END();
+}
@@ -0,0 +1,87 @@
+// ControlLoop press-and-turn against the fake Hal: the color holds through a
+// press, and after an adjustment the moved pot stays taken over until it is
+// turned back, including across the next press
+#include <unity.h>
+#include "ControlLoop.h"
+#include "ColorEngine.h"
+#include "HalFake.h"
+
+namespace {
+
+SettingsStore settings;
+LEDController led(settings);
+ColorEngine colorEngine(settings);
+LTTController ltt(led, colorEngine);
+StateHandler stateHandler(led);
+PotSampler potSampler(4, 3, 0);
+ControlLoop controlLoop(led, ltt, stateHandler, potSampler, settings);
+
+void setPots(uint16_t a, uint16_t b, uint16_t c) {
+    for (int i = 0; i < PotSampler::RING_SIZE; i++) {
+        potSampler.pushSample(0, a);
+        potSampler.pushSample(1, b);
+        potSampler.pushSample(2, c);
+    }
+}
+
+// 200 ms of control ticks with sensing, long enough to fill the pot filters
+void run() {
+    for (int tick = 0; tick < 40; tick++) {
+        Hal::Fake::advanceMillis(5);
+        if (tick % 4 == 0) {
+            controlLoop.sense(Hal::nowMillis());
+        }
+        controlLoop.readInputs();
+        controlLoop.applyOutputs();
+    }
+}
+
+void button(bool pressed) {
+    Hal::Fake::setPinLevel(StateHandler::BUTTON_PIN, pressed ? 0 : 1);
+}
+
+uint32_t duty(int channel) {
+    // Averages out the dither
+    Hal::Fake::advanceMillis(20);
+    return Hal::Fake::latchedDuty(channel);
+}
+
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_press_and_turn_keeps_the_color_through_the_next_press() {
+    setPots(300, 500, 700);
+    run();
+    uint32_t before = duty(1);
+
+    // Press and turn the middle pot: the master level moves, the color doesn't
+    button(true);
+    run();
+    setPots(300, 200, 700);
+    run();
+    button(false);
+    run();
+    uint32_t afterTurn = duty(1);
+
+    // The middle pot is still taken over, so a plain press must not jump to it
+    button(true);
+    run();
+    TEST_ASSERT_UINT32_WITHIN(1, afterTurn, duty(1));
+    button(false);
+    run();
+    TEST_ASSERT_UINT32_WITHIN(1, afterTurn, duty(1));
+    TEST_ASSERT_NOT_EQUAL(0, before);
+}
+
+int main() {
+    Hal::Fake::reset();
+    settings.begin();
+    colorEngine.begin();
+    led.begin();
+    stateHandler.begin(OperationMode::RGB);
+    UNITY_BEGIN();
+    RUN_TEST(test_press_and_turn_keeps_the_color_through_the_next_press);
+    return UNITY_END();
+}
@@ -0,0 +1,282 @@
+// ControlMailbox: which field groups a drain reports, in what order, when
+// the writer side sees a request as applied, and a stress run with one
+// publishing thread (the AsyncTCP task) and a draining one (the control loop)
+#include <unity.h>
+#include <atomic>
+#include <thread>
+#include "ControlMailbox.h"
+
+namespace {
+
+ControlMailbox* mailbox;
+
+// Stress payloads carry a check value derived from their counter, so a
+// state assembled from two different publishes is caught
+void colorFor(uint32_t n, uint16_t& red, uint16_t& green, uint16_t& blue, uint16_t& fadeMs) {
+    red = n % 2048;
+    green = (n / 2048) % 2048;
+    blue = (red + green * 7) % 2048;
+    fadeMs = static_cast<uint16_t>(n);
+}
+
+bool colorIsWhole(const ControlState& state) {
+    uint32_t n = state.red + state.green * 2048UL;
+    return state.blue == (state.red + state.green * 7) % 2048 && state.fadeMs == static_cast<uint16_t>(n);
+}
+
+bool cctIsWhole(const ControlState& state) {
+    return state.cctKelvin == 1000 + state.cctLevel * 4 && state.cctDuv == -static_cast<int16_t>(state.cctLevel % 500);
+}
+
+// n is carried in every keyframe, and the frame count follows from it
+SequenceRequest keyframesFor(uint32_t n) {
+    SequenceRequest sequence;
+    sequence.count = 1 + n % TransitionEngine::MAX_KEYFRAMES;
+    sequence.loop = n % 2;
+    for (int i = 0; i < TransitionEngine::MAX_KEYFRAMES; i++) {
+        sequence.frames[i].red = n % 2048;
+        sequence.frames[i].green = (n / 2048) % 2048;
+        sequence.frames[i].durationMs = static_cast<uint16_t>(n + i);
+    }
+    return sequence;
+}
+
+// Returns the n a sequence was built from, or -1 if it mixes two publishes
+int32_t keyframesIndex(const SequenceRequest& sequence) {
+    uint32_t n = sequence.frames[0].red + sequence.frames[0].green * 2048UL;
+    if (sequence.count != 1 + n % TransitionEngine::MAX_KEYFRAMES || sequence.loop != (n % 2 == 1)) {
+        return -1;
+    }
+    for (int i = 0; i < TransitionEngine::MAX_KEYFRAMES; i++) {
+        if (sequence.frames[i].red != sequence.frames[0].red || sequence.frames[i].green != sequence.frames[0].green ||
+            sequence.frames[i].durationMs != static_cast<uint16_t>(n + i)) {
+            return -1;
+        }
+    }
+    return n;
+}
+
+}
+
+void setUp() {
+    mailbox = new ControlMailbox();
+}
+
+void tearDown() {
+    delete mailbox;
+}
+
+void test_empty_drain_reports_nothing() {
+    ControlChanges changed;
+    mailbox->drain(changed);
+    TEST_ASSERT_EQUAL_INT(0, changed.count);
+}
+
+void test_groups_come_back_in_arrival_order() {
+    mailbox->publishRecall(2);
+    mailbox->publishPowerProfile(true);
+    mailbox->publishColor(1, 2, 3);
+    ControlChanges changed;
+    ControlState state = mailbox->drain(changed);
+    TEST_ASSERT_EQUAL_INT(3, changed.count);
+    TEST_ASSERT_TRUE(changed.order[0] == ControlGroup::Recall);
+    TEST_ASSERT_TRUE(changed.order[1] == ControlGroup::Power);
+    TEST_ASSERT_TRUE(changed.order[2] == ControlGroup::Color);
+    TEST_ASSERT_EQUAL_UINT8(2, state.recallIndex);
+    TEST_ASSERT_TRUE(state.unlocked);
+}
+
+// A group published again moves behind the groups published in between
+void test_republished_group_moves_to_the_end() {
+    mailbox->publishColor(1, 2, 3);
+    mailbox->publishRecall(4);
+    mailbox->publishColor(5, 6, 7);
+    ControlChanges changed;
+    ControlState state = mailbox->drain(changed);
+    TEST_ASSERT_EQUAL_INT(2, changed.count);
+    TEST_ASSERT_TRUE(changed.order[0] == ControlGroup::Recall);
+    TEST_ASSERT_TRUE(changed.order[1] == ControlGroup::Color);
+    TEST_ASSERT_EQUAL_UINT16(5, state.red);
+}
+
+void test_only_new_groups_after_a_drain() {
+    ControlChanges changed;
+    mailbox->publishColor(1, 2, 3);
+    mailbox->publishCct(100, 2700, 0);
+    mailbox->drain(changed);
+    mailbox->publishCct(200, 4000, 0);
+    ControlState state = mailbox->drain(changed);
+    TEST_ASSERT_EQUAL_INT(1, changed.count);
+    TEST_ASSERT_TRUE(changed.order[0] == ControlGroup::Cct);
+    TEST_ASSERT_EQUAL_UINT16(4000, state.cctKelvin);
+}
+
+// Calibration, keyframes and hysteresis come back through payload(), in
+// arrival order with the small groups
+void test_payload_groups_arrive_with_their_data() {
+    const int32_t matrix[9] = {1, 2, 3, 4, 5, 6, 7, 8, 9};
+    HysteresisConfig configs[3];
+    configs[2].noiseThreshold = 40;
+    mailbox->publishCalibration(matrix);
+    mailbox->publishColor(1, 2, 3);
+    mailbox->publishSequence(keyframesFor(5));
+    mailbox->publishHysteresis(configs);
+    ControlChanges changed;
+    mailbox->drain(changed);
+    TEST_ASSERT_EQUAL_INT(4, changed.count);
+    TEST_ASSERT_TRUE(changed.order[0] == ControlGroup::Calibration);
+    TEST_ASSERT_TRUE(changed.order[1] == ControlGroup::Color);
+    TEST_ASSERT_TRUE(changed.order[2] == ControlGroup::Sequence);
+    TEST_ASSERT_TRUE(changed.order[3] == ControlGroup::Hysteresis);
+    TEST_ASSERT_EQUAL_INT32_ARRAY(matrix, mailbox->payload().calibration, 9);
+    TEST_ASSERT_EQUAL_INT32(5, keyframesIndex(mailbox->payload().keyframes));
+    TEST_ASSERT_EQUAL_INT(40, mailbox->payload().hysteresis[2].noiseThreshold);
+
+    // A small group alone leaves the payload as it was
+    mailbox->publishSequence(keyframesFor(6));
+    mailbox->drain(changed);
+    mailbox->publishColor(4, 5, 6);
+    mailbox->drain(changed);
+    TEST_ASSERT_EQUAL_INT(1, changed.count);
+    TEST_ASSERT_TRUE(changed.order[0] == ControlGroup::Color);
+    TEST_ASSERT_EQUAL_INT32(6, keyframesIndex(mailbox->payload().keyframes));
+    TEST_ASSERT_EQUAL_UINT32(mailbox->lastPublished().keyframesSeq, mailbox->lastPublishedPayload().keyframesSeq);
+}
+
+void test_request_is_applied_only_after_acknowledge() {
+    mailbox->publishPowerProfile(true);
+    uint32_t seq = mailbox->lastPublished().powerSeq;
+    TEST_ASSERT_FALSE(mailbox->isApplied(seq));
+    ControlChanges changed;
+    mailbox->drain(changed);
+    TEST_ASSERT_FALSE(mailbox->isApplied(seq));
+    mailbox->acknowledge();
+    TEST_ASSERT_TRUE(mailbox->isApplied(seq));
+
+    mailbox->publishColor(1, 1, 1);
+    TEST_ASSERT_TRUE(mailbox->isApplied(seq));
+    TEST_ASSERT_FALSE(mailbox->isApplied(mailbox->lastPublished().colorSeq));
+}
+
+// The AsyncTCP task publishing colors, CCTs, recalls, power changes and
+// keyframe sequences against a control loop draining as fast as it can.
+// Every drained state and payload must be whole, sequence numbers may only
+// move forward, changes are reported in arrival order, no keyframe sequence
+// is reported twice, and the last drain sees the last publish of every group
+void test_one_producer_one_consumer() {
+    const uint32_t PUBLISHES = 200000;
+    std::atomic<bool> go{false};
+    std::atomic<bool> running{true};
+    uint32_t drains = 0, changes = 0, torn = 0, backwards = 0, misordered = 0, replayed = 0;
+
+    std::thread consumer([&] {
+        while (!go.load(std::memory_order_acquire)) {
+        }
+        ControlState previous;
+        int32_t lastKeyframes = -1;
+        for (;;) {
+            bool last = !running.load(std::memory_order_acquire);
+            ControlChanges changed;
+            ControlState state = mailbox->drain(changed);
+            drains++;
+            changes += changed.count;
+            if ((state.colorSeq != 0 && !colorIsWhole(state)) || (state.cctSeq != 0 && !cctIsWhole(state))) {
+                torn++;
+            }
+            if (static_cast<int32_t>(state.sequence - previous.sequence) < 0 ||
+                static_cast<int32_t>(state.colorSeq - previous.colorSeq) < 0 ||
+                static_cast<int32_t>(state.keyframesSeq - previous.keyframesSeq) < 0) {
+                backwards++;
+            }
+            // Arrival order: the listed groups' sequence numbers must rise
+            uint32_t seen = 0;
+            for (int i = 0; i < changed.count; i++) {
+                uint32_t seq = 0;
+                switch (changed.order[i]) {
+                case ControlGroup::Color: seq = state.colorSeq; break;
+                case ControlGroup::Cct: seq = state.cctSeq; break;
+                case ControlGroup::Recall: seq = state.recallSeq; break;
+                case ControlGroup::Power: seq = state.powerSeq; break;
+                case ControlGroup::Sequence: {
+                    seq = state.keyframesSeq;
+                    int32_t index = keyframesIndex(mailbox->payload().keyframes);
+                    torn += index < 0 ? 1 : 0;
+                    replayed += index <= lastKeyframes ? 1 : 0;
+                    lastKeyframes = index;
+                    break;
+                }
+                default: break;
+                }
+                misordered += seq <= seen ? 1 : 0;
+                seen = seq;
+            }
+            mailbox->acknowledge();
+            previous = state;
+            if (changed.count == 0) {
+                std::this_thread::yield();
+            }
+            if (last) {
+                break;
+            }
+        }
+    });
+
+    // The producer yields now and then, as network handlers would between
+    // packets; back-to-back stores would starve the seqlock reader
+    std::thread producer([&] {
+        while (!go.load(std::memory_order_acquire)) {
+        }
+        for (uint32_t n = 0; n < PUBLISHES; n++) {
+            uint16_t red, green, blue, fadeMs;
+            colorFor(n, red, green, blue, fadeMs);
+            mailbox->publishColor(red, green, blue, fadeMs);
+            uint16_t level = n % 2048;
+            mailbox->publishCct(level, 1000 + level * 4, -static_cast<int16_t>(level % 500));
+            if (n % 16 == 0) {
+                mailbox->publishSequence(keyframesFor(n));
+                std::this_thread::yield();
+            }
+            if (n % 64 == 0) {
+                mailbox->publishRecall(n % 8);
+                mailbox->publishPowerProfile(n % 128 == 0);
+            }
+        }
+        running.store(false, std::memory_order_release);
+    });
+    go.store(true, std::memory_order_release);
+    producer.join();
+    consumer.join();
+
+    char summary[128];
+    snprintf(summary, sizeof(summary), "%u drains, %u group changes reported, %u publishes",
+             drains, changes, mailbox->lastPublished().sequence);
+    TEST_MESSAGE(summary);
+    // The consumer must have raced the producer, not just seen the end
+    TEST_ASSERT_GREATER_THAN(1000, changes);
+    TEST_ASSERT_EQUAL_UINT32(0, torn);
+    TEST_ASSERT_EQUAL_UINT32(0, backwards);
+    TEST_ASSERT_EQUAL_UINT32(0, misordered);
+    TEST_ASSERT_EQUAL_UINT32(0, replayed);
+
+    // Every publish took its own sequence number
+    const ControlState& last = mailbox->lastPublished();
+    TEST_ASSERT_EQUAL_UINT32(2 * PUBLISHES + PUBLISHES / 16 + 2 * (PUBLISHES / 64), last.sequence);
+    uint16_t red, green, blue, fadeMs;
+    colorFor(PUBLISHES - 1, red, green, blue, fadeMs);
+    TEST_ASSERT_EQUAL_UINT16(red, last.red);
+    TEST_ASSERT_EQUAL_UINT16((PUBLISHES - 1) % 2048, last.cctLevel);
+    TEST_ASSERT_EQUAL_INT32(PUBLISHES - 16, keyframesIndex(mailbox->payload().keyframes));
+    TEST_ASSERT_TRUE(mailbox->isApplied(last.sequence));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_empty_drain_reports_nothing);
+    RUN_TEST(test_groups_come_back_in_arrival_order);
+    RUN_TEST(test_republished_group_moves_to_the_end);
+    RUN_TEST(test_only_new_groups_after_a_drain);
+    RUN_TEST(test_payload_groups_arrive_with_their_data);
+    RUN_TEST(test_request_is_applied_only_after_acknowledge);
+    RUN_TEST(test_one_producer_one_consumer);
+    return UNITY_END();
+}
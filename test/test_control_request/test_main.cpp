@@ -0,0 +1,172 @@
+// /postRGB body parsing in both wire formats, and an allocation soak over the body-callback path:
+// parse, then publish to the mailbox, then drain it as the control loop does
+#include <unity.h>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include "ControlRequest.h"
+#include "ControlMailbox.h"
+
+namespace {
+
+std::atomic<uint32_t> allocations{0};
+
+bool parse(const char* body, ColorRequest& out) {
+    return parseColorRequest(reinterpret_cast<const uint8_t*>(body), strlen(body), out);
+}
+
+}
+
+void* operator new(size_t size) {
+    allocations++;
+    void* block = malloc(size ? size : 1);
+    if (block == nullptr) {
+        throw std::bad_alloc();
+    }
+    return block;
+}
+
+void operator delete(void* block) noexcept { free(block); }
+void operator delete(void* block, size_t) noexcept { free(block); }
+
+void setUp() {}
+void tearDown() {}
+
+void test_three_fields() {
+    ColorRequest color;
+    TEST_ASSERT_TRUE(parse("255,128,0", color));
+    TEST_ASSERT_EQUAL_UINT8(255, color.red);
+    TEST_ASSERT_EQUAL_UINT8(128, color.green);
+    TEST_ASSERT_EQUAL_UINT8(0, color.blue);
+    TEST_ASSERT_EQUAL_UINT16(0, color.fadeMs);
+}
+
+void test_fade_field() {
+    ColorRequest color;
+    TEST_ASSERT_TRUE(parse("1,2,3,60", color));
+    TEST_ASSERT_EQUAL_UINT8(3, color.blue);
+    TEST_ASSERT_EQUAL_UINT16(60, color.fadeMs);
+}
+
+void test_values_are_clamped() {
+    ColorRequest color;
+    TEST_ASSERT_TRUE(parse("300,0,99999999,70000", color));
+    TEST_ASSERT_EQUAL_UINT8(255, color.red);
+    TEST_ASSERT_EQUAL_UINT8(255, color.blue);
+    TEST_ASSERT_EQUAL_UINT16(65535, color.fadeMs);
+}
+
+void test_malformed_bodies_are_rejected() {
+    const char* bodies[] = {"", "1,2", "1,2,3,4,5", "1,,3", "1,2,3,", ",1,2,3", "r=1&g=2&b=3", "1,2,-3", "1, 2, 3"};
+    for (const char* body : bodies) {
+        ColorRequest color;
+        TEST_ASSERT_FALSE_MESSAGE(parse(body, color), body);
+    }
+}
+
+// Only the bytes the server reports are read; no terminator is needed
+void test_length_bounds_the_parse() {
+    ColorRequest color;
+    const char body[] = "10,20,30,40xx";
+    TEST_ASSERT_TRUE(parseColorRequest(reinterpret_cast<const uint8_t*>(body), 11, color));
+    TEST_ASSERT_EQUAL_UINT16(40, color.fadeMs);
+}
+
+// The CSV body and the older form fields give the same request
+void test_csv_and_form_formats_agree() {
+    ColorRequest csv, form;
+    TEST_ASSERT_TRUE(parse("255,128,7,60", csv));
+    TEST_ASSERT_TRUE(parseColorForm("255", "128", "7", "60", form));
+    TEST_ASSERT_EQUAL_MEMORY(&csv, &form, sizeof(ColorRequest));
+
+    TEST_ASSERT_TRUE(parse("1,2,3", csv));
+    TEST_ASSERT_TRUE(parseColorForm("1", "2", "3", nullptr, form));
+    TEST_ASSERT_EQUAL_MEMORY(&csv, &form, sizeof(ColorRequest));
+}
+
+// Form values keep the old constrain(toInt()) behavior; only a missing
+// channel is an error
+void test_form_fields_clamp_and_require_rgb() {
+    ColorRequest color;
+    TEST_ASSERT_TRUE(parseColorForm("300", "-5", "abc", "70000", color));
+    TEST_ASSERT_EQUAL_UINT8(255, color.red);
+    TEST_ASSERT_EQUAL_UINT8(0, color.green);
+    TEST_ASSERT_EQUAL_UINT8(0, color.blue);
+    TEST_ASSERT_EQUAL_UINT16(65535, color.fadeMs);
+    TEST_ASSERT_FALSE(parseColorForm(nullptr, "1", "2", nullptr, color));
+    TEST_ASSERT_FALSE(parseColorForm("1", nullptr, "2", nullptr, color));
+    TEST_ASSERT_FALSE(parseColorForm("1", "2", nullptr, "3", color));
+}
+
+void test_recall_index() {
+    uint32_t index;
+    TEST_ASSERT_TRUE(parseRecallRequest(reinterpret_cast<const uint8_t*>("12"), 2, index));
+    TEST_ASSERT_EQUAL_UINT32(12, index);
+    const char* bodies[] = {"", "n=3", "1,2", "-1", " 3"};
+    for (const char* body : bodies) {
+        TEST_ASSERT_FALSE_MESSAGE(parseRecallRequest(reinterpret_cast<const uint8_t*>(body), strlen(body), index), body);
+    }
+}
+
+void test_sequence_keyframes_and_loop() {
+    SequenceRequest sequence;
+    const char body[] = "255,0,0,500,100;0,0,255,250;loop";
+    TEST_ASSERT_TRUE(parseSequenceRequest(reinterpret_cast<const uint8_t*>(body), strlen(body), sequence));
+    TEST_ASSERT_EQUAL_UINT8(2, sequence.count);
+    TEST_ASSERT_TRUE(sequence.loop);
+    TEST_ASSERT_EQUAL_UINT16(2047, sequence.frames[0].red);
+    TEST_ASSERT_EQUAL_UINT16(500, sequence.frames[0].durationMs);
+    TEST_ASSERT_EQUAL_UINT16(100, sequence.frames[0].holdMs);
+    TEST_ASSERT_EQUAL_UINT16(2047, sequence.frames[1].blue);
+    TEST_ASSERT_EQUAL_UINT16(0, sequence.frames[1].holdMs);
+}
+
+void test_malformed_sequences_are_rejected() {
+    const char* bodies[] = {"", "loop", "1,2,3", "1,2,3,4,5,6", "1,2,3,4;", "1,2,3,4;loop;1,2,3,4", "1,2,3,4;loops"};
+    for (const char* body : bodies) {
+        SequenceRequest sequence;
+        TEST_ASSERT_FALSE_MESSAGE(parseSequenceRequest(reinterpret_cast<const uint8_t*>(body), strlen(body), sequence),
+                                  body);
+    }
+    char longBody[512] = "";
+    for (int i = 0; i <= TransitionEngine::MAX_KEYFRAMES; i++) {
+        strcat(longBody, i == 0 ? "1,2,3,4" : ";1,2,3,4");
+    }
+    SequenceRequest sequence;
+    TEST_ASSERT_FALSE(parseSequenceRequest(reinterpret_cast<const uint8_t*>(longBody), strlen(longBody), sequence));
+}
+
+void test_body_path_does_not_allocate() {
+    ControlMailbox mailbox;
+    char body[32];
+    uint32_t before = allocations.load();
+    for (int i = 0; i < 200000; i++) {
+        int length = snprintf(body, sizeof(body), "%d,%d,%d,%d", i % 256, (i * 7) % 256, (i * 13) % 256, i % 500);
+        ColorRequest color;
+        TEST_ASSERT_TRUE(parseColorRequest(reinterpret_cast<const uint8_t*>(body), length, color));
+        mailbox.publishColor(map(color.red, 0, 255, 0, 2047), map(color.green, 0, 255, 0, 2047),
+                             map(color.blue, 0, 255, 0, 2047), color.fadeMs);
+        ControlChanges changed;
+        ControlState state = mailbox.drain(changed);
+        TEST_ASSERT_EQUAL_INT(1, changed.count);
+        TEST_ASSERT_EQUAL_UINT16(color.fadeMs, state.fadeMs);
+    }
+    TEST_ASSERT_EQUAL_UINT32(before, allocations.load());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_three_fields);
+    RUN_TEST(test_fade_field);
+    RUN_TEST(test_values_are_clamped);
+    RUN_TEST(test_malformed_bodies_are_rejected);
+    RUN_TEST(test_length_bounds_the_parse);
+    RUN_TEST(test_csv_and_form_formats_agree);
+    RUN_TEST(test_form_fields_clamp_and_require_rgb);
+    RUN_TEST(test_recall_index);
+    RUN_TEST(test_sequence_keyframes_and_loop);
+    RUN_TEST(test_malformed_sequences_are_rejected);
+    RUN_TEST(test_body_path_does_not_allocate);
+    return UNITY_END();
+}
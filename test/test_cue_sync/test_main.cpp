@@ -0,0 +1,200 @@
+// Shared-clock simulation for several lamps on one network. Each lamp has its
+// own crystal (a start offset and a drift in ppm); followers poll their
+// reference the way CueSync does and feed every exchange through ClockFilter.
+// One-way delays get a base latency, exponential queueing jitter drawn
+// separately per direction, and occasional long stalls. The inter-lamp skew
+// is the spread of the lamps' shared clocks at the same true instant
+#include <unity.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "ClockFilter.h"
+
+namespace {
+
+struct Network {
+    double baseMicros;      // Each direction
+    double jitterMeanMicros;
+    double stallChance;     // Per packet
+    double stallMicros;
+};
+
+struct Lamp {
+    int reference;          // Index of the lamp it polls, -1 for the leader
+    double startMicros;     // Local clock at true time 0
+    double ppm;
+    ClockFilter filter;
+    ClockSample estimate = {0, 0};
+    ClockSample latest = {0, 0};  // Newest exchange, unfiltered, for comparison
+    uint32_t polls = 0;
+
+    double local(double t) const { return startMicros + t * (1.0 + ppm * 1e-6); }
+    double shared(double t) const { return local(t) + estimate.offset; }
+    double unfiltered(double t) const { return local(t) + latest.offset; }
+};
+
+constexpr double TURNAROUND_MICROS = 200;
+// CueSync's poll schedule; CueSync itself needs AsyncUDP, which the native
+// build doesn't have
+constexpr double POLL_INTERVAL_MICROS = 1000000;
+constexpr double FAST_POLL_INTERVAL_MICROS = 100000;
+
+class Simulation {
+public:
+    Simulation(const Network& network, uint32_t seed) : network(network), random(seed) {}
+
+    std::vector<Lamp> lamps;
+
+    double oneWay() {
+        std::exponential_distribution<double> jitter(1.0 / network.jitterMeanMicros);
+        std::uniform_real_distribution<double> chance(0, 1);
+        double delay = network.baseMicros + jitter(random);
+        return chance(random) < network.stallChance ? delay + network.stallMicros : delay;
+    }
+
+    // One exchange between lamp i and its reference, starting at true time t.
+    // The reference stamps its shared clock, as CueSync's reply does
+    void poll(int i, double t) {
+        Lamp& lamp = lamps[i];
+        const Lamp& reference = lamps[lamp.reference];
+        double received = t + oneWay();
+        double sent = received + TURNAROUND_MICROS;
+        double back = sent + oneWay();
+        ClockSample sample = ClockFilter::computeSample(static_cast<int64_t>(lamp.local(t)),
+                                                        static_cast<int64_t>(reference.shared(received)),
+                                                        static_cast<int64_t>(reference.shared(sent)),
+                                                        static_cast<int64_t>(lamp.local(back)));
+        lamp.latest = sample;
+        lamp.estimate = lamp.filter.add(sample);
+        lamp.polls++;
+    }
+
+    struct Skew {
+        double maxMicros;
+        double p99Micros;
+        double unfilteredMaxMicros;
+    };
+
+    // Runs for durationMs of true time, polling on CueSync's schedule with
+    // each lamp's phase offset, and measures the skew every 10 ms once every
+    // filter is full
+    Skew run(uint32_t durationMs) {
+        std::vector<double> nextPoll(lamps.size());
+        std::uniform_real_distribution<double> phase(0, POLL_INTERVAL_MICROS);
+        for (double& due : nextPoll) {
+            due = phase(random);
+        }
+        std::vector<double> spreads;
+        double unfilteredMax = 0;
+        for (double t = 0; t < durationMs * 1000.0; t += 10000) {
+            for (size_t i = 0; i < lamps.size(); i++) {
+                if (lamps[i].reference < 0 || nextPoll[i] > t) {
+                    continue;
+                }
+                poll(static_cast<int>(i), t);
+                bool filling = lamps[i].polls < static_cast<uint32_t>(ClockFilter::SAMPLES);
+                nextPoll[i] = t + (filling ? FAST_POLL_INTERVAL_MICROS : POLL_INTERVAL_MICROS);
+            }
+            if (t < 20 * POLL_INTERVAL_MICROS) {
+                continue;
+            }
+            double low = lamps[0].shared(t), high = low;
+            double rawLow = low, rawHigh = low;
+            for (const Lamp& lamp : lamps) {
+                low = std::min(low, lamp.shared(t));
+                high = std::max(high, lamp.shared(t));
+                if (lamp.reference >= 0) {
+                    rawLow = std::min(rawLow, lamp.unfiltered(t));
+                    rawHigh = std::max(rawHigh, lamp.unfiltered(t));
+                }
+            }
+            spreads.push_back(high - low);
+            unfilteredMax = std::max(unfilteredMax, rawHigh - rawLow);
+        }
+        std::sort(spreads.begin(), spreads.end());
+        return {spreads.back(), spreads[spreads.size() * 99 / 100], unfilteredMax};
+    }
+
+private:
+    Network network;
+    std::mt19937 random;
+};
+
+// A leader, three followers of it and one lamp chained behind a follower
+void addLamps(Simulation& sim) {
+    sim.lamps.resize(5);
+    const double starts[] = {0, 3.7e9, 12e6, 815e6, 42e3};
+    const double ppms[] = {0, 25, -30, 10, -18};
+    const int references[] = {-1, 0, 0, 0, 1};
+    for (int i = 0; i < 5; i++) {
+        sim.lamps[i].startMicros = starts[i];
+        sim.lamps[i].ppm = ppms[i];
+        sim.lamps[i].reference = references[i];
+    }
+}
+
+void report(const char* name, const Simulation::Skew& skew) {
+    char line[160];
+    snprintf(line, sizeof(line), "%s: skew max %.0f us, p99 %.0f us; newest-sample max %.0f us",
+             name, skew.maxMicros, skew.p99Micros, skew.unfilteredMaxMicros);
+    TEST_MESSAGE(line);
+}
+
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_compute_sample_recovers_a_symmetric_offset() {
+    // Reference 5 s ahead, 2 ms each way, 300 us turnaround
+    ClockSample sample = ClockFilter::computeSample(1000000, 6002000, 6002300, 1004300);
+    TEST_ASSERT_EQUAL_INT32(5000000, sample.offset);
+    TEST_ASSERT_EQUAL_INT32(4000, sample.delay);
+}
+
+void test_filter_keeps_the_fastest_exchange_in_the_window() {
+    ClockFilter filter;
+    filter.add({100, 5000});
+    filter.add({900, 1000});
+    TEST_ASSERT_EQUAL_INT32(900, filter.add({-4000, 60000}).offset);
+    // The fast one ages out after SAMPLES more exchanges
+    ClockSample best = {0, 0};
+    for (int i = 0; i < ClockFilter::SAMPLES; i++) {
+        best = filter.add({200, 3000});
+    }
+    TEST_ASSERT_EQUAL_INT32(200, best.offset);
+    TEST_ASSERT_EQUAL_INT(ClockFilter::SAMPLES, filter.size());
+    filter.reset();
+    TEST_ASSERT_EQUAL_INT(0, filter.size());
+}
+
+// A quiet access point: 1 ms each way, 0.5 ms mean queueing
+void test_quiet_network_skew() {
+    Simulation sim({1000, 500, 0.0, 0}, 1);
+    addLamps(sim);
+    Simulation::Skew skew = sim.run(10 * 60 * 1000);
+    report("quiet", skew);
+    TEST_ASSERT_LESS_THAN(1000, static_cast<int>(skew.maxMicros));
+}
+
+// A busy one: 3 ms mean queueing and a 5% chance of an 80 ms stall per
+// packet. The filter has to keep the lamps, the chained one included, within
+// 5 ms, well under a visible step, where trusting the newest exchange would
+// let a single stall through
+void test_congested_network_skew() {
+    Simulation sim({1500, 3000, 0.05, 80000}, 2);
+    addLamps(sim);
+    Simulation::Skew skew = sim.run(10 * 60 * 1000);
+    report("congested", skew);
+    TEST_ASSERT_LESS_THAN(5000, static_cast<int>(skew.maxMicros));
+    TEST_ASSERT_GREATER_THAN(static_cast<int>(skew.maxMicros), static_cast<int>(skew.unfilteredMaxMicros));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_compute_sample_recovers_a_symmetric_offset);
+    RUN_TEST(test_filter_keeps_the_fastest_exchange_in_the_window);
+    RUN_TEST(test_quiet_network_skew);
+    RUN_TEST(test_congested_network_skew);
+    return UNITY_END();
+}
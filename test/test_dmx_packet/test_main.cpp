@@ -0,0 +1,216 @@
+// DmxPacket against generated Art-Net ArtDmx and E1.31 data packets: the
+// patched universe and start address, truncated and malformed packets, and
+// the late-sequence rule across the 255 -> 0 wrap
+#include <unity.h>
+#include <vector>
+#include "DmxPacket.h"
+
+namespace {
+
+// Slot n (1-based) carries n, so the copied levels name the address they came from
+std::vector<uint8_t> artNet(uint16_t portAddress, uint8_t sequence, uint16_t slots = 512) {
+    std::vector<uint8_t> packet = {'A', 'r', 't', '-', 'N', 'e', 't', 0,
+                                   0x00, 0x50,  // OpDmx, little-endian
+                                   0, 14,       // Protocol version
+                                   sequence, 0,
+                                   static_cast<uint8_t>(portAddress & 0xFF),
+                                   static_cast<uint8_t>(portAddress >> 8),
+                                   static_cast<uint8_t>(slots >> 8), static_cast<uint8_t>(slots & 0xFF)};
+    for (int i = 1; i <= slots; i++) {
+        packet.push_back(static_cast<uint8_t>(i));
+    }
+    return packet;
+}
+
+void put16(std::vector<uint8_t>& packet, size_t at, uint16_t value) {
+    packet[at] = value >> 8;
+    packet[at + 1] = value & 0xFF;
+}
+
+void put32(std::vector<uint8_t>& packet, size_t at, uint32_t value) {
+    put16(packet, at, value >> 16);
+    put16(packet, at + 2, value & 0xFFFF);
+}
+
+std::vector<uint8_t> e131(uint16_t universe, uint8_t sequence, uint16_t slots = 512) {
+    std::vector<uint8_t> packet(126 + slots, 0);
+    put16(packet, 0, 0x0010);
+    const char acnId[] = "ASC-E1.17";
+    memcpy(&packet[4], acnId, sizeof(acnId));
+    put16(packet, 16, 0x7000 | (packet.size() - 16));
+    put32(packet, 18, 0x00000004);
+    put16(packet, 38, 0x7000 | (packet.size() - 38));
+    put32(packet, 40, 0x00000002);
+    packet[108] = 100;  // Priority
+    packet[111] = sequence;
+    put16(packet, 113, universe);
+    put16(packet, 115, 0x7000 | (packet.size() - 115));
+    packet[117] = 0x02;
+    packet[118] = 0xA1;
+    put16(packet, 121, 1);
+    put16(packet, 123, slots + 1);
+    for (int i = 1; i <= slots; i++) {
+        packet[125 + i] = static_cast<uint8_t>(i);
+    }
+    return packet;
+}
+
+bool parseArtNet(const std::vector<uint8_t>& packet, uint16_t universe, uint16_t start, uint8_t& sequence,
+                 uint8_t out[DmxPacket::CHANNELS]) {
+    return DmxPacket::parseArtNet(packet.data(), packet.size(), universe, start, sequence, out);
+}
+
+bool parseE131(const std::vector<uint8_t>& packet, uint16_t universe, uint16_t start, uint8_t& sequence,
+               uint8_t out[DmxPacket::CHANNELS]) {
+    return DmxPacket::parseE131(packet.data(), packet.size(), universe, start, sequence, out);
+}
+
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_artnet_universe_match_and_mismatch() {
+    uint8_t sequence = 0;
+    uint8_t levels[DmxPacket::CHANNELS] = {0};
+    // Net 1, SubUni 0x23
+    TEST_ASSERT_TRUE(parseArtNet(artNet(0x0123, 42), 0x0123, 1, sequence, levels));
+    const uint8_t first[] = {1, 2, 3};
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(first, levels, 3);
+    TEST_ASSERT_EQUAL_UINT8(42, sequence);
+
+    TEST_ASSERT_FALSE(parseArtNet(artNet(0x0123, 1), 0x0023, 1, sequence, levels));
+    TEST_ASSERT_FALSE(parseArtNet(artNet(0x0124, 1), 0x0123, 1, sequence, levels));
+    // The port address is 15 bits; the top bit of Net is ignored
+    TEST_ASSERT_TRUE(parseArtNet(artNet(0x8123, 1), 0x0123, 1, sequence, levels));
+}
+
+void test_e131_universe_match_and_mismatch() {
+    uint8_t sequence = 0;
+    uint8_t levels[DmxPacket::CHANNELS] = {0};
+    TEST_ASSERT_TRUE(parseE131(e131(7, 200), 7, 1, sequence, levels));
+    const uint8_t first[] = {1, 2, 3};
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(first, levels, 3);
+    TEST_ASSERT_EQUAL_UINT8(200, sequence);
+    TEST_ASSERT_FALSE(parseE131(e131(8, 1), 7, 1, sequence, levels));
+    TEST_ASSERT_FALSE(parseE131(e131(7 + 256, 1), 7, 1, sequence, levels));
+}
+
+void test_start_address_offset() {
+    uint8_t sequence = 0;
+    uint8_t levels[DmxPacket::CHANNELS] = {0};
+    const uint8_t at100[] = {100, 101, 102};
+    TEST_ASSERT_TRUE(parseArtNet(artNet(1, 1), 1, 100, sequence, levels));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(at100, levels, 3);
+    TEST_ASSERT_TRUE(parseE131(e131(1, 1), 1, 100, sequence, levels));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(at100, levels, 3);
+
+    // The last address that still fits three slots, and the first that doesn't
+    const uint8_t at510[] = {510 & 0xFF, 511 & 0xFF, 512 & 0xFF};
+    TEST_ASSERT_TRUE(parseArtNet(artNet(1, 1), 1, 510, sequence, levels));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(at510, levels, 3);
+    TEST_ASSERT_TRUE(parseE131(e131(1, 1), 1, 510, sequence, levels));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(at510, levels, 3);
+    TEST_ASSERT_FALSE(parseArtNet(artNet(1, 1), 1, 511, sequence, levels));
+    TEST_ASSERT_FALSE(parseE131(e131(1, 1), 1, 511, sequence, levels));
+    TEST_ASSERT_FALSE(parseArtNet(artNet(1, 1), 1, 0, sequence, levels));
+
+    // A short universe only covers the addresses it carries
+    TEST_ASSERT_TRUE(parseArtNet(artNet(1, 1, 24), 1, 22, sequence, levels));
+    TEST_ASSERT_FALSE(parseArtNet(artNet(1, 1, 24), 1, 23, sequence, levels));
+    TEST_ASSERT_TRUE(parseE131(e131(1, 1, 24), 1, 22, sequence, levels));
+    TEST_ASSERT_FALSE(parseE131(e131(1, 1, 24), 1, 23, sequence, levels));
+}
+
+// Every cut of a packet, from empty up to one byte short, is rejected
+void test_truncated_packets() {
+    uint8_t sequence = 0;
+    uint8_t levels[DmxPacket::CHANNELS] = {0};
+    std::vector<uint8_t> full = artNet(1, 1, 16);
+    for (size_t length = 0; length < full.size(); length++) {
+        TEST_ASSERT_FALSE(DmxPacket::parseArtNet(full.data(), length, 1, 1, sequence, levels));
+    }
+    TEST_ASSERT_TRUE(DmxPacket::parseArtNet(full.data(), full.size(), 1, 1, sequence, levels));
+
+    full = e131(1, 1, 16);
+    for (size_t length = 0; length < full.size(); length++) {
+        TEST_ASSERT_FALSE(DmxPacket::parseE131(full.data(), length, 1, 1, sequence, levels));
+    }
+    TEST_ASSERT_TRUE(DmxPacket::parseE131(full.data(), full.size(), 1, 1, sequence, levels));
+
+    // A slot count claiming more than the packet carries
+    std::vector<uint8_t> overclaimed = artNet(1, 1, 16);
+    overclaimed[17] = 17;
+    TEST_ASSERT_FALSE(parseArtNet(overclaimed, 1, 1, sequence, levels));
+    overclaimed = e131(1, 1, 16);
+    put16(overclaimed, 123, 18);
+    TEST_ASSERT_FALSE(parseE131(overclaimed, 1, 1, sequence, levels));
+}
+
+void test_malformed_and_non_dimmer_packets() {
+    uint8_t sequence = 0;
+    uint8_t levels[DmxPacket::CHANNELS] = {0};
+    std::vector<uint8_t> packet = artNet(1, 1);
+    packet[8] = 0x00;
+    packet[9] = 0x20;  // OpPoll
+    TEST_ASSERT_FALSE(parseArtNet(packet, 1, 1, sequence, levels));
+    packet = artNet(1, 1);
+    packet[0] = 'a';
+    TEST_ASSERT_FALSE(parseArtNet(packet, 1, 1, sequence, levels));
+
+    packet = e131(1, 1);
+    packet[125] = 0xDD;  // Alternate start code, not dimmer levels
+    TEST_ASSERT_FALSE(parseE131(packet, 1, 1, sequence, levels));
+    packet = e131(1, 1);
+    put32(packet, 40, 0x00000001);  // Synchronization packet
+    TEST_ASSERT_FALSE(parseE131(packet, 1, 1, sequence, levels));
+    packet = e131(1, 1);
+    packet[112] = 0x80;  // Preview data
+    TEST_ASSERT_FALSE(parseE131(packet, 1, 1, sequence, levels));
+    packet[112] = 0x40;  // Stream terminated
+    TEST_ASSERT_FALSE(parseE131(packet, 1, 1, sequence, levels));
+    packet[112] = 0x20;  // Force synchronization doesn't matter here
+    TEST_ASSERT_TRUE(parseE131(packet, 1, 1, sequence, levels));
+}
+
+// Up to 19 behind (and a repeat) is late; anything else, including a jump
+// back of 20 or more after a source restart, is taken
+void test_stale_sequence_across_wraparound() {
+    TEST_ASSERT_FALSE(DmxPacket::isStale(10, 11));
+    TEST_ASSERT_TRUE(DmxPacket::isStale(10, 10));
+    TEST_ASSERT_TRUE(DmxPacket::isStale(10, 9));
+    TEST_ASSERT_TRUE(DmxPacket::isStale(30, 11));
+    TEST_ASSERT_FALSE(DmxPacket::isStale(30, 10));
+
+    TEST_ASSERT_FALSE(DmxPacket::isStale(255, 0));
+    TEST_ASSERT_FALSE(DmxPacket::isStale(250, 5));
+    TEST_ASSERT_TRUE(DmxPacket::isStale(0, 255));
+    TEST_ASSERT_TRUE(DmxPacket::isStale(5, 242));
+    TEST_ASSERT_FALSE(DmxPacket::isStale(5, 241));
+    // Far ahead is still new: half the sequence space
+    TEST_ASSERT_FALSE(DmxPacket::isStale(200, 71));
+
+    // A stream crossing the wrap with one late packet mixed in
+    const uint8_t arrivals[] = {253, 254, 255, 0, 254, 1, 2};
+    const bool taken[] = {true, true, true, true, false, true, true};
+    uint8_t last = 252;
+    for (size_t i = 0; i < sizeof(arrivals); i++) {
+        bool stale = DmxPacket::isStale(last, arrivals[i]);
+        TEST_ASSERT_EQUAL(taken[i], !stale);
+        if (!stale) {
+            last = arrivals[i];
+        }
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_artnet_universe_match_and_mismatch);
+    RUN_TEST(test_e131_universe_match_and_mismatch);
+    RUN_TEST(test_start_address_offset);
+    RUN_TEST(test_truncated_packets);
+    RUN_TEST(test_malformed_and_non_dimmer_packets);
+    RUN_TEST(test_stale_sequence_across_wraparound);
+    return UNITY_END();
+}
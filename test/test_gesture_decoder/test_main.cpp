@@ -0,0 +1,189 @@
+// GestureDecoder on synthetic edges: debounce, each gesture and its timing,
+// the 32-bit micros() wrap, and gestures queued between polls
+#include <unity.h>
+#include <vector>
+#include "GestureDecoder.h"
+
+namespace {
+
+constexpr uint32_t MS = 1000;
+
+GestureDecoder* decoder;
+
+// Everything queued at this time
+std::vector<Gesture> pollAll(uint32_t nowMicros) {
+    std::vector<Gesture> gestures;
+    for (Gesture gesture; (gesture = decoder->poll(nowMicros)) != Gesture::None;) {
+        gestures.push_back(gesture);
+    }
+    return gestures;
+}
+
+// A press from start that bounces for a few milliseconds on each edge
+void bouncyPress(uint32_t start, uint32_t heldMicros) {
+    decoder->edge(true, start);
+    decoder->edge(false, start + 1 * MS);
+    decoder->edge(true, start + 2 * MS);
+    decoder->edge(false, start + heldMicros);
+    decoder->edge(true, start + heldMicros + 1 * MS);
+    decoder->edge(false, start + heldMicros + 3 * MS);
+}
+
+}
+
+void setUp() {
+    decoder = new GestureDecoder();
+}
+
+void tearDown() {
+    delete decoder;
+}
+
+void test_click_waits_out_the_double_click_window() {
+    bouncyPress(1000 * MS, 100 * MS);
+    TEST_ASSERT_TRUE(pollAll(1100 * MS + GestureDecoder::DOUBLE_CLICK_US - 1 * MS).empty());
+    std::vector<Gesture> gestures = pollAll(1100 * MS + GestureDecoder::DOUBLE_CLICK_US);
+    TEST_ASSERT_EQUAL(1, gestures.size());
+    TEST_ASSERT_EQUAL(Gesture::Click, gestures[0]);
+    TEST_ASSERT_TRUE(decoder->isIdle());
+}
+
+// With no double-click to wait for, a click is out at its release: the
+// latency from the release edge to the gesture is zero, against
+// DOUBLE_CLICK_US otherwise
+void test_click_is_immediate_without_double_click() {
+    decoder->setDoubleClickEnabled(false);
+    bouncyPress(1000 * MS, 100 * MS);
+    std::vector<Gesture> gestures = pollAll(1100 * MS);
+    TEST_ASSERT_EQUAL(1, gestures.size());
+    TEST_ASSERT_EQUAL(Gesture::Click, gestures[0]);
+    TEST_ASSERT_TRUE(decoder->isIdle());
+
+    // Two quick presses are two clicks, each at its own release
+    bouncyPress(2000 * MS, 80 * MS);
+    TEST_ASSERT_EQUAL(Gesture::Click, decoder->poll(2080 * MS));
+    bouncyPress(2150 * MS, 80 * MS);
+    TEST_ASSERT_EQUAL(Gesture::Click, decoder->poll(2230 * MS));
+    TEST_ASSERT_TRUE(pollAll(3000 * MS).empty());
+
+    // Long press is unchanged
+    decoder->edge(true, 4000 * MS);
+    TEST_ASSERT_EQUAL(Gesture::LongPress, decoder->poll(4000 * MS + GestureDecoder::LONG_PRESS_US));
+}
+
+// Turning double-click off inside the window releases the waiting click
+void test_disabling_double_click_flushes_a_waiting_click() {
+    bouncyPress(1000 * MS, 100 * MS);
+    TEST_ASSERT_TRUE(pollAll(1150 * MS).empty());
+    decoder->setDoubleClickEnabled(false);
+    TEST_ASSERT_EQUAL(Gesture::Click, decoder->poll(1155 * MS));
+}
+
+void test_double_click() {
+    bouncyPress(1000 * MS, 80 * MS);
+    bouncyPress(1200 * MS, 80 * MS);
+    std::vector<Gesture> gestures = pollAll(2000 * MS);
+    TEST_ASSERT_EQUAL(1, gestures.size());
+    TEST_ASSERT_EQUAL(Gesture::DoubleClick, gestures[0]);
+}
+
+// Reported while still held, and the release that follows reports nothing
+void test_long_press() {
+    decoder->edge(true, 1000 * MS);
+    TEST_ASSERT_TRUE(pollAll(1000 * MS + GestureDecoder::LONG_PRESS_US - 1).empty());
+    std::vector<Gesture> gestures = pollAll(1000 * MS + GestureDecoder::LONG_PRESS_US);
+    TEST_ASSERT_EQUAL(1, gestures.size());
+    TEST_ASSERT_EQUAL(Gesture::LongPress, gestures[0]);
+    TEST_ASSERT_TRUE(decoder->isPressed());
+    decoder->edge(false, 3000 * MS);
+    TEST_ASSERT_TRUE(pollAll(4000 * MS).empty());
+}
+
+// A bounce that ends on the other level is taken when the lockout ends
+void test_bounce_ending_released_is_not_lost() {
+    decoder->edge(true, 1000 * MS);
+    decoder->edge(false, 1010 * MS);
+    TEST_ASSERT_TRUE(decoder->isPressed());
+    pollAll(1000 * MS + GestureDecoder::DEBOUNCE_US);
+    TEST_ASSERT_FALSE(decoder->isPressed());
+    // The 30 ms press counts as a click
+    std::vector<Gesture> gestures = pollAll(1030 * MS + GestureDecoder::DOUBLE_CLICK_US);
+    TEST_ASSERT_EQUAL(1, gestures.size());
+    TEST_ASSERT_EQUAL(Gesture::Click, gestures[0]);
+}
+
+void test_timing_across_the_micros_wrap() {
+    uint32_t start = 0xFFFFFFFFUL - 50 * MS;
+    bouncyPress(start, 100 * MS);
+    std::vector<Gesture> gestures = pollAll(start + 100 * MS + GestureDecoder::DOUBLE_CLICK_US);
+    TEST_ASSERT_EQUAL(1, gestures.size());
+    TEST_ASSERT_EQUAL(Gesture::Click, gestures[0]);
+
+    start += 1000 * MS;
+    decoder->edge(true, start);
+    TEST_ASSERT_TRUE(pollAll(start + GestureDecoder::LONG_PRESS_US / 2).empty());
+    TEST_ASSERT_EQUAL(Gesture::LongPress, decoder->poll(start + GestureDecoder::LONG_PRESS_US));
+}
+
+// A turn only counts while held, and suppresses the click it would have been
+void test_press_and_turn() {
+    decoder->turn();
+    TEST_ASSERT_TRUE(pollAll(0).empty());
+
+    decoder->edge(true, 1000 * MS);
+    pollAll(1100 * MS);
+    decoder->turn();
+    TEST_ASSERT_TRUE(decoder->isTurning());
+    decoder->turn();
+    decoder->edge(false, 2000 * MS);
+    std::vector<Gesture> gestures = pollAll(3000 * MS);
+    TEST_ASSERT_EQUAL(2, gestures.size());
+    TEST_ASSERT_EQUAL(Gesture::TurnStart, gestures[0]);
+    TEST_ASSERT_EQUAL(Gesture::TurnEnd, gestures[1]);
+    TEST_ASSERT_TRUE(decoder->isIdle());
+}
+
+// Edges drained late, as after a stalled loop, still give every gesture in
+// order, one per poll
+void test_gestures_queue_between_polls() {
+    bouncyPress(1000 * MS, 80 * MS);
+    bouncyPress(1200 * MS, 80 * MS);
+    decoder->edge(true, 2000 * MS);
+    decoder->turn();
+    decoder->edge(false, 2500 * MS);
+    TEST_ASSERT_EQUAL(Gesture::DoubleClick, decoder->poll(2600 * MS));
+    TEST_ASSERT_EQUAL(Gesture::TurnStart, decoder->poll(2605 * MS));
+    TEST_ASSERT_EQUAL(Gesture::TurnEnd, decoder->poll(2610 * MS));
+    TEST_ASSERT_EQUAL(Gesture::None, decoder->poll(2615 * MS));
+    TEST_ASSERT_EQUAL(0, decoder->getDroppedCount());
+}
+
+// Past QUEUE_SIZE unpolled gestures the oldest are dropped and counted
+void test_full_queue_drops_the_oldest() {
+    const int gestures = GestureDecoder::QUEUE_SIZE + 2;
+    for (int i = 0; i < gestures; i++) {
+        bouncyPress((1000 + i * 500) * MS, 80 * MS);
+        bouncyPress((1200 + i * 500) * MS, 80 * MS);
+    }
+    decoder->edge(true, 5000 * MS);
+    decoder->turn();
+    std::vector<Gesture> queued = pollAll(5001 * MS);
+    TEST_ASSERT_EQUAL(GestureDecoder::QUEUE_SIZE, queued.size());
+    TEST_ASSERT_EQUAL(Gesture::TurnStart, queued.back());
+    TEST_ASSERT_EQUAL(gestures + 1 - GestureDecoder::QUEUE_SIZE, decoder->getDroppedCount());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_click_waits_out_the_double_click_window);
+    RUN_TEST(test_click_is_immediate_without_double_click);
+    RUN_TEST(test_disabling_double_click_flushes_a_waiting_click);
+    RUN_TEST(test_double_click);
+    RUN_TEST(test_long_press);
+    RUN_TEST(test_bounce_ending_released_is_not_lost);
+    RUN_TEST(test_timing_across_the_micros_wrap);
+    RUN_TEST(test_press_and_turn);
+    RUN_TEST(test_gestures_queue_between_polls);
+    RUN_TEST(test_full_queue_drops_the_oldest);
+    return UNITY_END();
+}
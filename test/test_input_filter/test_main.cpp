@@ -0,0 +1,239 @@
+// Pot filter harness: each candidate filter gets the same pot signal, sampled
+// the way the lamp samples it (a PotSampler sweep every 5 ms, ControlLoop's
+// mapping and one filter update per 20 ms sense tick), with ADC noise from a
+// noise profile added. For each filter and profile it reports the step
+// response (time to 90% and to settle within the dead-band) and the
+// steady-state jitter at rest.
+//
+// The built-in profiles are synthetic. To use a real one, leave the pots at
+// rest, capture GET /trace and run with NOISE_TRACE=<file>: the AdcSweep
+// records, less each pot's mean, become an extra profile
+#include <unity.h>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "InputFilter.h"
+#include "PotSampler.h"
+#include "TraceReplay.h"
+
+namespace {
+
+constexpr uint32_t SWEEP_MS = PotSampler::DEFAULT_PERIOD_MS;
+constexpr uint32_t SENSE_MS = 20;
+constexpr int LOW_MV = 200;
+constexpr int HIGH_MV = 800;
+constexpr uint32_t REST_MS = 10000;
+constexpr uint32_t STEP_AT_MS = 2000;
+constexpr uint32_t STEP_RUN_MS = 3000;
+
+// Millivolts of noise per 5 ms sweep
+struct NoiseProfile {
+    const char* name;
+    std::vector<int> samples;
+};
+
+int toCodes(int milliVolts) {
+    return map(constrain(milliVolts, 5, 950), 5, 950, 0, 2047);
+}
+
+// Quantized white noise, sigma in millivolts
+NoiseProfile whiteNoise(const char* name, double sigma, uint32_t seed) {
+    std::mt19937 random(seed);
+    std::normal_distribution<double> noise(0, sigma);
+    NoiseProfile profile = {name, {}};
+    for (uint32_t t = 0; t < REST_MS; t += SWEEP_MS) {
+        profile.samples.push_back(static_cast<int>(std::lround(noise(random))));
+    }
+    return profile;
+}
+
+// Mains pickup just off 50 Hz, so 5 ms sampling doesn't cancel it and it
+// beats slowly through the sweep average
+NoiseProfile mainsHum() {
+    NoiseProfile profile = whiteNoise("mains hum", 2, 3);
+    for (size_t i = 0; i < profile.samples.size(); i++) {
+        double t = i * SWEEP_MS / 1000.0;
+        profile.samples[i] += static_cast<int>(std::lround(5 * std::sin(2 * PI * 49.7 * t)));
+    }
+    return profile;
+}
+
+// Radio bursts: a sweep now and then lands during a transmit and reads high
+NoiseProfile radioBursts() {
+    NoiseProfile profile = whiteNoise("radio bursts", 2, 4);
+    std::mt19937 random(5);
+    std::uniform_real_distribution<double> chance(0, 1);
+    for (int& sample : profile.samples) {
+        if (chance(random) < 0.03) {
+            sample += 15 + static_cast<int>(chance(random) * 15);
+        }
+    }
+    return profile;
+}
+
+bool loadNoiseTrace(const char* path, NoiseProfile& profile) {
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    std::vector<uint8_t> bytes;
+    uint8_t chunk[4096];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        bytes.insert(bytes.end(), chunk, chunk + read);
+    }
+    fclose(file);
+    std::vector<Trace::Record> records;
+    if (!TraceReplay::parse(bytes.data(), bytes.size(), records)) {
+        return false;
+    }
+    // Every pot's samples in turn, each about its own mean
+    profile = {path, {}};
+    for (int pot = 0; pot < PotSampler::NUM_POTS; pot++) {
+        std::vector<int> values;
+        for (const Trace::Record& record : records) {
+            if (record.type == static_cast<uint8_t>(Trace::Type::AdcSweep)) {
+                values.push_back(record.values[pot]);
+            }
+        }
+        double mean = 0;
+        for (int value : values) {
+            mean += value;
+        }
+        mean /= values.empty() ? 1 : values.size();
+        for (int value : values) {
+            profile.samples.push_back(static_cast<int>(std::lround(value - mean)));
+        }
+    }
+    return !profile.samples.empty();
+}
+
+struct Result {
+    uint32_t rise90Ms;    // From the step to 90% of the way
+    uint32_t settleMs;    // From the step until it stays within the dead-band of the final value
+    int jitterPeakToPeak; // Output codes at rest, after the filter has settled
+    double jitterRms;
+};
+
+// Runs one filter over millivolts(t) plus noise; out receives each output
+template <typename Filter, typename Signal>
+void run(Filter& filter, const NoiseProfile& noise, uint32_t durationMs, Signal millivolts, std::vector<int>& out) {
+    PotSampler sampler(0, 0, 0);
+    size_t next = 0;
+    for (uint32_t t = 0; t < durationMs; t += SWEEP_MS) {
+        int sample = millivolts(t) + noise.samples[next++ % noise.samples.size()];
+        sampler.pushSample(0, static_cast<uint16_t>(constrain(sample, 0, 1100)));
+        if (t % SENSE_MS == 0) {
+            out.push_back(filter.update(toCodes(sampler.read(0)), t));
+        }
+    }
+}
+
+template <typename Filter>
+Result measure(const NoiseProfile& noise) {
+    Result result = {};
+    const int deadBand = HysteresisConfig().noiseThreshold;
+
+    Filter resting;
+    std::vector<int> rest;
+    run(resting, noise, REST_MS, [](uint32_t) { return LOW_MV; }, rest);
+    // Skip the first second while the filter fills
+    int low = rest[1000 / SENSE_MS], high = low;
+    double sum = 0, squares = 0;
+    int count = 0;
+    for (size_t i = 1000 / SENSE_MS; i < rest.size(); i++) {
+        low = rest[i] < low ? rest[i] : low;
+        high = rest[i] > high ? rest[i] : high;
+        sum += rest[i];
+        squares += static_cast<double>(rest[i]) * rest[i];
+        count++;
+    }
+    double mean = sum / count;
+    result.jitterPeakToPeak = high - low;
+    result.jitterRms = std::sqrt(squares / count - mean * mean);
+
+    Filter stepped;
+    std::vector<int> step;
+    run(stepped, noise, STEP_AT_MS + STEP_RUN_MS, [](uint32_t t) { return t < STEP_AT_MS ? LOW_MV : HIGH_MV; }, step);
+    int from = toCodes(LOW_MV), to = toCodes(HIGH_MV);
+    int first = STEP_AT_MS / SENSE_MS;
+    result.rise90Ms = STEP_RUN_MS;
+    for (size_t i = first; i < step.size(); i++) {
+        if (step[i] >= from + (to - from) * 9 / 10) {
+            result.rise90Ms = (i - first) * SENSE_MS;
+            break;
+        }
+    }
+    result.settleMs = STEP_RUN_MS;
+    for (size_t i = step.size(); i-- > static_cast<size_t>(first);) {
+        if (abs(step[i] - to) > deadBand) {
+            result.settleMs = (i + 1 - first) * SENSE_MS;
+            break;
+        }
+        result.settleMs = (i - first) * SENSE_MS;
+    }
+    return result;
+}
+
+void report(const char* filter, const NoiseProfile& noise, const Result& result) {
+    char line[200];
+    snprintf(line, sizeof(line), "%-14s %-14s rise90 %4u ms, settle %4u ms, jitter p-p %3d codes, rms %5.2f",
+             filter, noise.name, result.rise90Ms, result.settleMs, result.jitterPeakToPeak, result.jitterRms);
+    TEST_MESSAGE(line);
+}
+
+std::vector<NoiseProfile> profiles() {
+    std::vector<NoiseProfile> all = {whiteNoise("quiet", 2, 1), whiteNoise("noisy", 5, 2), mainsHum(), radioBursts()};
+    const char* path = getenv("NOISE_TRACE");
+    NoiseProfile recorded;
+    if (path != nullptr) {
+        TEST_ASSERT_TRUE_MESSAGE(loadNoiseTrace(path, recorded), path);
+        all.push_back(recorded);
+    }
+    return all;
+}
+
+}
+
+void setUp() {}
+void tearDown() {}
+
+// The filter ControlLoop uses. At rest its jitter must stay inside the
+// default dead-band on every profile, or the lamp would flicker on its own
+void test_moving_average() {
+    for (const NoiseProfile& noise : profiles()) {
+        Result result = measure<MovingAverageFilter<8>>(noise);
+        report("moving avg 8", noise, result);
+        TEST_ASSERT_LESS_THAN(HysteresisConfig().noiseThreshold, result.jitterPeakToPeak);
+        TEST_ASSERT_LESS_OR_EQUAL(200, result.rise90Ms);
+    }
+}
+
+void test_iir() {
+    for (const NoiseProfile& noise : profiles()) {
+        Result shift2 = measure<IirFilter<2>>(noise);
+        Result shift3 = measure<IirFilter<3>>(noise);
+        report("iir >>2", noise, shift2);
+        report("iir >>3", noise, shift3);
+        // A heavier pole trades latency for quiet
+        TEST_ASSERT_GREATER_OR_EQUAL(shift2.rise90Ms, shift3.rise90Ms);
+        TEST_ASSERT_TRUE(shift3.jitterRms <= shift2.jitterRms);
+    }
+}
+
+void test_one_euro() {
+    for (const NoiseProfile& noise : profiles()) {
+        Result result = measure<OneEuroFilter>(noise);
+        report("one euro", noise, result);
+        TEST_ASSERT_LESS_OR_EQUAL(STEP_RUN_MS / 2, result.settleMs);
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_moving_average);
+    RUN_TEST(test_iir);
+    RUN_TEST(test_one_euro);
+    return UNITY_END();
+}
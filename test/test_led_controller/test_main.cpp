@@ -0,0 +1,231 @@
+// LEDController entry points against the fake Hal: which ones honour the
+// pot dead-band, what they count in Metrics, and how closely the integer
+// output path tracks the float math it replaced
+#include <unity.h>
+#include "LEDController.h"
+#include "ColorEngine.h"
+#include "HalFake.h"
+#include "Metrics.h"
+
+namespace {
+
+SettingsStore* settings;
+LEDController* led;
+
+int redLevel() {
+    int red, green, blue;
+    led->getPWMValues(red, green, blue);
+    return red;
+}
+
+// The 16-bit target the dither stage is working from. Over FRACTION_ONE
+// ticks a first-order sigma-delta emits exactly its target, so the sum of
+// the latched duties recovers it from the outside
+uint32_t ditherTarget(int channel) {
+    uint32_t sum = 0;
+    for (uint32_t tick = 0; tick < (1UL << 5); tick++) {
+        Hal::Fake::advanceMicros(500);
+        sum += Hal::Fake::latchedDuty(channel);
+    }
+    return sum;
+}
+
+// The output path in double precision: curve and trim, master level, then
+// the governor's budget shared across the channels
+void floatReference(const int levels[3], uint32_t master, uint32_t budgetQ16, double out[3]) {
+    const float trims[3] = {RED_TRIM, GREEN_TRIM, BLUE_TRIM};
+    double total = 0;
+    for (int i = 0; i < 3; i++) {
+        out[i] = static_cast<double>(cieLightnessCurve(levels[i] / 2047.0f)) * trims[i] * LUT_FULL_SCALE *
+                 master / PowerGovernor::FULL_POWER_Q16;
+        total += out[i];
+    }
+    double requested = total / (3.0 * LUT_FULL_SCALE);
+    double budget = static_cast<double>(budgetQ16) / PowerGovernor::FULL_POWER_Q16;
+    double scale = requested > budget ? budget / requested : 1.0;
+    for (int i = 0; i < 3; i++) {
+        out[i] *= scale;
+    }
+}
+
+// Settles the dead-band at a level, idle long enough to be at its widest
+void settleAt(int level) {
+    led->setPWMDirectly(level, level, level);
+    Hal::Fake::advanceMillis(HysteresisConfig().idleTimeThreshold + 1000);
+    led->setPWMDirectly(level, level, level);
+}
+
+}
+
+void setUp() {
+    Hal::Fake::reset();
+    settings = new SettingsStore();
+    settings->begin();
+    led = new LEDController(*settings);
+    led->begin();
+}
+
+void tearDown() {
+    delete led;
+    delete settings;
+}
+
+void test_pot_levels_inside_the_dead_band_are_ignored() {
+    settleAt(1000);
+    int before = redLevel();
+    led->setPWMDirectly(1004, 1004, 1004);
+    TEST_ASSERT_EQUAL_INT(before, redLevel());
+}
+
+void test_network_levels_bypass_the_dead_band() {
+    settleAt(1000);
+    int before = redLevel();
+    led->setLevels(1004, 1004, 1004);
+    TEST_ASSERT_NOT_EQUAL(before, redLevel());
+    led->setLevels(1000, 1000, 1000);
+    TEST_ASSERT_EQUAL_INT(before, redLevel());
+}
+
+void test_network_levels_cancel_a_fade() {
+    led->fadeTo(2047, 2047, 2047, 1000);
+    TEST_ASSERT_TRUE(led->isFading());
+    led->setLevels(10, 10, 10);
+    TEST_ASSERT_FALSE(led->isFading());
+}
+
+// A CCT write bypasses the input levels, but a fade that follows starts
+// from what it left on the LEDs: the first frame moves less than one LUT
+// step plus the first 5 ms of the ease
+void test_fade_after_cct_starts_where_cct_left_off() {
+    ColorEngine engine(*settings);
+    const int cases[][3] = {{800, 2700, 0}, {1500, 6500, 50}, {200, 4000, -100}};
+    for (const int* cct : cases) {
+        led->setLevels(2000, 30, 2000);
+        uint32_t duties[3];
+        engine.cctToDuties(cct[0], cct[1], cct[2], duties);
+        led->setLinearDuties(duties);
+        int before[3];
+        led->getPWMValues(before[0], before[1], before[2]);
+
+        led->fadeTo(0, 2047, 0, 1000);
+        Hal::Fake::advanceMillis(5);
+        led->update();
+        int after[3];
+        led->getPWMValues(after[0], after[1], after[2]);
+        for (int ch = 0; ch < 3; ch++) {
+            char message[64];
+            snprintf(message, sizeof(message), "channel %d after CCT %d/%d/%d", ch, cct[0], cct[1], cct[2]);
+            TEST_ASSERT_INT_WITHIN_MESSAGE(2, before[ch], after[ch], message);
+        }
+    }
+}
+
+// Every duty maps back to the level whose table entry is nearest
+void test_level_for_duty_inverts_the_tables() {
+    const ChannelLut* luts[3] = {&RED_LUT, &GREEN_LUT, &BLUE_LUT};
+    for (const ChannelLut* lut : luts) {
+        for (int level = 0; level < LUT_SIZE; level += 7) {
+            TEST_ASSERT_EQUAL_UINT16(lut->values[level], lut->values[levelForDuty(*lut, lut->values[level])]);
+        }
+        auto distance = [&](int level, uint32_t duty) { return abs(static_cast<int32_t>(lut->values[level] - duty)); };
+        for (uint32_t duty = 0; duty <= LUT_FULL_SCALE; duty += 97) {
+            int level = levelForDuty(*lut, duty);
+            TEST_ASSERT_TRUE(level == 0 || distance(level, duty) <= distance(level - 1, duty));
+            TEST_ASSERT_TRUE(level == LUT_SIZE - 1 || distance(level, duty) <= distance(level + 1, duty));
+        }
+    }
+}
+
+// setPwmCalls and deadbandPasses only count pot levels, so their ratio is
+// the share of pot updates the dead-band let through
+void test_dead_band_counters_only_count_pot_levels() {
+    settleAt(1000);
+    uint32_t calls = Metrics::setPwmCalls.get();
+    uint32_t passes = Metrics::deadbandPasses.get();
+    led->setPWMDirectly(1004, 1004, 1004);
+    led->setPWMDirectly(1500, 1500, 1500);
+    led->setLevels(200, 200, 200);
+    const uint32_t duties[3] = {0, 0, 0};
+    led->setLinearDuties(duties);
+    TEST_ASSERT_EQUAL_UINT32(calls + 2, Metrics::setPwmCalls.get());
+    TEST_ASSERT_EQUAL_UINT32(passes + 1, Metrics::deadbandPasses.get());
+}
+
+// What /hysteresis ends up calling: the new band applies at once and
+// survives a reboot
+void test_hysteresis_applies_and_persists() {
+    HysteresisConfig wide;
+    wide.noiseThreshold = 60;
+    wide.minThreshold = 10;
+    wide.idleTimeThreshold = 1000;
+    for (int channel = 0; channel < 3; channel++) {
+        led->setHysteresis(channel, wide);
+    }
+    settleAt(1000);
+    int before = redLevel();
+    led->setPWMDirectly(1040, 1040, 1040);
+    TEST_ASSERT_EQUAL_INT(before, redLevel());
+
+    settings->flush(Hal::nowMillis(), true);
+    SettingsStore reloaded;
+    reloaded.begin();
+    LEDController rebooted(reloaded);
+    rebooted.begin();
+    TEST_ASSERT_EQUAL_INT(60, rebooted.getHysteresis(2).noiseThreshold);
+    TEST_ASSERT_EQUAL_UINT32(1000, rebooted.getHysteresis(2).idleTimeThreshold);
+}
+
+// Every timer callback lands in the dither tick summary
+void test_dither_ticks_are_timed() {
+    uint32_t before = Metrics::ditherTick.count.load();
+    Hal::Fake::advanceMillis(10);
+    TEST_ASSERT_EQUAL_UINT32(before + 20, Metrics::ditherTick.count.load());
+}
+
+// LUT lookup plus the Q16 master and governor scaling in commitOutputs,
+// against floatReference, over a sweep of levels, master levels and both
+// power profiles (the locked one derates white, the unlocked one doesn't)
+void test_integer_path_matches_float_reference() {
+    const uint32_t masters[] = {PowerGovernor::FULL_POWER_Q16, 40000, PowerGovernor::FULL_POWER_Q16 / 20};
+    int worst = 0;
+    for (int profile = 0; profile < 2; profile++) {
+        if (profile == 1) {
+            led->unlock();
+        }
+        for (uint32_t master : masters) {
+            led->setMasterLevel(master);
+            for (int step = 0; step <= 64; step++) {
+                const int levels[3] = {step * 2047 / 64, (step * 37) % 2048, 2047 - step * 2047 / 64};
+                led->setLevels(levels[0], levels[1], levels[2]);
+                double expected[3];
+                floatReference(levels, master, led->getGovernor().budget(), expected);
+                for (int ch = 0; ch < 3; ch++) {
+                    int target = static_cast<int>(ditherTarget(ch));
+                    int reference = static_cast<int>(expected[ch] + 0.5);
+                    worst = abs(target - reference) > worst ? abs(target - reference) : worst;
+                    char message[96];
+                    snprintf(message, sizeof(message), "channel %d levels %d/%d/%d master %u", ch, levels[0],
+                             levels[1], levels[2], master);
+                    TEST_ASSERT_INT_WITHIN_MESSAGE(1, reference, target, message);
+                }
+            }
+        }
+    }
+    char summary[64];
+    snprintf(summary, sizeof(summary), "worst error %d LSB of the 16-bit target", worst);
+    TEST_MESSAGE(summary);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_pot_levels_inside_the_dead_band_are_ignored);
+    RUN_TEST(test_network_levels_bypass_the_dead_band);
+    RUN_TEST(test_network_levels_cancel_a_fade);
+    RUN_TEST(test_fade_after_cct_starts_where_cct_left_off);
+    RUN_TEST(test_level_for_duty_inverts_the_tables);
+    RUN_TEST(test_dead_band_counters_only_count_pot_levels);
+    RUN_TEST(test_hysteresis_applies_and_persists);
+    RUN_TEST(test_dither_ticks_are_timed);
+    RUN_TEST(test_integer_path_matches_float_reference);
+    return UNITY_END();
+}
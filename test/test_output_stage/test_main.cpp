@@ -0,0 +1,163 @@
+// Output stage: the sigma-delta snapshot the dither tick works from, and the
+// PWM latch guard PwmOutput derives from measured latch times
+#include <unity.h>
+#include <atomic>
+#include <thread>
+#include "SigmaDeltaDither.h"
+#include "PwmOutput.h"
+#include "HalFake.h"
+
+namespace {
+
+using Dither = SigmaDeltaDither<3, 5>;
+using Output = PwmOutput<7, 6, 5>;
+
+void setAll(Dither& dither, uint16_t a, uint16_t b, uint16_t c) {
+    const uint16_t targets[3] = {a, b, c};
+    dither.setTargets(targets);
+}
+
+}
+
+void setUp() {
+    Hal::Fake::reset();
+}
+
+void tearDown() {}
+
+void test_dither_average_matches_target() {
+    Dither dither;
+    setAll(dither, (100 << 5) + 7, (2047 << 5), 13);
+    dither.latch();
+    uint32_t sums[3] = {};
+    for (uint32_t i = 0; i < Dither::FRACTION_ONE * 8; i++) {
+        for (int ch = 0; ch < 3; ch++) {
+            sums[ch] += dither.next(ch);
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32(((100 << 5) + 7) * 8, sums[0]);
+    TEST_ASSERT_EQUAL_UINT32((2047 << 5) * 8, sums[1]);
+    TEST_ASSERT_EQUAL_UINT32(13 * 8, sums[2]);
+}
+
+void test_tick_keeps_its_snapshot_until_next_latch() {
+    Dither dither;
+    setAll(dither, 10 << 5, 20 << 5, 30 << 5);
+    dither.latch();
+    setAll(dither, 40 << 5, 50 << 5, 60 << 5);
+    TEST_ASSERT_EQUAL_UINT32(10, dither.next(0));
+    TEST_ASSERT_EQUAL_UINT32(20, dither.next(1));
+    TEST_ASSERT_EQUAL_UINT32(30, dither.next(2));
+    dither.latch();
+    TEST_ASSERT_EQUAL_UINT32(40, dither.next(0));
+    TEST_ASSERT_EQUAL_UINT32(60, dither.next(2));
+}
+
+void test_latest_write_wins() {
+    Dither dither;
+    for (uint16_t i = 1; i <= 5; i++) {
+        setAll(dither, i, i, i);
+    }
+    dither.latch();
+    TEST_ASSERT_EQUAL_UINT16(5, dither.getLatched(0));
+    TEST_ASSERT_EQUAL_UINT16(5, dither.getLatched(2));
+}
+
+// The writer publishes equal targets on every channel; a latched set with
+// mixed values would be a torn snapshot. On a multi-core host the writer
+// really does lap the reader, which the C3 never lets happen
+void test_snapshot_never_tears_under_a_concurrent_writer() {
+    Dither dither;
+    std::atomic<bool> done{false};
+    std::thread writer([&] {
+        for (uint32_t i = 0; i < 2000000; i++) {
+            uint16_t value = static_cast<uint16_t>(i);
+            setAll(dither, value, value, value);
+        }
+        done.store(true);
+    });
+    uint32_t torn = 0;
+    uint32_t latches = 0;
+    while (!done.load()) {
+        dither.latch();
+        latches++;
+        if (dither.getLatched(0) != dither.getLatched(1) || dither.getLatched(1) != dither.getLatched(2)) {
+            torn++;
+        }
+    }
+    writer.join();
+    TEST_ASSERT_GREATER_THAN_UINT32(0, latches);
+    TEST_ASSERT_EQUAL_UINT32(0, torn);
+}
+
+void test_initial_guard_covers_latch_guard_us() {
+    Output output;
+    TEST_ASSERT_TRUE(output.begin(19000, 11));
+    // 2 us of a 19 kHz, 11-bit timer is 77.8 ticks
+    TEST_ASSERT_EQUAL_UINT32(2048 - 78, output.getLatestTick());
+}
+
+void test_guard_grows_to_twice_the_slowest_latch() {
+    Output output;
+    output.begin(19000, 11);
+    Hal::Fake::setLatchTiming(100, 40);
+    output.stage(0, 1);
+    TEST_ASSERT_TRUE(output.commit());
+    // 81 ticks is wider than the 78-tick starting guard
+    TEST_ASSERT_EQUAL_UINT32(40, output.getWorstLatchTicks());
+    TEST_ASSERT_EQUAL_UINT32(2048 - 81, output.getLatestTick());
+    TEST_ASSERT_EQUAL_INT32(40, Metrics::pwmLatchTicksMax.get());
+
+    // A faster latch never narrows it again
+    Hal::Fake::setLatchTiming(100, 5);
+    output.stage(1, 1);
+    output.commit();
+    TEST_ASSERT_EQUAL_UINT32(2048 - 81, output.getLatestTick());
+}
+
+void test_latch_across_the_period_counts_a_wrap() {
+    Output output;
+    output.begin(19000, 11);
+    uint32_t wrapsBefore = Metrics::pwmLatchWraps.get();
+    Hal::Fake::setLatchTiming(1900, 300);
+    output.stage(2, 1);
+    output.commit();
+    TEST_ASSERT_EQUAL_UINT32(wrapsBefore + 1, Metrics::pwmLatchWraps.get());
+    TEST_ASSERT_EQUAL_UINT32(300, output.getWorstLatchTicks());
+    TEST_ASSERT_EQUAL_UINT32(2048 - 601, output.getLatestTick());
+
+    // The wider guard keeps the same latch inside one period from now on
+    output.stage(2, 2);
+    output.commit();
+    TEST_ASSERT_EQUAL_UINT32(wrapsBefore + 1, Metrics::pwmLatchWraps.get());
+}
+
+void test_guard_is_capped_at_half_a_period() {
+    Output output;
+    output.begin(19000, 11);
+    Hal::Fake::setLatchTiming(0, 1500);
+    output.stage(0, 1);
+    output.commit();
+    TEST_ASSERT_EQUAL_UINT32(1024, output.getLatestTick());
+}
+
+void test_commit_without_staged_channels_is_a_no_op() {
+    Output output;
+    output.begin(19000, 11);
+    TEST_ASSERT_FALSE(output.commit());
+    TEST_ASSERT_EQUAL_UINT32(0, Hal::Fake::latchCount());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_dither_average_matches_target);
+    RUN_TEST(test_tick_keeps_its_snapshot_until_next_latch);
+    RUN_TEST(test_latest_write_wins);
+    RUN_TEST(test_snapshot_never_tears_under_a_concurrent_writer);
+    RUN_TEST(test_initial_guard_covers_latch_guard_us);
+    RUN_TEST(test_guard_grows_to_twice_the_slowest_latch);
+    RUN_TEST(test_latch_across_the_period_counts_a_wrap);
+    RUN_TEST(test_guard_is_capped_at_half_a_period);
+    RUN_TEST(test_commit_without_staged_channels_is_a_no_op);
+    return UNITY_END();
+}
@@ -0,0 +1,128 @@
+// PerceptualLut tables as LEDController builds them: every step of the knob
+// moves the duty the right way, each entry matches the L* curve computed in
+// double precision, and a lookup is cheaper than evaluating the curve
+#include <unity.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include "LEDController.h"
+
+namespace {
+
+struct Table {
+    const char* name;
+    const ChannelLut& lut;
+    double trim;
+};
+
+const Table TABLES[] = {
+    {"red", RED_LUT, RED_TRIM},
+    {"green", GREEN_LUT, GREEN_TRIM},
+    {"blue", BLUE_LUT, BLUE_TRIM},
+};
+
+constexpr ChannelLut LINEAR_LUT = makeChannelLut(1.0f, linearCurve);
+
+// CIE 1976 L* inverse in double precision
+double lightnessToLuminance(double x) {
+    double lightness = x * 100.0;
+    if (lightness <= 8.0) {
+        return lightness / 903.3;
+    }
+    double t = (lightness + 16.0) / 116.0;
+    return t * t * t;
+}
+
+volatile uint32_t sink;
+volatile float floatSink;
+
+double nsPerCall(int iterations, void (*body)(int)) {
+    using namespace std::chrono;
+    double samples[7];
+    for (double& sample : samples) {
+        auto start = steady_clock::now();
+        for (int i = 0; i < iterations; i++) {
+            body(i);
+        }
+        sample = duration<double, std::nano>(steady_clock::now() - start).count() / iterations;
+    }
+    std::sort(samples, samples + 7);
+    return samples[3];
+}
+
+void lookup(int i) {
+    sink = RED_LUT.values[i % 2048] + GREEN_LUT.values[(i * 7) % 2048] + BLUE_LUT.values[(i * 13) % 2048];
+}
+
+void evaluate(int i) {
+    floatSink = cieLightnessCurve((i % 2048) / 2047.0f) * RED_TRIM * LUT_FULL_SCALE +
+                cieLightnessCurve(((i * 7) % 2048) / 2047.0f) * GREEN_TRIM * LUT_FULL_SCALE +
+                cieLightnessCurve(((i * 13) % 2048) / 2047.0f) * BLUE_TRIM * LUT_FULL_SCALE;
+}
+
+}
+
+void setUp() {}
+void tearDown() {}
+
+// A turn of the knob may never dim the channel it brightens. The steep end
+// of the curve must also keep moving, or the top of the knob would be dead
+void test_tables_are_monotonic() {
+    for (const Table& table : TABLES) {
+        int flat = 0;
+        for (int i = 1; i < LUT_SIZE; i++) {
+            TEST_ASSERT_GREATER_OR_EQUAL_UINT32(table.lut.values[i - 1], table.lut.values[i]);
+            flat += table.lut.values[i] == table.lut.values[i - 1] ? 1 : 0;
+        }
+        char line[80];
+        snprintf(line, sizeof(line), "%-5s %d flat steps, full scale %u", table.name, flat, table.lut.values[LUT_SIZE - 1]);
+        TEST_MESSAGE(line);
+        TEST_ASSERT_EQUAL(0, flat);
+    }
+    for (int i = 1; i < LUT_SIZE; i++) {
+        TEST_ASSERT_GREATER_THAN_UINT32(LINEAR_LUT.values[i - 1], LINEAR_LUT.values[i]);
+    }
+}
+
+// The tables are built in float at compile time; against the same curve and
+// trim in double they may only be off by rounding
+void test_tables_match_the_double_curve() {
+    for (const Table& table : TABLES) {
+        double worst = 0;
+        int worstAt = 0;
+        for (int i = 0; i < LUT_SIZE; i++) {
+            double expected = lightnessToLuminance(i / 2047.0) * table.trim * LUT_FULL_SCALE;
+            double error = std::fabs(table.lut.values[i] - expected);
+            if (error > worst) {
+                worst = error;
+                worstAt = i;
+            }
+        }
+        char line[80];
+        snprintf(line, sizeof(line), "%-5s max error %.3f LSB at input %d", table.name, worst, worstAt);
+        TEST_MESSAGE(line);
+        TEST_ASSERT_TRUE_MESSAGE(worst <= 1.0, line);
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, RED_LUT.values[0]);
+    TEST_ASSERT_EQUAL_UINT32(LUT_FULL_SCALE, GREEN_LUT.values[LUT_SIZE - 1]);
+    TEST_ASSERT_EQUAL_UINT32(LUT_FULL_SCALE, LINEAR_LUT.values[LUT_SIZE - 1]);
+}
+
+// Relative only: host figures say nothing about the C3, where the curve is
+// soft-float and the gap is far wider
+void test_lookup_is_cheaper_than_the_curve() {
+    double lookupNs = nsPerCall(200000, lookup);
+    double curveNs = nsPerCall(200000, evaluate);
+    char line[120];
+    snprintf(line, sizeof(line), "three channels: lookup %.2f ns, float curve %.2f ns", lookupNs, curveNs);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_TRUE_MESSAGE(lookupNs < curveNs, line);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_tables_are_monotonic);
+    RUN_TEST(test_tables_match_the_double_curve);
+    RUN_TEST(test_lookup_is_cheaper_than_the_curve);
+    return UNITY_END();
+}
@@ -0,0 +1,98 @@
+// PowerGovernor thermal simulation. A float RC model of the heatsink stands
+// in for the lamp and is driven with whatever power the governor allows; the
+// simulated heatsink must never pass CEILING_C, including after a reset while
+// it is still hot, which the governor can't see
+#include <unity.h>
+#include "PowerGovernor.h"
+
+namespace {
+
+constexpr uint32_t TICK_MS = 100;
+
+struct Heatsink {
+    double riseC;
+
+    void step(uint32_t outputQ16, uint32_t elapsedMs) {
+        double target = static_cast<double>(outputQ16) / PowerGovernor::FULL_POWER_Q16 * PowerGovernor::RISE_AT_FULL_C;
+        riseC += (target - riseC) * elapsedMs / PowerGovernor::TIME_CONSTANT_MS;
+    }
+    double celsius() const { return PowerGovernor::AMBIENT_C + riseC; }
+};
+
+struct RunResult {
+    double maxC;
+    uint32_t lastOutputQ16;
+};
+
+// Requests requestedQ16 for durationMs and returns the hottest the heatsink got
+RunResult run(PowerGovernor& governor, Heatsink& heatsink, uint32_t requestedQ16, uint32_t durationMs) {
+    RunResult result = {heatsink.celsius(), 0};
+    for (uint32_t t = 0; t < durationMs; t += TICK_MS) {
+        uint32_t scale = governor.scaleFor(requestedQ16);
+        uint32_t output = static_cast<uint32_t>((static_cast<uint64_t>(requestedQ16) * scale) >> PowerGovernor::FIXED_SHIFT);
+        governor.integrate(output, TICK_MS);
+        heatsink.step(output, TICK_MS);
+        result.maxC = heatsink.celsius() > result.maxC ? heatsink.celsius() : result.maxC;
+        result.lastOutputQ16 = output;
+    }
+    return result;
+}
+
+constexpr uint32_t HOUR_MS = 3600000;
+
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_boots_at_the_sustainable_budget() {
+    PowerGovernor governor;
+    governor.setProfile(PowerGovernor::UNLOCKED);
+    TEST_ASSERT_EQUAL_UINT32(PowerGovernor::SUSTAINABLE_Q16, governor.budget());
+    TEST_ASSERT_TRUE(governor.isDerating());
+    TEST_ASSERT_INT_WITHIN(1, PowerGovernor::CEILING_C * 1000, governor.temperatureMilliC());
+}
+
+// Reset with the heatsink at the ceiling, then full white for an hour
+void test_hot_reset_never_passes_the_ceiling() {
+    PowerGovernor governor;
+    governor.setProfile(PowerGovernor::UNLOCKED);
+    Heatsink heatsink = {PowerGovernor::CEILING_C - PowerGovernor::AMBIENT_C};
+    RunResult result = run(governor, heatsink, PowerGovernor::FULL_POWER_Q16, HOUR_MS);
+    TEST_ASSERT_LESS_OR_EQUAL(PowerGovernor::CEILING_C * 100 + 10, static_cast<int>(result.maxC * 100));
+}
+
+void test_cold_lamp_gets_its_peak_back_and_holds_the_ceiling() {
+    PowerGovernor governor;
+    governor.setProfile(PowerGovernor::UNLOCKED);
+    Heatsink heatsink = {0};
+    // Dark for two time constants: the estimate cools from its pessimistic start
+    run(governor, heatsink, 0, 2 * PowerGovernor::TIME_CONSTANT_MS);
+    TEST_ASSERT_FALSE(governor.isDerating());
+    TEST_ASSERT_EQUAL_UINT32(PowerGovernor::FULL_POWER_Q16, governor.scaleFor(PowerGovernor::FULL_POWER_Q16));
+
+    RunResult result = run(governor, heatsink, PowerGovernor::FULL_POWER_Q16, HOUR_MS);
+    TEST_ASSERT_LESS_OR_EQUAL(PowerGovernor::CEILING_C * 100 + 10, static_cast<int>(result.maxC * 100));
+    // Settles at the power that holds the ceiling
+    TEST_ASSERT_INT_WITHIN(PowerGovernor::SUSTAINABLE_Q16 / 50, PowerGovernor::SUSTAINABLE_Q16, result.lastOutputQ16);
+}
+
+// Locked white is within the sustainable power: it keeps its full budget and
+// settles well below the ceiling
+void test_locked_white_runs_cool() {
+    PowerGovernor governor;
+    Heatsink heatsink = {0};
+    run(governor, heatsink, 0, 2 * PowerGovernor::TIME_CONSTANT_MS);
+    RunResult result = run(governor, heatsink, PowerGovernor::FULL_POWER_Q16, HOUR_MS);
+    TEST_ASSERT_LESS_THAN((PowerGovernor::CEILING_C - 5) * 100, static_cast<int>(result.maxC * 100));
+    TEST_ASSERT_EQUAL_UINT32(PowerGovernor::LOCKED.peakQ16, result.lastOutputQ16);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_boots_at_the_sustainable_budget);
+    RUN_TEST(test_hot_reset_never_passes_the_ceiling);
+    RUN_TEST(test_cold_lamp_gets_its_peak_back_and_holds_the_ceiling);
+    RUN_TEST(test_locked_white_runs_cool);
+    return UNITY_END();
+}
@@ -0,0 +1,136 @@
+// IdlePolicy and PowerManager on the fake clock and GPIO: the idle
+// downclock after 30 s, the settle in OFF before light sleep, and every way
+// back to full speed, including a button press that ends a light sleep
+#include <unity.h>
+#include "PowerManager.h"
+#include "Metrics.h"
+#include "HalFake.h"
+
+namespace {
+
+constexpr int BUTTON_PIN = 9;
+constexpr int REST_POTS[3] = {500, 1000, 1500};
+
+PotSampler* sampler;
+PowerManager* power;
+
+IdleInputs inputs(bool off = false, int potOffset = 0) {
+    IdleInputs in = {off, false, true, {REST_POTS[0] + potOffset, REST_POTS[1], REST_POTS[2]}};
+    return in;
+}
+
+// Control ticks every 5 ms for ms, as main.cpp runs them
+PowerState runFor(uint32_t ms, const IdleInputs& in) {
+    PowerState state = power->getState();
+    for (uint32_t t = 0; t < ms; t += 5) {
+        Hal::Fake::advanceMillis(5);
+        state = power->update(Hal::nowMillis(), in);
+    }
+    return state;
+}
+
+}
+
+void setUp() {
+    Hal::Fake::reset();
+    sampler = new PotSampler(4, 3, 0);
+    power = new PowerManager(BUTTON_PIN, *sampler);
+    power->begin();
+}
+
+void tearDown() {
+    delete power;
+    delete sampler;
+}
+
+void test_downclocks_after_idle_time() {
+    TEST_ASSERT_EQUAL(PowerState::Active, runFor(IdlePolicy::IDLE_AFTER_MS - 10, inputs()));
+    TEST_ASSERT_EQUAL_UINT32(PowerManager::FULL_MHZ, Hal::Fake::cpuMhz());
+    TEST_ASSERT_EQUAL(PowerState::Downclocked, runFor(20, inputs()));
+    TEST_ASSERT_EQUAL_UINT32(PowerManager::IDLE_MHZ, Hal::Fake::cpuMhz());
+    TEST_ASSERT_EQUAL_UINT32(PowerManager::IDLE_SAMPLE_PERIOD_MS, sampler->getPeriod());
+}
+
+// Filtered noise stays below the wake threshold; a real turn restores the
+// clock on the tick that sees it
+void test_pot_turn_wakes_but_noise_does_not() {
+    runFor(IdlePolicy::IDLE_AFTER_MS + 10, inputs());
+    TEST_ASSERT_EQUAL(PowerState::Downclocked,
+                      runFor(1000, inputs(false, IdlePolicy::POT_WAKE_THRESHOLD)));
+    Hal::Fake::advanceMillis(5);
+    TEST_ASSERT_EQUAL(PowerState::Active,
+                      power->update(Hal::nowMillis(), inputs(false, IdlePolicy::POT_WAKE_THRESHOLD + 1)));
+    TEST_ASSERT_EQUAL_UINT32(PowerManager::FULL_MHZ, Hal::Fake::cpuMhz());
+    TEST_ASSERT_EQUAL_UINT32(PotSampler::DEFAULT_PERIOD_MS, sampler->getPeriod());
+}
+
+void test_button_and_serving_keep_full_speed() {
+    IdleInputs held = inputs();
+    held.buttonIdle = false;
+    TEST_ASSERT_EQUAL(PowerState::Active, runFor(IdlePolicy::IDLE_AFTER_MS * 2, held));
+    IdleInputs serving = inputs(true);
+    serving.serving = true;
+    TEST_ASSERT_EQUAL(PowerState::Active, runFor(IdlePolicy::IDLE_AFTER_MS * 2, serving));
+}
+
+// OFF settles for OFF_SETTLE_MS, long enough for a click out of it, then
+// sleeps; turning pots in OFF doesn't count as activity
+void test_off_settles_then_sleeps() {
+    runFor(100, inputs());
+    TEST_ASSERT_EQUAL(PowerState::Active, runFor(IdlePolicy::OFF_SETTLE_MS - 10, inputs(true, 300)));
+    TEST_ASSERT_EQUAL(PowerState::LightSleep, runFor(20, inputs(true, 600)));
+    TEST_ASSERT_EQUAL_UINT32(PowerManager::IDLE_MHZ, Hal::Fake::cpuMhz());
+    // Leaving OFF is activity
+    Hal::Fake::advanceMillis(5);
+    TEST_ASSERT_EQUAL(PowerState::Active, power->update(Hal::nowMillis(), inputs()));
+}
+
+void test_timer_wake_stays_asleep() {
+    runFor(IdlePolicy::OFF_SETTLE_MS + 10, inputs(true));
+    uint32_t timerWakes = Metrics::timerWakes.get();
+    uint32_t start = Hal::nowMicros();
+    TEST_ASSERT_FALSE(power->lightSleep());
+    TEST_ASSERT_EQUAL_UINT32(PowerManager::SLEEP_CHUNK_US, Hal::nowMicros() - start);
+    TEST_ASSERT_EQUAL_UINT32(timerWakes + 1, Metrics::timerWakes.get());
+    TEST_ASSERT_EQUAL(PowerState::LightSleep, power->getState());
+    TEST_ASSERT_EQUAL_UINT32(PowerManager::IDLE_MHZ, Hal::Fake::cpuMhz());
+}
+
+// A press during sleep ends it at once; the recorded wake covers the chip's
+// resume and the clock switch, from the press to full speed
+void test_button_wake_restores_full_speed() {
+    const uint32_t EXIT_US = 400, SWITCH_US = 60;
+    Hal::Fake::setPowerTiming(EXIT_US, SWITCH_US);
+    runFor(IdlePolicy::OFF_SETTLE_MS + 10, inputs(true));
+    uint32_t wakes = Metrics::buttonWakeLatency.count.load();
+    uint32_t total = Metrics::buttonWakeLatency.totalMicros.load();
+
+    Hal::Fake::pressDuringSleep(BUTTON_PIN, 300000);
+    uint32_t start = Hal::nowMicros();
+    TEST_ASSERT_TRUE(power->lightSleep());
+    TEST_ASSERT_EQUAL_UINT32(300000 + EXIT_US + SWITCH_US, Hal::nowMicros() - start);
+    TEST_ASSERT_EQUAL(PowerState::Active, power->getState());
+    TEST_ASSERT_EQUAL_UINT32(PowerManager::FULL_MHZ, Hal::Fake::cpuMhz());
+    TEST_ASSERT_EQUAL_UINT32(PotSampler::DEFAULT_PERIOD_MS, sampler->getPeriod());
+    TEST_ASSERT_EQUAL_UINT32(wakes + 1, Metrics::buttonWakeLatency.count.load());
+    TEST_ASSERT_EQUAL_UINT32(EXIT_US + SWITCH_US, Metrics::buttonWakeLatency.totalMicros.load() - total);
+
+    // The wake restarts the quiet period, so a held button stays awake
+    IdleInputs held = inputs(true);
+    held.buttonIdle = false;
+    TEST_ASSERT_EQUAL(PowerState::Active, runFor(IdlePolicy::OFF_SETTLE_MS * 2, held));
+    // and once released and still, OFF sleeps again after the settle time
+    TEST_ASSERT_EQUAL(PowerState::Active, runFor(IdlePolicy::OFF_SETTLE_MS - 10, inputs(true)));
+    TEST_ASSERT_EQUAL(PowerState::LightSleep, runFor(20, inputs(true)));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_downclocks_after_idle_time);
+    RUN_TEST(test_pot_turn_wakes_but_noise_does_not);
+    RUN_TEST(test_button_and_serving_keep_full_speed);
+    RUN_TEST(test_off_settles_then_sleeps);
+    RUN_TEST(test_timer_wake_stays_asleep);
+    RUN_TEST(test_button_wake_restores_full_speed);
+    return UNITY_END();
+}
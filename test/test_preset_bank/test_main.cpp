@@ -0,0 +1,171 @@
+// PresetBank against HostPreferences: slots round-trip through a flush and a
+// reload, flushes are rate-limited, a stored blob that fails isValid (or is
+// the wrong size) is never loaded, and recall reads RAM only
+#include <unity.h>
+#include <chrono>
+#include "PresetBank.h"
+#include "ColorEngine.h"
+#include "HalFake.h"
+
+namespace {
+
+PresetTable sampleTable() {
+    PresetTable table;
+    table.presets[0] = {PresetKind::Rgb, PresetPower::Keep, 250, {2047, 1024, 0}};
+    table.presets[3] = {PresetKind::Cct, PresetPower::Locked, 0, {1500, 2700, static_cast<uint16_t>(-50)}};
+    table.presets[PresetTable::COUNT - 1] = {PresetKind::Rgb, PresetPower::Unlocked, 0, {1, 2, 3}};
+    return table;
+}
+
+void storeRaw(const void* bytes, size_t length) {
+    Preferences preferences;
+    preferences.begin("led", false);
+    preferences.putBytes("presets", bytes, length);
+    preferences.end();
+}
+
+}
+
+void setUp() {
+    Hal::Fake::reset();
+}
+
+void tearDown() {}
+
+void test_empty_bank_on_first_boot() {
+    PresetBank bank;
+    bank.begin();
+    Preset preset;
+    for (int i = 0; i < PresetTable::COUNT; i++) {
+        TEST_ASSERT_FALSE(bank.get(i, preset));
+    }
+    TEST_ASSERT_FALSE(bank.get(-1, preset));
+    TEST_ASSERT_FALSE(bank.get(PresetTable::COUNT, preset));
+}
+
+void test_slots_round_trip_through_flash() {
+    PresetBank bank;
+    bank.begin();
+    PresetTable table = sampleTable();
+    TEST_ASSERT_TRUE(PresetBank::isValid(table));
+    bank.replace(table);
+    PresetTable snapshot = bank.snapshot();
+    TEST_ASSERT_EQUAL_MEMORY(&table, &snapshot, sizeof(table));
+
+    bank.flush(PresetBank::MIN_FLUSH_INTERVAL, true);
+    TEST_ASSERT_EQUAL_UINT32(1, Preferences::writeCount());
+
+    PresetBank reloaded;
+    reloaded.begin();
+    snapshot = reloaded.snapshot();
+    TEST_ASSERT_EQUAL_MEMORY(&table, &snapshot, sizeof(table));
+    Preset preset;
+    TEST_ASSERT_TRUE(reloaded.get(3, preset));
+    TEST_ASSERT_EQUAL(PresetKind::Cct, preset.kind);
+    TEST_ASSERT_EQUAL_UINT16(2700, preset.values[1]);
+}
+
+// Replacing slots marks the bank dirty; flushes inside MIN_FLUSH_INTERVAL wait
+void test_replace_then_rate_limited_flush() {
+    PresetBank bank;
+    bank.begin();
+    PresetTable table = sampleTable();
+    bank.replace(table);
+    bank.flush(10000, true);
+    TEST_ASSERT_EQUAL_UINT32(1, Preferences::writeCount());
+
+    table.presets[0].values[1] = 10;
+    table.presets[3] = Preset();
+    bank.replace(table);
+    bank.flush(10000 + PresetBank::MIN_FLUSH_INTERVAL - 1);
+    TEST_ASSERT_EQUAL_UINT32(1, Preferences::writeCount());
+    bank.flush(10000 + PresetBank::MIN_FLUSH_INTERVAL);
+    TEST_ASSERT_EQUAL_UINT32(2, Preferences::writeCount());
+    // Nothing new to write
+    bank.flush(30000, true);
+    TEST_ASSERT_EQUAL_UINT32(2, Preferences::writeCount());
+
+    PresetBank reloaded;
+    reloaded.begin();
+    Preset preset;
+    TEST_ASSERT_TRUE(reloaded.get(0, preset));
+    TEST_ASSERT_EQUAL_UINT16(10, preset.values[1]);
+    TEST_ASSERT_FALSE(reloaded.get(3, preset));
+}
+
+void test_corrupt_or_short_blob_is_rejected() {
+    PresetTable table = sampleTable();
+    table.presets[0].values[0] = 2048;
+    TEST_ASSERT_FALSE(PresetBank::isValid(table));
+    storeRaw(&table, sizeof(table));
+    PresetBank corrupt;
+    corrupt.begin();
+    Preset preset;
+    TEST_ASSERT_FALSE(corrupt.get(3, preset));
+
+    table = sampleTable();
+    storeRaw(&table, sizeof(table) - 1);
+    PresetBank shortBlob;
+    shortBlob.begin();
+    TEST_ASSERT_FALSE(shortBlob.get(0, preset));
+}
+
+void test_is_valid_checks_every_field() {
+    PresetTable table = sampleTable();
+    TEST_ASSERT_TRUE(PresetBank::isValid(table));
+
+    PresetTable bad = table;
+    bad.version = PresetTable::VERSION + 1;
+    TEST_ASSERT_FALSE(PresetBank::isValid(bad));
+    bad = table;
+    bad.count = PresetTable::COUNT - 1;
+    TEST_ASSERT_FALSE(PresetBank::isValid(bad));
+    bad = table;
+    bad.presets[5].kind = static_cast<PresetKind>(7);
+    TEST_ASSERT_FALSE(PresetBank::isValid(bad));
+    bad = table;
+    bad.presets[0].power = static_cast<PresetPower>(3);
+    TEST_ASSERT_FALSE(PresetBank::isValid(bad));
+    bad = table;
+    bad.presets[3].values[1] = ColorEngine::MAX_KELVIN + 1;
+    TEST_ASSERT_FALSE(PresetBank::isValid(bad));
+    bad = table;
+    bad.presets[3].values[2] = static_cast<uint16_t>(-(ColorEngine::MAX_DUV + 1));
+    TEST_ASSERT_FALSE(PresetBank::isValid(bad));
+}
+
+// Recall is one seqlock copy out of RAM: no flash access, and a host cost
+// far below a control tick
+void test_recall_reads_ram_only() {
+    PresetBank bank;
+    bank.begin();
+    bank.replace(sampleTable());
+    bank.flush(0, true);
+    uint32_t writes = Preferences::writeCount();
+
+    const int RECALLS = 1000000;
+    uint32_t found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < RECALLS; i++) {
+        Preset preset;
+        found += bank.get(i % PresetTable::COUNT, preset) ? preset.values[0] : 0;
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / RECALLS;
+    char line[80];
+    snprintf(line, sizeof(line), "recall: %.1f ns per get", ns);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_NOT_EQUAL(0, found);
+    TEST_ASSERT_EQUAL_UINT32(writes, Preferences::writeCount());
+    TEST_ASSERT_TRUE_MESSAGE(ns < 1000, line);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_empty_bank_on_first_boot);
+    RUN_TEST(test_slots_round_trip_through_flash);
+    RUN_TEST(test_replace_then_rate_limited_flush);
+    RUN_TEST(test_corrupt_or_short_blob_is_rejected);
+    RUN_TEST(test_is_valid_checks_every_field);
+    RUN_TEST(test_recall_reads_ram_only);
+    return UNITY_END();
+}
@@ -0,0 +1,137 @@
+// SettingsStore against HostPreferences: a burst of changes costs one NVS
+// write per MIN_FLUSH_INTERVAL, a forced flush writes at once, and only a
+// blob of the current VERSION and size is loaded back
+#include <unity.h>
+#include "Settings.h"
+#include "HalFake.h"
+
+namespace {
+
+constexpr unsigned long START_MS = 60000;
+
+void storeRaw(const void* bytes, size_t length) {
+    Preferences preferences;
+    preferences.begin("led", false);
+    preferences.putBytes("settings", bytes, length);
+    preferences.end();
+}
+
+}
+
+void setUp() {
+    Hal::Fake::reset();
+}
+
+void tearDown() {}
+
+void test_burst_costs_one_write() {
+    SettingsStore settings;
+    settings.begin();
+    settings.setUnlocked(true);
+    settings.flush(START_MS);
+    TEST_ASSERT_EQUAL_UINT32(1, Preferences::writeCount());
+
+    // A pot sweep in WIFI mode, a patch change and a mode click, all inside
+    // one interval, flushed every 100 ms: ten times as often as housekeeping
+    unsigned long now = START_MS;
+    for (int i = 0; i < 40; i++) {
+        now += 100;
+        settings.setWifiColor(i * 50, 2047 - i * 50, i);
+        if (i == 10) {
+            settings.setDmxPatch(2, 17);
+        }
+        if (i == 20) {
+            settings.setLastMode(2);
+        }
+        settings.flush(now);
+    }
+    TEST_ASSERT_TRUE(now - START_MS < SettingsStore::MIN_FLUSH_INTERVAL);
+    TEST_ASSERT_EQUAL_UINT32(1, Preferences::writeCount());
+    TEST_ASSERT_TRUE(settings.isDirty());
+
+    settings.flush(START_MS + SettingsStore::MIN_FLUSH_INTERVAL);
+    TEST_ASSERT_EQUAL_UINT32(2, Preferences::writeCount());
+    TEST_ASSERT_FALSE(settings.isDirty());
+    // Unchanged values don't dirty the store
+    settings.setWifiColor(39 * 50, 2047 - 39 * 50, 39);
+    settings.flush(START_MS + 3 * SettingsStore::MIN_FLUSH_INTERVAL);
+    TEST_ASSERT_EQUAL_UINT32(2, Preferences::writeCount());
+}
+
+// A forced flush skips the interval but still writes only when dirty
+void test_forced_flush_writes_immediately() {
+    SettingsStore settings;
+    settings.begin();
+    settings.setLastMode(1);
+    settings.flush(START_MS);
+    settings.setUnlocked(true);
+    settings.flush(START_MS + 1, true);
+    TEST_ASSERT_EQUAL_UINT32(2, Preferences::writeCount());
+    TEST_ASSERT_EQUAL_UINT32(2, settings.getFlushCount());
+    settings.flush(START_MS + 2, true);
+    TEST_ASSERT_EQUAL_UINT32(2, Preferences::writeCount());
+}
+
+void test_current_blob_reloads() {
+    SettingsStore settings;
+    settings.begin();
+    const int32_t matrix[9] = {1, 2, 3, 4, 5, 6, 7, 8, 9};
+    settings.setUnlocked(true);
+    settings.setWifiColor(100, 200, 300);
+    settings.setDmxPatch(3, 100);
+    settings.setColorMatrix(matrix);
+    settings.setNetworkRole(NetworkRole::Follower);
+    settings.flush(START_MS, true);
+
+    SettingsStore reloaded;
+    reloaded.begin();
+    const PersistedSettings& loaded = reloaded.get();
+    TEST_ASSERT_EQUAL_UINT8(PersistedSettings::VERSION, loaded.version);
+    TEST_ASSERT_TRUE(loaded.unlocked);
+    TEST_ASSERT_EQUAL_UINT16(300, loaded.wifiBlue);
+    TEST_ASSERT_EQUAL_UINT16(100, loaded.dmxStartAddress);
+    TEST_ASSERT_TRUE(loaded.colorMatrixSet);
+    TEST_ASSERT_EQUAL_INT32_ARRAY(matrix, loaded.colorMatrix, 9);
+    TEST_ASSERT_EQUAL(NetworkRole::Follower, loaded.networkRole);
+    TEST_ASSERT_FALSE(reloaded.isDirty());
+}
+
+void test_other_versions_and_sizes_are_rejected() {
+    PersistedSettings stale;
+    stale.version = PersistedSettings::VERSION - 1;
+    stale.unlocked = true;
+    stale.lastMode = 3;
+    storeRaw(&stale, sizeof(stale));
+    SettingsStore older;
+    older.begin();
+    TEST_ASSERT_FALSE(older.get().unlocked);
+    TEST_ASSERT_EQUAL_UINT8(0, older.get().lastMode);
+
+    PersistedSettings current;
+    current.lastMode = 3;
+    storeRaw(&current, sizeof(current) - 4);
+    SettingsStore truncated;
+    truncated.begin();
+    TEST_ASSERT_EQUAL_UINT8(0, truncated.get().lastMode);
+}
+
+// Firmware from before the blob kept only the unlock flag
+void test_legacy_unlock_flag() {
+    Preferences preferences;
+    preferences.begin("led", false);
+    preferences.putBool("unlocked", true);
+    preferences.end();
+    SettingsStore settings;
+    settings.begin();
+    TEST_ASSERT_TRUE(settings.get().unlocked);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_burst_costs_one_write);
+    RUN_TEST(test_forced_flush_writes_immediately);
+    RUN_TEST(test_current_blob_reloads);
+    RUN_TEST(test_other_versions_and_sizes_are_rejected);
+    RUN_TEST(test_legacy_unlock_flag);
+    return UNITY_END();
+}
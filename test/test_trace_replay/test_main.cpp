@@ -0,0 +1,182 @@
+// Trace replay through ControlLoop, StateHandler and LEDController on the
+// fake Hal. A scripted input trace goes through the same dump format the lamp
+// produces; replaying it twice, the second time with the Mode records the
+// first run wrote, must give identical output. Set TRACE_FILE to the path of
+// a GET /trace capture to replay it and print its stats
+#include <unity.h>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+#include "TraceReplay.h"
+
+namespace {
+
+struct Pipeline {
+    SettingsStore settings;
+    LEDController led{settings};
+    ColorEngine colorEngine{settings};
+    LTTController ltt{led, colorEngine};
+    StateHandler state{led};
+    PotSampler sampler{4, 3, 0};
+    ControlLoop loop{led, ltt, state, sampler, settings};
+    TraceReplay replay{loop, led, colorEngine, sampler, settings};
+
+    Pipeline() {
+        settings.begin();
+        colorEngine.begin();
+        led.begin();
+        state.begin(OperationMode::RGB);
+    }
+};
+
+// Dump bytes, collected from Trace::dump
+class Capture : public Print {
+public:
+    std::vector<uint8_t> bytes;
+    size_t write(uint8_t byte) override {
+        bytes.push_back(byte);
+        return 1;
+    }
+};
+
+std::vector<Trace::Record> dumpTrace() {
+    Capture capture;
+    Trace::dump(capture);
+    std::vector<Trace::Record> records;
+    TEST_ASSERT_TRUE(TraceReplay::parse(capture.bytes.data(), capture.bytes.size(), records));
+    return records;
+}
+
+TraceReplay::Stats replay(const std::vector<Trace::Record>& records) {
+    Hal::Fake::reset();
+    Trace::clear();
+    std::unique_ptr<Pipeline> pipeline(new Pipeline());
+    return pipeline->replay.run(records);
+}
+
+// Small deterministic ADC noise, a few millivolts either way
+uint16_t noisy(uint16_t milliVolts, uint32_t& seed) {
+    seed = seed * 1664525 + 1013904223;
+    return milliVolts + static_cast<int>((seed >> 24) % 7) - 3;
+}
+
+// Pots at rest with noise, a turn of the red pot, a click into LTT, a
+// press-and-turn, and a long press to OFF; sweeps every 5 ms as the sampler does
+std::vector<Trace::Record> scriptInputs() {
+    Trace::clear();
+    uint32_t seed = 1;
+    uint16_t pots[3] = {300, 500, 700};
+    for (uint32_t t = 0; t < 6000000; t += 5000) {
+        if (t >= 1000000 && t < 1200000) {
+            pots[0] = 300 + (t - 1000000) * 600 / 200000;
+        }
+        if (t >= 3600000 && t < 3800000) {
+            pots[1] = 500 - (t - 3600000) * 300 / 200000;
+        }
+        Trace::recordAt(t, Trace::Type::AdcSweep, 0, noisy(pots[0], seed), noisy(pots[1], seed), noisy(pots[2], seed));
+    }
+    // Click, with a bounce on the press
+    Trace::recordAt(2500000, Trace::Type::Button, 1);
+    Trace::recordAt(2501000, Trace::Type::Button, 0);
+    Trace::recordAt(2502000, Trace::Type::Button, 1);
+    Trace::recordAt(2580000, Trace::Type::Button, 0);
+    // Press and turn
+    Trace::recordAt(3500000, Trace::Type::Button, 1);
+    Trace::recordAt(4000000, Trace::Type::Button, 0);
+    // Long press
+    Trace::recordAt(5000000, Trace::Type::Button, 1);
+    Trace::recordAt(5900000, Trace::Type::Button, 0);
+    return dumpTrace();
+}
+
+void report(const char* name, const TraceReplay::Stats& stats) {
+    char line[320];
+    snprintf(line, sizeof(line),
+             "%s: %u records, %u inputs, %u latches, %u output changes (max step %u); latency p50 %u us, "
+             "p99 %u us, max %u us over %u responses, %u unanswered; %u flicker steps (max %u), %u governor "
+             "steps; %u mode changes, %u mismatched",
+             name, stats.records, stats.inputs, stats.latches, stats.outputChanges, stats.maxStepCodes,
+             stats.latencyP50Us, stats.latencyP99Us, stats.latencyMaxUs, stats.responses, stats.unanswered,
+             stats.flickerSteps, stats.flickerMaxCodes, stats.governorSteps, stats.modeChanges, stats.modeMismatches);
+    TEST_MESSAGE(line);
+}
+
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_parse_rejects_a_short_or_foreign_dump() {
+    uint8_t header[16] = {'C', 'S', 'T', 'R', Trace::VERSION, sizeof(Trace::Record), 0, 0, 2, 0, 0, 0, 0, 0, 0, 0};
+    std::vector<Trace::Record> records;
+    TEST_ASSERT_FALSE(TraceReplay::parse(header, sizeof(header), records));
+    header[8] = 0;
+    TEST_ASSERT_TRUE(TraceReplay::parse(header, sizeof(header), records));
+    header[0] = 'X';
+    TEST_ASSERT_FALSE(TraceReplay::parse(header, sizeof(header), records));
+}
+
+void test_scripted_trace_replays_deterministically() {
+    std::vector<Trace::Record> inputs = scriptInputs();
+    TraceReplay::Stats first = replay(inputs);
+    report("inputs only", first);
+    // The modes the pipeline went through, as the lamp would have recorded them
+    std::vector<Trace::Record> captured = inputs;
+    for (const Trace::Record& record : dumpTrace()) {
+        if (record.type == static_cast<uint8_t>(Trace::Type::Mode)) {
+            captured.push_back(record);
+        }
+    }
+    TEST_ASSERT_EQUAL(2, captured.size() - inputs.size());
+
+    TraceReplay::Stats second = replay(captured);
+    report("with modes", second);
+    TEST_ASSERT_EQUAL(0, second.modeMismatches);
+    TEST_ASSERT_EQUAL(2, second.modeChanges);
+    TEST_ASSERT_EQUAL(first.outputChanges, second.outputChanges);
+    TEST_ASSERT_EQUAL(first.latencyMaxUs, second.latencyMaxUs);
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(first.finalDuty, second.finalDuty, LampOutput::CHANNELS);
+    // Ends in OFF
+    for (uint32_t duty : second.finalDuty) {
+        TEST_ASSERT_EQUAL_UINT32(0, duty);
+    }
+}
+
+// A turn must show within a few control ticks of the sweep that carried it.
+// Pot noise at rest may only get through as the odd small step while the
+// dead-band is still at its sensitive minimum after a turn
+void test_scripted_trace_is_responsive_and_steady() {
+    TraceReplay::Stats stats = replay(scriptInputs());
+    TEST_ASSERT_LESS_OR_EQUAL(2, stats.flickerSteps);
+    TEST_ASSERT_LESS_OR_EQUAL(8, stats.flickerMaxCodes);
+    TEST_ASSERT_GREATER_THAN(0, stats.responses);
+    TEST_ASSERT_LESS_OR_EQUAL(30000, stats.latencyP50Us);
+}
+
+void test_replay_trace_file() {
+    const char* path = getenv("TRACE_FILE");
+    if (path == nullptr) {
+        TEST_IGNORE_MESSAGE("Set TRACE_FILE to replay a GET /trace capture");
+    }
+    FILE* file = fopen(path, "rb");
+    TEST_ASSERT_NOT_NULL(file);
+    std::vector<uint8_t> bytes;
+    uint8_t chunk[4096];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        bytes.insert(bytes.end(), chunk, chunk + read);
+    }
+    fclose(file);
+    std::vector<Trace::Record> records;
+    TEST_ASSERT_TRUE_MESSAGE(TraceReplay::parse(bytes.data(), bytes.size(), records), path);
+    report(path, replay(records));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_parse_rejects_a_short_or_foreign_dump);
+    RUN_TEST(test_scripted_trace_replays_deterministically);
+    RUN_TEST(test_scripted_trace_is_responsive_and_steady);
+    RUN_TEST(test_replay_trace_file);
+    return UNITY_END();
+}
@@ -0,0 +1,111 @@
+// TransitionEngine stepped with a fake clock: fades hit their endpoints,
+// easing stays monotonic, and sequences hold and loop without drifting
+#include <unity.h>
+#include "Transition.h"
+
+namespace {
+
+const int DARK[TransitionEngine::CHANNELS] = {0, 0, 0};
+const int WHITE[TransitionEngine::CHANNELS] = {2047, 2047, 2047};
+
+Keyframe frame(uint16_t level, uint16_t durationMs, uint16_t holdMs) {
+    return {level, level, level, durationMs, holdMs, Easing::Linear};
+}
+
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_fade_hits_both_endpoints() {
+    TransitionEngine engine;
+    int out[3];
+    engine.fadeTo(DARK, WHITE, 1000, Easing::EaseInOut, 5000);
+    TEST_ASSERT_TRUE(engine.sample(5000, out));
+    TEST_ASSERT_EQUAL_INT(0, out[0]);
+    TEST_ASSERT_TRUE(engine.sample(5500, out));
+    TEST_ASSERT_INT_WITHIN(2, 1024, out[1]);
+    TEST_ASSERT_TRUE(engine.sample(6000, out));
+    TEST_ASSERT_EQUAL_INT(2047, out[2]);
+    TEST_ASSERT_FALSE(engine.isActive());
+    TEST_ASSERT_FALSE(engine.sample(6001, out));
+}
+
+void test_easing_is_monotonic_and_pinned() {
+    const Easing curves[] = {Easing::Linear, Easing::EaseIn, Easing::EaseOut, Easing::EaseInOut};
+    for (Easing easing : curves) {
+        TEST_ASSERT_EQUAL_UINT32(0, TransitionEngine::ease(0, easing));
+        TEST_ASSERT_EQUAL_UINT32(65536, TransitionEngine::ease(65536, easing));
+        uint32_t previous = 0;
+        for (uint32_t p = 0; p <= 65536; p += 256) {
+            uint32_t value = TransitionEngine::ease(p, easing);
+            TEST_ASSERT_GREATER_OR_EQUAL_UINT32(previous, value);
+            previous = value;
+        }
+    }
+}
+
+void test_fade_survives_clock_wrap() {
+    TransitionEngine engine;
+    int out[3];
+    unsigned long start = 0xFFFFFF00UL;
+    engine.fadeTo(DARK, WHITE, 512, Easing::Linear, start);
+    engine.sample(start + 256, out);
+    TEST_ASSERT_INT_WITHIN(2, 1024, out[0]);
+    engine.sample(start + 512, out);
+    TEST_ASSERT_EQUAL_INT(2047, out[0]);
+}
+
+void test_sequence_holds_then_moves_on() {
+    TransitionEngine engine;
+    const Keyframe frames[] = {frame(1000, 100, 50), frame(0, 100, 0)};
+    int out[3];
+    TEST_ASSERT_TRUE(engine.playSequence(DARK, frames, 2, false, 0));
+    engine.sample(100, out);
+    TEST_ASSERT_EQUAL_INT(1000, out[0]);
+    engine.sample(149, out);
+    TEST_ASSERT_EQUAL_INT(1000, out[0]);
+    engine.sample(150, out);
+    engine.sample(200, out);
+    TEST_ASSERT_INT_WITHIN(1, 500, out[0]);
+    engine.sample(250, out);
+    TEST_ASSERT_EQUAL_INT(0, out[0]);
+    TEST_ASSERT_FALSE(engine.isActive());
+}
+
+// Ticks land late by a few ms; each keyframe still starts at the previous
+// one's scheduled end, so a looped sequence keeps its period. The tick that
+// crosses a keyframe boundary shows the finished keyframe's target and the
+// next one picks up the new segment
+void test_looped_sequence_does_not_drift() {
+    TransitionEngine engine;
+    const Keyframe frames[] = {frame(2047, 100, 0), frame(0, 100, 0)};
+    int out[3];
+    engine.playSequence(DARK, frames, 2, true, 0);
+    for (unsigned long now = 0; now < 100000; now += 7) {
+        engine.sample(now, out);
+    }
+    engine.sample(100045, out);
+    engine.sample(100050, out);
+    TEST_ASSERT_INT_WITHIN(2, 1024, out[0]);
+    TEST_ASSERT_TRUE(engine.isActive());
+}
+
+void test_bad_sequences_are_refused() {
+    TransitionEngine engine;
+    Keyframe frames[TransitionEngine::MAX_KEYFRAMES + 1] = {};
+    TEST_ASSERT_FALSE(engine.playSequence(DARK, frames, 0, false, 0));
+    TEST_ASSERT_FALSE(engine.playSequence(DARK, frames, TransitionEngine::MAX_KEYFRAMES + 1, false, 0));
+    TEST_ASSERT_FALSE(engine.isActive());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_fade_hits_both_endpoints);
+    RUN_TEST(test_easing_is_monotonic_and_pinned);
+    RUN_TEST(test_fade_survives_clock_wrap);
+    RUN_TEST(test_sequence_holds_then_moves_on);
+    RUN_TEST(test_looped_sequence_does_not_drift);
+    RUN_TEST(test_bad_sequences_are_refused);
+    return UNITY_END();
+}